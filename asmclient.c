@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+
+/*
+ * Client of an assembler daemon, started with "assembler --daemon=SOCKET".
+ * Usage: asmclient SOCKET [arguments of the assembler...]
+ * Sends the working directory and the arguments, prints the output of the assembler and exits with its status.
+ * "asmclient SOCKET --stop" stops the daemon.
+ */
+
+/* Writes a whole buffer to the daemon. Returns 0 on success.*/
+static int sendAll(int fd, const char *bytes, size_t length) {
+    ssize_t result;
+    while (length > 0) {
+        result = write(fd, bytes, length);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return -1;
+        bytes += result;
+        length -= (size_t)result;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    struct sockaddr_un address;
+    char directory[FILENAME_MAX], buffer[4096], status[16], *end;
+    int fd, i, statusLength = 0;
+    ssize_t length, printed;
+    int inStatus = 0;
+
+    if (argc < 2) {
+        printf("Usage: %s SOCKET [arguments...]\n", argv[0]);
+        return 2;
+    }
+    if (strlen(argv[1]) >= sizeof(address.sun_path) || getcwd(directory, sizeof(directory)) == NULL) {
+        printf("Invalid socket path or working directory.\n");
+        return 2;
+    }
+    for (i = 2; i < argc; i++) {
+        if (argv[i][0] == '\0' || strchr(argv[i], '\n') != NULL) {
+            printf("Arguments may not be empty or hold a new line.\n");
+            return 2;
+        }
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, argv[1]);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        printf("Could not connect to '%s': %s.\n", argv[1], strerror(errno));
+        return 2;
+    }
+
+    /*the request: the working directory, one argument per line and an empty line*/
+    if (sendAll(fd, directory, strlen(directory)) != 0 || sendAll(fd, "\n", 1) != 0) {
+        close(fd);
+        return 2;
+    }
+    for (i = 2; i < argc; i++) {
+        if (sendAll(fd, argv[i], strlen(argv[i])) != 0 || sendAll(fd, "\n", 1) != 0) {
+            close(fd);
+            return 2;
+        }
+    }
+    sendAll(fd, "\n", 1);
+    shutdown(fd, SHUT_WR);
+
+    /*the reply: the output, a zero byte and the exit status*/
+    while ((length = read(fd, buffer, sizeof(buffer))) != 0) {
+        if (length < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        printed = 0;
+        if (!inStatus) {
+            end = memchr(buffer, '\0', (size_t)length);
+            printed = end != NULL ? end - buffer : length;
+            fwrite(buffer, 1, (size_t)printed, stdout);
+            if (end != NULL) {
+                inStatus = 1;
+                printed++;
+            }
+        }
+        if (inStatus) {
+            for (; printed < length && statusLength + 1 < (int)sizeof(status); printed++)
+                status[statusLength++] = buffer[printed];
+        }
+    }
+    close(fd);
+    status[statusLength] = '\0';
+    if (!inStatus) {
+        printf("The daemon did not finish the request.\n");
+        return 2;
+    }
+    return (int)strtol(status, NULL, 10);
+}
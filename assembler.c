@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler.h"
+#include "parser.h"
+#include "labels.h"
+#include "image.h"
+#include "optimize.h"
+#include "split.h"
+#include "trace.h"
+#include "utils.h"
+
+/*Requests of the I/O queue of a context - the output files of a module are written at once*/
+#define CONTEXT_IO_ENTRIES 8
+
+/* Prepares a context for assembling sources with the given options.*/
+void initAssemblerContext(AssemblerContext *context, const assembler_options *options) {
+    memset(context, 0, sizeof(AssemblerContext));
+    if (options != NULL) {
+        context->options = *options;
+    } else {
+        context->options.memorySize = DEFAULT_MEMORY_SPACE;
+        context->options.baseAddress = DEFAULT_BASE_ADDRESS;
+    }
+    context->labelTable.head = NULL;
+    context->labelTable.spare = NULL;
+    context->macroTable.macros = NULL;
+    initImage(&context->image);
+    openIOQueue(&context->io, CONTEXT_IO_ENTRIES);
+}
+
+/* Releases everything a context holds.*/
+void freeAssemblerContext(AssemblerContext *context) {
+    resetAssemblerContext(context);
+    freeMacroTable(&context->macroTable);
+    freeImage(&context->image);
+    freeLabelTable(&context->labelTable);
+    freeOutputs(&context->outputs);
+    closeIOQueue(&context->io);
+}
+
+/* Empties a context for the next source - its tables and buffers are kept, so the sources after the first allocate little.*/
+void resetAssemblerContext(AssemblerContext *context) {
+    clearMacroTable(&context->macroTable);
+    clearImage(&context->image);
+    clearLabelTable(&context->labelTable);
+    context->IC = 0;
+    context->DC = 0;
+    context->errorFound = FALSE;
+    context->wordsSaved = 0;
+}
+
+/* Runs both passes over a source whose macros are already expanded.*/
+boolean assembleSource(AssemblerContext *context, const char *source, size_t length) {
+    char line[MAX_LINE_LENGTH+1]; /*adding one extra space for NULL ending*/
+    const char *end = source + length;
+    int lineNumber = 1;
+    label *head;
+
+    clearImage(&context->image);
+    context->image.onePass = context->options.onePass;
+    context->image.poolAll = context->options.pool;
+    context->image.noFiles = context->options.noFiles;
+    context->image.memorySize = context->options.memorySize;
+    context->image.baseAddress = context->options.baseAddress;
+
+    /* Process the expanded source line by line, unless it is large enough to be read in pieces at once*/
+    if (context->options.splits < 2 || !splitFirstPass(&context->image, &context->labelTable, &context->IC, &context->DC, source, length, context->options.splits)) {
+        while (readSourceLine(&source, end, line, sizeof(line)) > 0) {
+            context->errorFound |= (parseLine(line, &context->image, &context->labelTable, &context->IC, &context->DC, lineNumber) == FALSE);
+            lineNumber++;
+        }
+    }
+    /* in one-pass mode only the uses of data and external labels are still waiting*/
+    if (context->options.onePass) {
+        context->errorFound |= (finishOnePass(&context->image, &context->labelTable, context->IC) == FALSE);
+    }
+
+    if (TRACE_ENABLED(TRACE_LABELS, TRACE_INFO)) {
+        for (head = context->labelTable.head; head != NULL; head = head->next)
+            TRACE((TRACE_LABELS, TRACE_INFO, "%s\n", head->name));
+    }
+    if (!context->errorFound && context->options.optimize) {
+        context->wordsSaved = optimizeImage(&context->image, &context->labelTable, &context->IC);
+    }
+    return !context->errorFound;
+}
+
+/* Assembles a source file into the .am file and the output files next to it.*/
+boolean assembleFile(AssemblerContext *context, const char *fileName) {
+    file_contents source;
+    char *fileNames[1];
+    boolean assembled;
+
+    fileNames[0] = (char *)fileName;
+    if (!readFiles(&context->io, fileNames, 1, &source)) {
+        printMessage("Error opening files.\n");
+        return FALSE;
+    }
+    assembled = assembleFileContents(context, fileName, source.bytes, source.length);
+    free(source.bytes);
+    return assembled;
+}
+
+/* Assembles a source file whose contents were already read.*/
+boolean assembleFileContents(AssemblerContext *context, const char *fileName, const char *source, size_t length) {
+    char *expanded, *extension;
+    size_t expandedLength;
+    boolean assembled;
+
+    if (strlen(fileName) >= MAX_FILE_NAME_LENGTH) {
+        printMessage("File name '%s' is too long.\n", fileName);
+        return FALSE;
+    }
+    /*the intermediate file name replaces the extension with ".am"*/
+    strcpy(context->intermediateFileName, fileName);
+    extension = strrchr(context->intermediateFileName, '.');
+    if (extension) {
+        *extension = '\0';
+    }
+    strcat(context->intermediateFileName, ".am");
+
+    expanded = (context->macroTable.macros != NULL || initializeMacroTable(&context->macroTable)) ? expandMacros(source, length, &context->macroTable, &expandedLength) : NULL;
+    if (expanded == NULL || !writeOutputFile(&context->io, context->intermediateFileName, expanded, expandedLength)) {
+        free(expanded);
+        resetAssemblerContext(context);
+        removeOutputFiles(context->intermediateFileName);
+        return FALSE;
+    }
+
+    assembled = assembleSource(context, expanded, expandedLength);
+    free(expanded);
+    /* if no errors were found there creates the files*/
+    if (assembled) {
+        assembled = writeFiles(&context->io, context->intermediateFileName, &context->image, context->labelTable, context->IC, context->DC, context->options.binaryObject, &context->outputs);
+    }
+    /*the outputs of an earlier run would look up to date to a build tool*/
+    if (!assembled) {
+        removeOutputFiles(context->intermediateFileName);
+    }
+    return assembled;
+}
+
+/* Assembles a source held in memory, without any file I/O.*/
+boolean assembleBuffer(AssemblerContext *context, const char *source, size_t length, assembler_result *result) {
+    diagnostics *previousSink;
+    char *expanded;
+    size_t expandedLength;
+
+    memset(result, 0, sizeof(assembler_result));
+    previousSink = setDiagnosticSink(&result->messages);
+
+    expanded = (context->macroTable.macros != NULL || initializeMacroTable(&context->macroTable)) ? expandMacros(source, length, &context->macroTable, &expandedLength) : NULL;
+    if (expanded != NULL) {
+        result->success = assembleSource(context, expanded, expandedLength)
+            && formatOutputs(&context->image, &context->labelTable, context->IC, context->DC, &result->outputs);
+        free(expanded);
+    }
+    if (!result->success)
+        freeOutputs(&result->outputs);
+    result->IC = context->IC;
+    result->DC = context->DC;
+
+    setDiagnosticSink(previousSink);
+    resetAssemblerContext(context);
+    return result->success;
+}
+
+/* Assembles a source held in memory with the default options.*/
+boolean assemble_buffer(const char *src, size_t len, assembler_result *out) {
+    AssemblerContext *context = malloc(sizeof(AssemblerContext));
+    boolean assembled;
+
+    if (context == NULL) {
+        memset(out, 0, sizeof(assembler_result));
+        return FALSE;
+    }
+    initAssemblerContext(context, NULL);
+    assembled = assembleBuffer(context, src, len, out);
+    freeAssemblerContext(context);
+    free(context);
+    return assembled;
+}
+
+/* Frees the outputs and diagnostics of a result.*/
+void freeAssemblerResult(assembler_result *result) {
+    freeOutputs(&result->outputs);
+    free(result->messages.text);
+    result->messages.text = NULL;
+    result->messages.length = 0;
+    result->messages.capacity = 0;
+}
@@ -0,0 +1,108 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include "utils.h"
+#include "preprocessor.h"
+#include "writeFiles.h"
+#include "fileIO.h"
+
+/*Everything one assembly works on. A context assembles one source at a time, and can be reused for any number of them*/
+typedef struct AssemblerContext {
+    assembler_options options;
+    MacroTable macroTable;
+    machine_image image;
+    label_table labelTable;
+    int IC;
+    int DC;
+    boolean errorFound;
+    int wordsSaved; /*by the optimizer*/
+    char intermediateFileName[MAX_FILE_NAME_LENGTH];
+    io_queue io; /*the reads and writes of the files*/
+    output_files outputs; /*the contents of the output files of the last file written, kept for the next one*/
+} AssemblerContext;
+
+/*The outcome of assembling a buffer*/
+typedef struct assembler_result {
+    boolean success;
+    int IC;
+    int DC;
+    output_files outputs; /*the contents of the .ob, .ent, .ext and .rel files - empty if the assembly failed*/
+    diagnostics messages; /*the errors and warnings, null-terminated, or NULL if there were none*/
+} assembler_result;
+
+/**
+ * Prepares a context for assembling sources with the given options.
+ * @param context The context.
+ * @param options The options, or NULL for the defaults.
+ */
+void initAssemblerContext(AssemblerContext *context, const assembler_options *options);
+
+/**
+ * Releases everything a context holds. It can be set up again with initAssemblerContext.
+ * @param context The context.
+ */
+void freeAssemblerContext(AssemblerContext *context);
+
+/**
+ * Empties the state of the last source, so the context is ready for the next one. The tables and buffers are
+ * kept, so the next source reuses their memory.
+ * @param context The context.
+ */
+void resetAssemblerContext(AssemblerContext *context);
+
+/**
+ * Runs both passes over a source whose macros are already expanded, leaving the result in the context.
+ * @param context The context.
+ * @param source The expanded source.
+ * @param length The length of the source.
+ * @return TRUE if the source has no errors, FALSE otherwise.
+ */
+boolean assembleSource(AssemblerContext *context, const char *source, size_t length);
+
+/**
+ * Assembles a source file: writes the expanded source to the .am file, and the output files next to it.
+ * @param context The context.
+ * @param fileName The name of the .as file.
+ * @return TRUE if the file was assembled and its outputs written, FALSE otherwise.
+ */
+boolean assembleFile(AssemblerContext *context, const char *fileName);
+
+/**
+ * Assembles a source file whose contents were already read, e.g. ahead of time for a batch of files.
+ * @param context The context.
+ * @param fileName The name of the .as file.
+ * @param source The contents of the file.
+ * @param length The length of the contents.
+ * @return TRUE if the file was assembled and its outputs written, FALSE otherwise.
+ */
+boolean assembleFileContents(AssemblerContext *context, const char *fileName, const char *source, size_t length);
+
+/**
+ * Assembles a source held in memory, without writing any file. Diagnostics are collected in the result instead of printed.
+ * The only file read is that of an .incbin of the source, relative to the working directory - set the noFiles option
+ * of the context to reject .incbin, e.g. for sources that are not trusted.
+ * @param context The context.
+ * @param source The source, before its macros are expanded.
+ * @param length The length of the source.
+ * @param result Output for the result - free it with freeAssemblerResult.
+ * @return TRUE if the source was assembled, FALSE otherwise.
+ */
+boolean assembleBuffer(AssemblerContext *context, const char *source, size_t length, assembler_result *result);
+
+/**
+ * Assembles a source held in memory with the default options, without writing any file. An .incbin of the source is
+ * read relative to the working directory - use assembleBuffer with the noFiles option to reject it.
+ * @param src The source, before its macros are expanded.
+ * @param len The length of the source.
+ * @param out Output for the result - free it with freeAssemblerResult.
+ * @return TRUE if the source was assembled, FALSE otherwise.
+ */
+boolean assemble_buffer(const char *src, size_t len, assembler_result *out);
+
+/**
+ * Frees the outputs and diagnostics of a result.
+ * @param result The result.
+ */
+void freeAssemblerResult(assembler_result *result);
+
+#endif /* ASSEMBLER_H */
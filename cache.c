@@ -0,0 +1,468 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "parser.h"
+#include "image.h"
+#include "utils.h"
+
+/*The output files of a module, as extensions of the source name - an entry holds each under the extension without the dot*/
+static const char *const outputExtensions[] = {".am", ".ob", ".ent", ".ext", ".rel", ".obx"};
+#define OUTPUT_KINDS 6
+
+/*The files of an entry besides the outputs*/
+#define SOURCE_FILE "source" /*the configuration and the source it was assembled from*/
+#define MESSAGES_FILE "messages" /*the messages of the assembly, with FILE_NAME_MARK for the name of the source*/
+#define INCLUDES_FILE "includes" /*"<hash> <name>" for every file embedded with .incbin*/
+#define STATISTICS_FILE "statistics"
+/*Stands for the name of the source in the stored messages - the same source may be restored under another name*/
+#define FILE_NAME_MARK '\001'
+
+/*Longest name of a cache directory, leaving room for the names of the entries and their files*/
+#define MAX_CACHE_PATH (FILENAME_MAX - 512)
+
+/*An entry of the cache directory, while looking for the ones to evict*/
+typedef struct cache_entry {
+    char name[FILENAME_MAX];
+    long lastUse;
+    long size;
+} cache_entry;
+
+/* FNV-1a hash of a block of bytes, continuing from a previous hash.*/
+static unsigned long hashBytes(unsigned long hash, const char *bytes, size_t length) {
+    size_t i;
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)bytes[i];
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return hash;
+}
+
+/* Reads a whole file. Returns NULL if it cannot be read.*/
+static char *readWholeFile(const char *fileName, size_t *length) {
+    FILE *file = fopen(fileName, "rb");
+    char *bytes;
+    long size;
+
+    if (file == NULL)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+    bytes = size >= 0 ? malloc(size > 0 ? (size_t)size : 1) : NULL;
+    if (bytes != NULL && fread(bytes, 1, (size_t)size, file) != (size_t)size) {
+        free(bytes);
+        bytes = NULL;
+    }
+    fclose(file);
+    *length = (size_t)size;
+    return bytes;
+}
+
+/* Writes a file from one or two blocks of bytes.*/
+static boolean writeWholeFile(const char *fileName, const char *first, size_t firstLength, const char *second, size_t secondLength) {
+    FILE *file = fopen(fileName, "wb");
+    boolean written;
+
+    if (file == NULL)
+        return FALSE;
+    written = fwrite(first, 1, firstLength, file) == firstLength && fwrite(second, 1, secondLength, file) == secondLength;
+    return (fclose(file) == 0) && written;
+}
+
+/* Checks if two files hold the same bytes.*/
+static boolean sameFiles(const char *first, const char *second) {
+    struct stat firstInfo, secondInfo;
+    char *firstBytes, *secondBytes;
+    size_t firstLength, secondLength;
+    boolean same;
+
+    if (stat(first, &firstInfo) != 0 || stat(second, &secondInfo) != 0 || firstInfo.st_size != secondInfo.st_size)
+        return FALSE;
+    if (firstInfo.st_ino == secondInfo.st_ino && firstInfo.st_dev == secondInfo.st_dev)
+        return TRUE; /*a hard link restored earlier*/
+    firstBytes = readWholeFile(first, &firstLength);
+    secondBytes = readWholeFile(second, &secondLength);
+    same = firstBytes != NULL && secondBytes != NULL && firstLength == secondLength && memcmp(firstBytes, secondBytes, firstLength) == 0;
+    free(firstBytes);
+    free(secondBytes);
+    return same;
+}
+
+/* Makes a file hold the bytes of another - by a hard link, or by a copy across file systems.*/
+static boolean linkOrCopy(const char *from, const char *to) {
+    char *bytes;
+    size_t length;
+    boolean copied;
+
+    if (link(from, to) == 0)
+        return TRUE;
+    bytes = readWholeFile(from, &length);
+    copied = bytes != NULL && writeWholeFile(to, bytes, length, "", 0);
+    free(bytes);
+    return copied;
+}
+
+/* Removes an entry and the files in it.*/
+static void removeEntry(const char *entry) {
+    char path[FILENAME_MAX];
+    struct dirent *file;
+    DIR *directory = opendir(entry);
+
+    if (directory != NULL) {
+        while ((file = readdir(directory)) != NULL) {
+            if (file->d_name[0] == '.')
+                continue;
+            sprintf(path, "%.*s/%.255s", MAX_CACHE_PATH + 255, entry, file->d_name);
+            remove(path);
+        }
+        closedir(directory);
+    }
+    rmdir(entry);
+}
+
+/* Sums the sizes of the files of an entry.*/
+static long entrySize(const char *entry) {
+    char path[FILENAME_MAX];
+    struct dirent *file;
+    struct stat info;
+    long size = 0;
+    DIR *directory = opendir(entry);
+
+    if (directory == NULL)
+        return 0;
+    while ((file = readdir(directory)) != NULL) {
+        if (file->d_name[0] == '.')
+            continue;
+        sprintf(path, "%.*s/%.255s", MAX_CACHE_PATH + 255, entry, file->d_name);
+        if (stat(path, &info) == 0)
+            size += (long)info.st_size;
+    }
+    closedir(directory);
+    return size;
+}
+
+/* Formats the path of an entry, or of a file in it when file is not NULL.*/
+static void entryPath(const build_cache *cache, const char *key, const char *file, char *path) {
+    if (file == NULL)
+        sprintf(path, "%.*s/%.255s", MAX_CACHE_PATH, cache->directory, key);
+    else
+        sprintf(path, "%.*s/%.255s/%.16s", MAX_CACHE_PATH, cache->directory, key, file);
+}
+
+/* Formats the name of an output file of a source.*/
+static void outputName(const char *fileName, int kind, char *output) {
+    char *extension;
+    sprintf(output, "%.*s", FILENAME_MAX - 8, fileName);
+    extension = strrchr(output, '.');
+    if (extension != NULL)
+        *extension = '\0';
+    strcat(output, outputExtensions[kind]);
+}
+
+/* Computes the key of a source - the hash of the configuration and the source, and the length of the source.*/
+static void sourceKey(const build_cache *cache, const char *source, size_t length, char *key) {
+    unsigned long hash = hashBytes(2166136261UL, cache->config, cache->configLength);
+    sprintf(key, "%08lx-%lu", hashBytes(hash, source, length), (unsigned long)length);
+}
+
+/* Checks that the files an entry was assembled with still hold the same bytes.*/
+static boolean includesUnchanged(const char *includesFile) {
+    char line[FILENAME_MAX + 16], name[FILENAME_MAX];
+    unsigned long hash;
+    char *bytes;
+    size_t length;
+    boolean unchanged = TRUE;
+    FILE *includes = fopen(includesFile, "r");
+
+    if (includes == NULL)
+        return errno == ENOENT; /*the source embeds no files*/
+    while (unchanged && fgets(line, sizeof(line), includes) != NULL) {
+        if (sscanf(line, "%lx %[^\n]", &hash, name) != 2) {
+            unchanged = FALSE;
+            break;
+        }
+        bytes = readWholeFile(name, &length);
+        unchanged = bytes != NULL && hashBytes(2166136261UL, bytes, length) == hash;
+        free(bytes);
+    }
+    fclose(includes);
+    return unchanged;
+}
+
+/* Adds the files an entry was assembled with to an image.*/
+static void restoreIncludes(const char *includesFile, machine_image *image) {
+    char line[FILENAME_MAX + 16], name[FILENAME_MAX];
+    unsigned long hash;
+    FILE *includes = fopen(includesFile, "r");
+
+    while (includes != NULL && fgets(line, sizeof(line), includes) != NULL) {
+        if (sscanf(line, "%lx %[^\n]", &hash, name) == 2 && !addInclude(image, name, 0))
+            break;
+    }
+    if (includes != NULL)
+        fclose(includes);
+}
+
+/*The identity of the assembler - hashed once, as a daemon opens the cache for every command line*/
+static unsigned long assemblerHash;
+static size_t assemblerLength;
+static pthread_once_t assemblerHashed = PTHREAD_ONCE_INIT;
+
+/* Hashes the bytes of the running assembler, so a rebuilt assembler does not reuse the outputs of the old one.*/
+static void hashAssembler(void) {
+    char *assembler = readWholeFile("/proc/self/exe", &assemblerLength);
+    if (assembler != NULL) {
+        assemblerHash = hashBytes(2166136261UL, assembler, assemblerLength);
+    } else {
+        assemblerLength = 0;
+        assemblerHash = hashBytes(2166136261UL, __DATE__ " " __TIME__, strlen(__DATE__ " " __TIME__));
+    }
+    free(assembler);
+}
+
+/* Opens a cache directory.*/
+boolean openCache(build_cache *cache, const char *directory, long megabytes, const assembler_options *options) {
+    if (strlen(directory) >= MAX_CACHE_PATH || (mkdir(directory, 0777) != 0 && errno != EEXIST)) {
+        printf("Could not use '%s' as the cache directory.\n", directory);
+        return FALSE;
+    }
+    strcpy(cache->directory, directory);
+    pthread_once(&assemblerHashed, hashAssembler);
+    sprintf(cache->config, "assembler %08lx %lu options %d%d%d%d%d isa %d %d %d\n", assemblerHash, (unsigned long)assemblerLength,
+        options->onePass, options->optimize, options->pool, options->binaryObject, options->noFiles, ISA_WORD_BITS, options->memorySize, options->baseAddress);
+    cache->configLength = strlen(cache->config);
+    cache->outputCount = options->binaryObject ? OUTPUT_KINDS : OUTPUT_KINDS - 1;
+    cache->sizeLimit = megabytes * 1024 * 1024;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->nextTemporary = 0;
+    pthread_mutex_init(&cache->lock, NULL);
+    return TRUE;
+}
+
+/* Copies messages, replacing every occurrence of the name of the source with FILE_NAME_MARK. Returns the length of the copy.*/
+static size_t markFileName(const char *messages, size_t length, const char *fileName, char *marked) {
+    size_t nameLength = strlen(fileName), i = 0, markedLength = 0;
+
+    while (i < length) {
+        if (nameLength > 0 && length - i >= nameLength && memcmp(messages + i, fileName, nameLength) == 0) {
+            marked[markedLength++] = FILE_NAME_MARK;
+            i += nameLength;
+        } else {
+            marked[markedLength++] = messages[i++];
+        }
+    }
+    return markedLength;
+}
+
+/* Prints a stored message line again, with the name of the source in place of every FILE_NAME_MARK.*/
+static void printMarkedLine(const char *line, const char *end, const char *fileName) {
+    const char *mark;
+
+    while ((mark = memchr(line, FILE_NAME_MARK, end - line)) != NULL) {
+        printMessage("%.*s%s", (int)(mark - line), line, fileName);
+        line = mark + 1;
+    }
+    printMessage("%.*s", (int)(end - line), line);
+}
+
+/* Looks a source up in the cache, restoring its outputs on a hit.*/
+boolean restoreFromCache(build_cache *cache, const char *fileName, const char *source, size_t length, machine_image *image) {
+    char key[32], path[FILENAME_MAX], output[FILENAME_MAX], temporary[FILENAME_MAX];
+    char *stored, *line, *end;
+    size_t storedLength;
+    boolean hit;
+    int kind, number;
+
+    sourceKey(cache, source, length, key);
+    entryPath(cache, key, SOURCE_FILE, path);
+    /*the entry must hold this very source, assembled by this assembler with these options*/
+    stored = readWholeFile(path, &storedLength);
+    hit = stored != NULL && storedLength == cache->configLength + length && memcmp(stored, cache->config, cache->configLength) == 0
+        && memcmp(stored + cache->configLength, source, length) == 0;
+    free(stored);
+    if (hit) {
+        entryPath(cache, key, INCLUDES_FILE, path);
+        hit = includesUnchanged(path);
+    }
+
+    for (kind = 0; hit && kind < cache->outputCount; kind++) {
+        outputName(fileName, kind, output);
+        entryPath(cache, key, outputExtensions[kind] + 1, path);
+        if (access(path, F_OK) != 0) {
+            remove(output); /*the module has no such file - one of an earlier run would be stale*/
+        } else if (!sameFiles(path, output)) {
+            /*numbered like the entries, so two threads restoring the same output do not share the temporary file*/
+            pthread_mutex_lock(&cache->lock);
+            number = cache->nextTemporary++;
+            pthread_mutex_unlock(&cache->lock);
+            sprintf(temporary, "%.*s.%ld.%d.tmp", FILENAME_MAX - 64, output, (long)getpid(), number);
+            remove(temporary);
+            hit = linkOrCopy(path, temporary) && rename(temporary, output) == 0;
+            if (!hit)
+                remove(temporary);
+        }
+    }
+
+    if (hit) {
+        /*the messages are printed again a line at a time, as they were first printed*/
+        entryPath(cache, key, MESSAGES_FILE, path);
+        stored = readWholeFile(path, &storedLength);
+        for (line = stored; stored != NULL && line < stored + storedLength; line = end) {
+            end = memchr(line, '\n', stored + storedLength - line);
+            end = end != NULL ? end + 1 : stored + storedLength;
+            if (end - line > MAX_LINE_LENGTH)
+                end = line + MAX_LINE_LENGTH; /*printMessage takes a line at most a few hundred characters long*/
+            printMarkedLine(line, end, fileName);
+        }
+        free(stored);
+        entryPath(cache, key, INCLUDES_FILE, path);
+        restoreIncludes(path, image);
+        entryPath(cache, key, NULL, path);
+        utime(path, NULL); /*the time of the entry is the time of its last use*/
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    if (hit)
+        cache->hits++;
+    else
+        cache->misses++;
+    pthread_mutex_unlock(&cache->lock);
+    return hit;
+}
+
+/* Adds the outputs of a source that was just assembled to the cache.*/
+void addToCache(build_cache *cache, const char *fileName, const char *source, size_t length, const machine_image *image, const char *messages, size_t messagesLength) {
+    char key[32], entry[FILENAME_MAX], temporary[FILENAME_MAX], path[FILENAME_MAX], output[FILENAME_MAX];
+    char *bytes, *marked;
+    size_t includeLength, markedLength;
+    boolean added;
+    FILE *includes = NULL;
+    int kind, i, number;
+
+    pthread_mutex_lock(&cache->lock);
+    number = cache->nextTemporary++;
+    pthread_mutex_unlock(&cache->lock);
+
+    /*the entry is filled in under a temporary name, so no one sees it half written*/
+    sourceKey(cache, source, length, key);
+    entryPath(cache, key, NULL, entry);
+    sprintf(temporary, "%.*s.%ld.%d.tmp", MAX_CACHE_PATH + 64, entry, (long)getpid(), number);
+    if (mkdir(temporary, 0777) != 0)
+        return;
+    sprintf(path, "%.*s/%.16s", MAX_CACHE_PATH + 128, temporary, SOURCE_FILE);
+    added = writeWholeFile(path, cache->config, cache->configLength, source, length);
+    if (added && messagesLength > 0) {
+        sprintf(path, "%.*s/%.16s", MAX_CACHE_PATH + 128, temporary, MESSAGES_FILE);
+        marked = malloc(messagesLength);
+        added = marked != NULL;
+        if (added) {
+            markedLength = markFileName(messages, messagesLength, fileName, marked);
+            added = writeWholeFile(path, marked, markedLength, "", 0);
+        }
+        free(marked);
+    }
+    if (added && image->includeCount > 0) {
+        sprintf(path, "%.*s/%.16s", MAX_CACHE_PATH + 128, temporary, INCLUDES_FILE);
+        includes = fopen(path, "w");
+        added = includes != NULL;
+        for (i = 0; added && i < image->includeCount; i++) {
+            bytes = readWholeFile(image->includes[i], &includeLength);
+            added = bytes != NULL && fprintf(includes, "%08lx %s\n", hashBytes(2166136261UL, bytes, includeLength), image->includes[i]) > 0;
+            free(bytes);
+        }
+        if (includes != NULL && fclose(includes) != 0)
+            added = FALSE;
+    }
+    for (kind = 0; added && kind < cache->outputCount; kind++) {
+        outputName(fileName, kind, output);
+        sprintf(path, "%.*s/%.16s", MAX_CACHE_PATH + 128, temporary, outputExtensions[kind] + 1);
+        if (access(output, F_OK) == 0)
+            added = linkOrCopy(output, path);
+    }
+
+    /*an entry of the same key holds another source, or a source whose embedded files changed*/
+    if (added && rename(temporary, entry) != 0) {
+        removeEntry(entry);
+        added = rename(temporary, entry) == 0;
+    }
+    if (!added)
+        removeEntry(temporary);
+}
+
+/* Orders entries from the least recently used.*/
+static int compareLastUse(const void *a, const void *b) {
+    const cache_entry *x = a, *y = b;
+    return (x->lastUse > y->lastUse) - (x->lastUse < y->lastUse);
+}
+
+/* Evicts the least recently used entries and updates the statistics of the directory.*/
+void closeCache(build_cache *cache, boolean printStatistics) {
+    char path[FILENAME_MAX];
+    cache_entry *entries = NULL, *newEntries;
+    struct dirent *file;
+    struct stat info;
+    long totalSize = 0, totalHits = 0, totalMisses = 0;
+    int count = 0, capacity = 0, i, evicted = 0;
+    FILE *statistics;
+    DIR *directory = opendir(cache->directory);
+
+    while (directory != NULL && (file = readdir(directory)) != NULL) {
+        /*the entries still being filled in, by this run or another, are left alone*/
+        if (file->d_name[0] == '.' || strcmp(file->d_name, STATISTICS_FILE) == 0 || strstr(file->d_name, ".tmp") != NULL)
+            continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            newEntries = realloc(entries, capacity * sizeof(cache_entry));
+            if (newEntries == NULL)
+                break;
+            entries = newEntries;
+        }
+        entryPath(cache, file->d_name, NULL, path);
+        if (stat(path, &info) != 0 || !S_ISDIR(info.st_mode))
+            continue;
+        strcpy(entries[count].name, path);
+        entries[count].lastUse = (long)info.st_mtime;
+        entries[count].size = entrySize(path);
+        totalSize += entries[count++].size;
+    }
+    if (directory != NULL)
+        closedir(directory);
+
+    qsort(entries, count, sizeof(cache_entry), compareLastUse);
+    for (i = 0; i < count && totalSize > cache->sizeLimit; i++) {
+        removeEntry(entries[i].name);
+        totalSize -= entries[i].size;
+        evicted++;
+    }
+    free(entries);
+
+    /*the totals of the directory, over every run that used it*/
+    sprintf(path, "%.*s/%s", MAX_CACHE_PATH, cache->directory, STATISTICS_FILE);
+    statistics = fopen(path, "r");
+    if (statistics != NULL) {
+        if (fscanf(statistics, "hits %ld misses %ld", &totalHits, &totalMisses) != 2)
+            totalHits = totalMisses = 0;
+        fclose(statistics);
+    }
+    totalHits += cache->hits;
+    totalMisses += cache->misses;
+    statistics = fopen(path, "w");
+    if (statistics != NULL) {
+        fprintf(statistics, "hits %ld misses %ld\n", totalHits, totalMisses);
+        fclose(statistics);
+    }
+
+    if (printStatistics) {
+        printf("Cache: %d hits and %d misses, %ld hits and %ld misses in total. %d entries of %ld KB, bounded by %ld KB - %d evicted.\n",
+            cache->hits, cache->misses, totalHits, totalMisses, count - evicted, totalSize / 1024, cache->sizeLimit / 1024, evicted);
+    }
+    pthread_mutex_destroy(&cache->lock);
+}
@@ -0,0 +1,72 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include "utils.h"
+
+/*Default bound of the size of a cache directory, in megabytes*/
+#define DEFAULT_CACHE_MEGABYTES 256
+/*Longest description of the assembler and the options in a cache entry*/
+#define MAX_CACHE_CONFIG_LENGTH 128
+
+/*
+ * A directory of the outputs of earlier assemblies. Every entry is a subdirectory named by the hash of the source
+ * and of everything else that decides the outputs - the assembler, the options and the files embedded with .incbin -
+ * and holds the outputs, the messages of the assembly and what it was assembled from, to be checked on every hit.
+ */
+typedef struct build_cache {
+    char directory[FILENAME_MAX];
+    char config[MAX_CACHE_CONFIG_LENGTH]; /*the assembler and the options that change the outputs*/
+    size_t configLength;
+    int outputCount; /*the output files of a module - the .obx file only with --obx*/
+    long sizeLimit; /*in bytes*/
+    int hits;
+    int misses;
+    int nextTemporary; /*numbers the entries this process is still filling in*/
+    pthread_mutex_t lock;
+} build_cache;
+
+/**
+ * Opens a cache directory, creating it if needed.
+ * @param cache The cache.
+ * @param directory The directory.
+ * @param megabytes The bound of the size of the directory - the least recently used entries are evicted when it is closed.
+ * @param options The options of this run.
+ * @return TRUE if the cache can be used, FALSE otherwise.
+ */
+boolean openCache(build_cache *cache, const char *directory, long megabytes, const assembler_options *options);
+
+/**
+ * Looks a source up in the cache. On a hit the output files are restored next to the source, by a hard link to the
+ * entry or by a copy, the messages of the assembly are printed again and the files it embeds are added to the image.
+ * @param cache The cache.
+ * @param fileName The name of the .as file.
+ * @param source The contents of the file.
+ * @param length The length of the contents.
+ * @param image An empty image, for the names of the files the module embeds.
+ * @return TRUE on a hit, FALSE if the source must be assembled.
+ */
+boolean restoreFromCache(build_cache *cache, const char *fileName, const char *source, size_t length, machine_image *image);
+
+/**
+ * Adds the outputs of a source that was just assembled to the cache.
+ * @param cache The cache.
+ * @param fileName The name of the .as file.
+ * @param source The contents of the file.
+ * @param length The length of the contents.
+ * @param image The image of the module, for the files it embeds.
+ * @param messages The messages printed while the file was assembled - they are stored without the name of the file,
+ *                 which is put back on a hit under the name the source is restored for.
+ * @param messagesLength The length of the messages.
+ */
+void addToCache(build_cache *cache, const char *fileName, const char *source, size_t length, const machine_image *image, const char *messages, size_t messagesLength);
+
+/**
+ * Evicts the least recently used entries until the cache fits its bound, and updates the statistics of the directory.
+ * @param cache The cache.
+ * @param printStatistics TRUE to print the statistics of this run and of the directory.
+ */
+void closeCache(build_cache *cache, boolean printStatistics);
+
+#endif /*CACHE_H*/
@@ -0,0 +1,298 @@
+#define _DEFAULT_SOURCE /*fileno*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+#include "json.h"
+#include "utils.h"
+
+/*The program name every command line is run with*/
+#define PROGRAM_NAME "assembler"
+
+/* Runs a command line with everything it prints - to stdout or stderr - sent to a file descriptor.*/
+static int runCaptured(int fd, int argc, char *argv[], command_function run, void *arg) {
+    int savedOut, savedErr, status;
+
+    fflush(stdout);
+    fflush(stderr);
+    savedOut = dup(STDOUT_FILENO);
+    savedErr = dup(STDERR_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    status = run(argc, argv, arg);
+    fflush(stdout);
+    fflush(stderr);
+    dup2(savedOut, STDOUT_FILENO);
+    dup2(savedErr, STDERR_FILENO);
+    close(savedOut);
+    close(savedErr);
+    return status;
+}
+
+/* Splits a request into its lines, in place - the first is the working directory, the others the arguments.
+   Returns the number of lines, or -1 if memory ran out.*/
+static int splitLines(char *request, char ***lines) {
+    int count = 0, capacity = 16;
+    char *line = request, *end;
+
+    *lines = malloc(capacity * sizeof(char *));
+    while (*lines != NULL && (end = strchr(line, '\n')) != NULL && end != line) {
+        if (count + 2 > capacity) {
+            char **newLines = realloc(*lines, (capacity *= 2) * sizeof(char *));
+            if (newLines == NULL) {
+                free(*lines);
+                *lines = NULL;
+                break;
+            }
+            *lines = newLines;
+        }
+        *end = '\0';
+        (*lines)[count++] = line;
+        line = end + 1;
+    }
+    return *lines == NULL ? -1 : count;
+}
+
+/* Reads a request from a client, up to the empty line that ends it. Returns NULL if the client gave up.*/
+static char *readRequest(int client) {
+    char *request = NULL, *newRequest;
+    size_t length = 0, capacity = 0;
+    ssize_t result;
+
+    for (;;) {
+        if (length + 1 >= capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            newRequest = capacity <= (size_t)MAX_REQUEST_LENGTH ? realloc(request, capacity) : NULL;
+            if (newRequest == NULL)
+                break;
+            request = newRequest;
+        }
+        result = read(client, request + length, capacity - length - 1);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            break;
+        length += (size_t)result;
+        request[length] = '\0';
+        if (length >= 2 && strstr(request, "\n\n") != NULL)
+            return request;
+    }
+    free(request);
+    return NULL;
+}
+
+/* Writes a whole buffer to a client, which may have gone away.*/
+static void writeAll(int fd, const char *bytes, size_t length) {
+    ssize_t result;
+    while (length > 0) {
+        result = write(fd, bytes, length);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            return;
+        bytes += result;
+        length -= (size_t)result;
+    }
+}
+
+/* Serves command lines on a Unix-domain socket.*/
+int serveSocket(const char *socketPath, command_function run, void *arg) {
+    struct sockaddr_un address;
+    char *request, **lines, reply[32];
+    int server, client, count, status, startDirectory;
+    boolean stop = FALSE;
+
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        printf("The socket path '%s' is too long.\n", socketPath);
+        return 1;
+    }
+    /*every request runs in the directory of its client - the daemon returns here after each one, so a relative socket path stays valid*/
+    startDirectory = open(".", O_RDONLY);
+    if (startDirectory < 0) {
+        printf("Could not open the working directory: %s.\n", strerror(errno));
+        return 1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+    server = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath); /*the socket of a daemon that is gone*/
+    if (server < 0 || bind(server, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(server, 16) != 0) {
+        printf("Could not listen on '%s': %s.\n", socketPath, strerror(errno));
+        if (server >= 0)
+            close(server);
+        close(startDirectory);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN); /*a client that goes away must not end the daemon*/
+    printf("Listening on %s.\n", socketPath);
+    fflush(stdout);
+
+    while (!stop) {
+        client = accept(server, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        request = readRequest(client);
+        count = request != NULL ? splitLines(request, &lines) : -1;
+        if (count < 1) {
+            status = 2;
+            strcpy(reply, "Invalid request.\n");
+            writeAll(client, reply, strlen(reply));
+        } else if (count == 2 && strcmp(lines[1], STOP_REQUEST) == 0) {
+            status = 0;
+            stop = TRUE;
+        } else if (chdir(lines[0]) != 0) {
+            status = 2;
+            strcpy(reply, "Invalid working directory.\n");
+            writeAll(client, reply, strlen(reply));
+        } else {
+            lines[0] = PROGRAM_NAME;
+            status = runCaptured(client, count, lines, run, arg);
+        }
+        /*the zero byte cannot appear in what the assembler prints*/
+        reply[0] = '\0';
+        sprintf(reply + 1, "%d\n", status);
+        writeAll(client, reply, 1 + strlen(reply + 1));
+        close(client);
+        if (count >= 0)
+            free(lines);
+        free(request);
+        if (fchdir(startDirectory) != 0) {
+            printf("Could not return to the working directory: %s.\n", strerror(errno));
+            break;
+        }
+    }
+    close(server);
+    unlink(socketPath);
+    close(startDirectory);
+    return 0;
+}
+
+/* Reads the arguments of a request, {"cwd": "...", "args": ["...", ...]}. The arguments start at index 1, for the program name,
+   and point into the request. Returns the number of arguments including the program name, or -1 if the request is not valid.*/
+static int parseJsonRequest(const json_value *request, char ***args, const char **cwd) {
+    const json_value *list = jsonMember(request, "args");
+    int i, count = list != NULL && list->type == JSON_ARRAY ? list->count : 0;
+
+    *cwd = jsonString(request, "cwd");
+    if (request->type != JSON_OBJECT || (jsonMember(request, "cwd") != NULL && *cwd == NULL) || (list != NULL && list->type != JSON_ARRAY))
+        return -1;
+    for (i = 0; i < request->count; i++) {
+        if (strcmp(request->items[i].key, "cwd") != 0 && strcmp(request->items[i].key, "args") != 0)
+            return -1; /*an unknown key*/
+    }
+    if ((*args = malloc((count + 2) * sizeof(char *))) == NULL)
+        return -1;
+    (*args)[0] = PROGRAM_NAME;
+    for (i = 0; i < count; i++) {
+        if (list->items[i].type != JSON_STRING) {
+            free(*args);
+            return -1;
+        }
+        (*args)[i + 1] = list->items[i].string;
+    }
+    (*args)[count + 1] = NULL;
+    return count + 1;
+}
+
+/* Reads a line of any length. Returns NULL at the end of the input.*/
+static char *readLongLine(FILE *input) {
+    char *line = NULL, *newLine;
+    size_t length = 0, capacity = 0;
+    int ch;
+
+    while ((ch = fgetc(input)) != EOF && ch != '\n') {
+        if (length + 1 >= capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            newLine = capacity <= (size_t)MAX_REQUEST_LENGTH ? realloc(line, capacity) : NULL;
+            if (newLine == NULL) {
+                free(line);
+                return NULL;
+            }
+            line = newLine;
+        }
+        line[length++] = (char)ch;
+    }
+    if (line == NULL && ch == EOF)
+        return NULL;
+    if (line == NULL && (line = malloc(1)) == NULL)
+        return NULL;
+    line[length] = '\0';
+    return line;
+}
+
+/* Serves a stream of JSON requests, one per line.*/
+int serveRequestStream(FILE *input, FILE *output, command_function run, void *arg) {
+    char *line, **args, *captured;
+    const char *cwd;
+    long length;
+    int count, status, startDirectory = open(".", O_RDONLY);
+    FILE *capture;
+    json_value *request;
+    output_buffer reply;
+
+    if (startDirectory < 0) {
+        fprintf(output, "{\"status\": 2, \"error\": \"the working directory cannot be opened\"}\n");
+        return 1;
+    }
+    while ((line = readLongLine(input)) != NULL) {
+        if (strspn(line, " \t\r") == strlen(line)) {
+            free(line);
+            continue;
+        }
+        request = parseJson(line, strlen(line));
+        free(line);
+        count = request != NULL ? parseJsonRequest(request, &args, &cwd) : -1;
+        if (count < 0) {
+            fprintf(output, "{\"status\": 2, \"error\": \"invalid request\"}\n");
+            fflush(output);
+            freeJson(request);
+            continue;
+        }
+        capture = tmpfile();
+        if (cwd != NULL && chdir(cwd) != 0) {
+            fprintf(output, "{\"status\": 2, \"error\": \"invalid working directory\"}\n");
+        } else if (capture == NULL) {
+            fprintf(output, "{\"status\": 2, \"error\": \"no room for the output\"}\n");
+        } else {
+            status = runCaptured(fileno(capture), count, args, run, arg);
+            fseek(capture, 0, SEEK_END);
+            length = ftell(capture);
+            rewind(capture);
+            captured = malloc(length > 0 ? (size_t)length : 1);
+            reply.bytes = NULL;
+            reply.length = 0;
+            reply.capacity = 0;
+            if (captured != NULL && fread(captured, 1, (size_t)length, capture) == (size_t)length
+                    && appendJsonText(&reply, "{\"status\": ") && appendJsonNumber(&reply, status)
+                    && appendJsonText(&reply, ", \"output\": ") && appendJsonString(&reply, captured, (size_t)length)
+                    && appendJsonText(&reply, "}\n")) {
+                fputs(reply.bytes, output);
+            } else {
+                fprintf(output, "{\"status\": 2, \"error\": \"the output could not be read\"}\n");
+            }
+            free(reply.bytes);
+            free(captured);
+        }
+        fflush(output);
+        if (capture != NULL)
+            fclose(capture);
+        free(args);
+        freeJson(request);
+        /*a request without a working directory runs where the server started, not where the last one ran*/
+        if (fchdir(startDirectory) != 0)
+            break;
+    }
+    close(startDirectory);
+    return 0;
+}
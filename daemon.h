@@ -0,0 +1,38 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <stdio.h>
+#include "utils.h"
+
+/*Longest request, in bytes - a working directory and a command line*/
+#define MAX_REQUEST_LENGTH (1024L * 1024)
+/*The request that stops a daemon*/
+#define STOP_REQUEST "--stop"
+
+/*Runs one command line - argv[0] is the program name - and returns its exit status*/
+typedef int (*command_function)(int argc, char *argv[], void *arg);
+
+/**
+ * Serves command lines on a Unix-domain socket until a client sends the single argument STOP_REQUEST.
+ * A request is the working directory of the client and then one argument per line, ended by an empty line.
+ * The reply is everything the command line printed, a zero byte and the exit status in decimal.
+ * The command lines run one at a time, in the working directory of their client.
+ * @param socketPath The path of the socket - an old socket at the same path is replaced.
+ * @param run Runs a command line.
+ * @param arg Passed to every call of run, e.g. the state kept from one command line to the next.
+ * @return The exit status of the daemon.
+ */
+int serveSocket(const char *socketPath, command_function run, void *arg);
+
+/**
+ * Serves a stream of requests, one JSON object per line, e.g. {"cwd": "/src", "args": ["-O", "a.as"]}.
+ * "cwd" is optional. Every request is answered with a line {"status": 0, "output": "..."}, in the order of the requests.
+ * @param input The requests.
+ * @param output The replies.
+ * @param run Runs a command line.
+ * @param arg Passed to every call of run.
+ * @return The exit status - 0 once the input ends.
+ */
+int serveRequestStream(FILE *input, FILE *output, command_function run, void *arg);
+
+#endif /*DAEMON_H*/
@@ -1,17 +1,22 @@
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "parser.h"
 #include "directives.h"
 #include "labels.h"
+#include "image.h"
 #include "utils.h"
 
 /**
  * @brief Handles ".entry" and ".extern" directives, updating the label table.
  * @param token       The directive token.
  * @param line        Pointer to the current line being processed.
- * @param codeImage   Machine words array for instructions.
- * @param dataImage   Machine words array for data.
+ * @param image The code and data images.
  * @param labelTable  The table of labels.
  * @param isData      Indicates if the directive is for data.
  * @param isExternal  Indicates if the directive is external.
@@ -21,128 +26,419 @@
  * @param lineNumber  Current line number.
  * @return TRUE if successful parsing, FALSE otherwise.
  */
-static boolean parseDirectiveExtEnt(Token token, char ** line, machine_word codeImage[], machine_word dataImage[], label_table 
+static boolean parseDirectiveExtEnt(Token token, char ** line, machine_image *image, label_table 
 *labelTable, boolean isData, boolean isExternal, boolean isEntry, int *IC, int *DC, int lineNumber);
 
 /**
  * @brief Parses a ".string" directive and generates machine words for string storage.
- * @param token  The token after the ".string" directive.
+ * The string may hold spaces and the escape sequences \n, \t, \" and \\.
  * @param line  Pointer to the current line being processed.
- * @param dataImage  Machine words array to store the data.
+ * @param lineStart  The beginning of the line, for error columns.
+ * @param image The code and data images.
  * @param IC  Instruction counter.
  * @param DC  Data counter.
  * @param lineNumber  Current line number.
  * @return TRUE if successful parsing, FALSE otherwise.
  */
-static boolean parseDirectiveString(Token token, char **line, machine_word dataImage[], const int *IC, int *DC, int lineNumber);
+static boolean parseDirectiveString(char **line, const char *lineStart, machine_image *image, const int *IC, int *DC, int lineNumber);
+
+/**
+ * @brief Parses a ".pstring" directive and packs the string into as many 6-bit characters as fit in a data word.
+ * @param line  Pointer to the current line being processed.
+ * @param lineStart  The beginning of the line, for error columns.
+ * @param image The code and data images.
+ * @param IC  Instruction counter.
+ * @param DC  Data counter.
+ * @param lineNumber  Current line number.
+ * @return TRUE if successful parsing, FALSE otherwise.
+ */
+static boolean parseDirectivePackedString(char **line, const char *lineStart, machine_image *image, const int *IC, int *DC, int lineNumber);
+
+/**
+ * @brief Parses a ".fill" or ".space" directive and reserves a run of identical data words.
+ * @param hasValue  TRUE for ".fill", which takes the value of the words after their number.
+ * @param line  Pointer to the current line being processed.
+ * @param lineStart  The beginning of the line, for error columns.
+ * @param image The code and data images.
+ * @param IC  Instruction counter.
+ * @param DC  Data counter.
+ * @param lineNumber  Current line number.
+ * @return TRUE if successful parsing, FALSE otherwise.
+ */
+static boolean parseDirectiveFill(boolean hasValue, char **line, const char *lineStart, machine_image *image, const int *IC, int *DC, int lineNumber);
+
+/**
+ * @brief Parses an ".incbin" directive and embeds the bytes of a binary file as data words.
+ * @param line  Pointer to the current line being processed.
+ * @param image The code and data images.
+ * @param IC  Instruction counter.
+ * @param DC  Data counter.
+ * @param lineNumber  Current line number.
+ * @return TRUE if successful parsing, FALSE otherwise.
+ */
+static boolean parseDirectiveIncbin(char **line, machine_image *image, const int *IC, int *DC, int lineNumber);
 /*************************************************************************************************/
 
-/*Directives */
-char * directives[] = {
-        ".data",
-        ".string",
-        ".entry",
-        ".extern"
-};
+/*SWAR constants - four characters in the lanes of an unsigned long, the first character in the lowest lane*/
+#define LANES_LOW_NIBBLES 0x0F0F0F0FUL
+#define LANES_HIGH_NIBBLES 0xF0F0F0F0UL
+#define LANES_ASCII_ZERO 0x30303030UL
+#define LANES_SIX 0x06060606UL
+#define LANES_MASK 0xFFFFFFFFUL
 
+/*a packed string holds as many 6-bit character codes as fit in a word*/
+#define PACKED_CHAR_BITS 6
+#define PACKED_CHARS_PER_WORD (ISA_WORD_BITS / PACKED_CHAR_BITS)
 
+/* Prints an error about the element of a ".data" list that starts at the given column.*/
+static void printDataError(const char *error, const char *element, const char *lineStart, int lineNumber) {
+    char message[MAX_LINE_LENGTH + 64];
+    sprintf(message, "%s at column %d", error, (int)(element - lineStart) + 1);
+    printError(message, lineNumber);
+}
+
+/* Reads a run of decimal digits, four characters at a time, stopping once the value is past limit. Returns the number of digits read.*/
+static int readDigits(const char *p, const char *end, long limit, long *value) {
+    unsigned long chunk, digits, nonDigits, pairs;
+    int count = 0, lane, available;
+
+    *value = 0;
+    for (;;) {
+        /*load up to four characters - missing ones are left as 0, which is not a digit*/
+        available = (end - p) < 4 ? (int)(end - p) : 4;
+        chunk = 0;
+        for (lane = 0; lane < available; lane++)
+            chunk |= (unsigned long)(unsigned char)p[lane] << (8 * lane);
+
+        /*a lane is a digit if its high nibble is 3 and its low nibble is below 10*/
+        digits = chunk ^ LANES_ASCII_ZERO;
+        nonDigits = (digits | ((digits & LANES_LOW_NIBBLES) + LANES_SIX)) & LANES_HIGH_NIBBLES;
+        for (lane = 0; lane < 4 && ((nonDigits >> (8 * lane)) & 0xFF) == 0; lane++)
+            ;
+        if (lane == 0)
+            return count;
 
+        /*line the digits up with the high lanes, so the missing leading digits are zeros, and combine them in pairs*/
+        digits = (digits << (8 * (4 - lane))) & LANES_MASK;
+        digits = ((digits & 0x0F0F0F0FUL) * 10 + ((digits >> 8) & 0x0F0F0F0FUL)) & 0x00FF00FFUL;
+        pairs = (digits & 0xFF) * 100 + ((digits >> 16) & 0xFF);
 
-/*Processes ".data" directive and generates machine words for data storage.*/
-boolean parseDirectiveData(char ** line, machine_word dataImage[], const int *IC, int *DC, int lineNumber) {
-    int numberCounter = 0, commaCounter = 0;
-    Token token = getNextToken(line, lineNumber);
+        *value = *value * (lane == 4 ? 10000 : lane == 3 ? 1000 : lane == 2 ? 100 : 10) + (long)pairs;
+        count += lane;
+        p += lane;
+        if (lane < 4 || *value > limit)
+            return count;
+    }
+}
 
-    /* Check if we have already reached the maximum number of machine words*/
-    if ((*IC + *DC) >= MAX_FILE_SIZE) {
-        printWarning("Maximum number of machine words (1024) reached.", lineNumber);
+/* Reads a signed decimal number of a directive operand list. Prints an error naming its column if it is malformed.*/
+static boolean readDataNumber(char **p, const char *end, const char *lineStart, long *value, int lineNumber) {
+    char *element = skipSpaces(*p);
+    char *digitsStart = element;
+    int sign = 1, digitCount;
+
+    /*an optional sign, then the digits*/
+    if (*digitsStart == '-' || *digitsStart == '+') {
+        sign = (*digitsStart == '-') ? -1 : 1;
+        digitsStart++;
+    }
+    digitCount = readDigits(digitsStart, end, ISA_WORD_MAX + 1L, value);
+    if (digitCount == 0) {
+        printDataError((*element == ',' || *element == '\0' || *element == '\n') ? "Missing number" : "Invalid number", element, lineStart, lineNumber);
         return FALSE;
     }
+    *value *= sign;
+    if (isdigit((unsigned char)digitsStart[digitCount]) || *value < ISA_WORD_MIN || *value > ISA_WORD_MAX) {
+        printDataError("Number does not fit in a word", element, lineStart, lineNumber);
+        return FALSE;
+    }
+    *p = skipSpaces(digitsStart + digitCount);
+
+    /*the number is followed by a comma or by the end of the line*/
+    if (**p != '\0' && **p != ',') {
+        printDataError("Invalid number", element, lineStart, lineNumber);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Reads the number of words of a ".fill" or ".space" directive - it is bounded by the memory, not by the word size.*/
+static boolean readWordCount(char **p, const char *end, const char *lineStart, const machine_image *image, long *count, int lineNumber) {
+    char *element = skipSpaces(*p);
+    char *digitsStart = element;
+    int digitCount;
 
-    while (token.type != END) {
-        if (token.type == NUMBER) {
-            numberCounter++;
-            /*save number*/
-            dataImage[*DC].word.data_word.data = token.type & 0xFFF; /*Convert to a 12-bit word */
-            dataImage[*DC].word.data_word.line_number = lineNumber;
-            dataImage[*DC].wordType = DATA_WORD_TYPE;
-            (*DC)++;
-        }else if (token.type == COMMA){
-            commaCounter++;
-        }else {
-            printError("Invalid character.", lineNumber);
+    if (*digitsStart == '-' || *digitsStart == '+')
+        digitsStart++;
+    digitCount = readDigits(digitsStart, end, image->memorySize, count);
+    if (digitCount == 0) {
+        printDataError((*element == ',' || *element == '\0' || *element == '\n') ? "Missing number" : "Invalid number", element, lineStart, lineNumber);
+        return FALSE;
+    }
+    if (*element == '-' || *count == 0) {
+        printDataError("The number of words must be positive", element, lineStart, lineNumber);
+        return FALSE;
+    }
+    if (isdigit((unsigned char)digitsStart[digitCount]) || *count > image->memorySize) {
+        printWarning("Maximum number of machine words reached.", lineNumber);
+        return FALSE;
+    }
+    *p = skipSpaces(digitsStart + digitCount);
+
+    /*the number is followed by a comma or by the end of the line*/
+    if (**p != '\0' && **p != ',') {
+        printDataError("Invalid number", element, lineStart, lineNumber);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*Processes ".data" directive - scans the comma separated list itself and stores the numbers straight into the data image.*/
+boolean parseDirectiveData(char ** line, const char *lineStart, machine_image *image, const int *IC, int *DC, int lineNumber) {
+    char *p = *line, *end = *line + strlen(*line);
+    long value;
+
+    for (;;) {
+        if (!readDataNumber(&p, end, lineStart, &value, lineNumber))
             return FALSE;
-        }
 
         /*Check if we have reached the maximum number of machine words*/
-        if ((*IC + *DC) >= MAX_FILE_SIZE) {
-            printWarning("Maximum number of machine words (1024) reached.", lineNumber);
-            break;
+        if (!reserveData(image, *IC, *DC, 1, lineNumber))
+            return FALSE;
+        *storedData(image, (*DC)++) = (word_t)(value & WORD_MASK); /*Convert to a word*/
+
+        if (*p == '\0') {
+            *line = p;
+            return TRUE;
         }
-        token = getNextToken(line, lineNumber);
+        p++; /*skip the comma*/
     }
+}
 
-    if (numberCounter == (commaCounter+1))
-        return TRUE;
-    else {
-        printError("Invalid number of commas.", lineNumber);
+/* Processes ".fill" and ".space" directives - reserves a run of identical words without storing them one by one.*/
+static boolean parseDirectiveFill(boolean hasValue, char **line, const char *lineStart, machine_image *image, const int *IC, int *DC, int lineNumber) {
+    char *p = *line, *end = *line + strlen(*line);
+    long count, value = 0;
+
+    if (!readWordCount(&p, end, lineStart, image, &count, lineNumber))
         return FALSE;
+    if (hasValue) {
+        if (*p != ',') {
+            printError("'.fill' needs a number of words and a value", lineNumber);
+            return FALSE;
+        }
+        p++;
+        if (!readDataNumber(&p, end, lineStart, &value, lineNumber))
+            return FALSE;
     }
+    if (*p != '\0') {
+        printError(hasValue ? "'.fill' takes a number of words and a value" : "'.space' takes only a number of words", lineNumber);
+        return FALSE;
+    }
+    /*the run is not stored word by word, so only its size is checked*/
+    if (*IC + *DC + count > image->memorySize) {
+        printWarning("Maximum number of machine words reached.", lineNumber);
+        return FALSE;
+    }
+    if (!addFill(image, *DC, (int)count, (word_t)(value & WORD_MASK), lineNumber))
+        return FALSE;
+    *DC += (int)count;
+    *line = p;
+    return TRUE;
 }
 
+/* Processes ".incbin" directive - maps the file and packs its bytes into data words, most significant bits first.*/
+static boolean parseDirectiveIncbin(char **line, machine_image *image, const int *IC, int *DC, int lineNumber) {
+    char fileName[MAX_LINE_LENGTH + 1];
+    char *p = skipSpaces(*line), *closing;
+    const unsigned char *bytes;
+    word_t *out;
+    unsigned long bits = 0;
+    long size, words, i;
+    int fd, bitCount = 0, index;
+    struct stat info;
 
-
-/* Processes a string directive and generates machine words for string storage.*/
-static boolean parseDirectiveString(Token token, char **line, machine_word dataImage[], const int *IC, int *DC, int lineNumber) {
-    int i = 0, asciiValue;
-    int counter = 0;
-    /*move to the token after the ".string" directive*/
-    token = getNextToken( line, lineNumber);
-    /*check if string starts and ends with quotation marks*/
-    if (token.value.string[0] != '"' || token.value.string[strlen(token.value.string) - 1] != '"') {
-        printError("String should start and end with quotation marks.", lineNumber);
+    /*the operand is a file name in quotation marks*/
+    closing = (*p == '"') ? strchr(p + 1, '"') : NULL;
+    if (closing == NULL || closing == p + 1) {
+        printError("'.incbin' needs a file name in quotation marks", lineNumber);
+        return FALSE;
+    }
+    if (*skipSpaces(closing + 1) != '\0') {
+        printError("Invalid character after file name.", lineNumber);
+        return FALSE;
+    }
+    memcpy(fileName, p + 1, closing - p - 1);
+    fileName[closing - p - 1] = '\0';
+    *line = skipSpaces(closing + 1);
+    if (image->noFiles) {
+        printError("'.incbin' cannot be used - the source is assembled without reading files", lineNumber);
         return FALSE;
     }
 
-    /*check that the next token is the end of the line*/
-    token = getNextToken( line, lineNumber);
-    if (token.type != END) {
-        printError("Invalid character after string.", lineNumber);
+    /*listed before it is opened, so a file that does not exist yet is still watched by --watch*/
+    if (!addInclude(image, fileName, lineNumber))
+        return FALSE;
+    fd = open(fileName, O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) < 0) {
+        printError("Could not open the file of '.incbin'", lineNumber);
+        if (fd >= 0)
+            close(fd);
+        return FALSE;
+    }
+    size = (long)info.st_size;
+    if (size == 0) {
+        close(fd);
+        return TRUE; /*nothing to embed*/
+    }
+    words = (size * 8 + ISA_WORD_BITS - 1) / ISA_WORD_BITS;
+    if (*IC + *DC + words > image->memorySize) {
+        printWarning("Maximum number of machine words reached.", lineNumber);
+        close(fd);
+        return FALSE;
+    }
+    if (!reserveData(image, *IC, *DC, (int)words, lineNumber)) {
+        close(fd);
         return FALSE;
     }
+    bytes = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (bytes == MAP_FAILED) {
+        printError("Could not read the file of '.incbin'", lineNumber);
+        return FALSE;
+    }
+
+    /*stream the bytes into words - the last word is padded with zero bits*/
+    out = storedData(image, *DC);
+    index = 0;
+    for (i = 0; i < size; i++) {
+        bits = (bits << 8) | bytes[i];
+        bitCount += 8;
+        while (bitCount >= ISA_WORD_BITS) {
+            bitCount -= ISA_WORD_BITS;
+            out[index++] = (word_t)((bits >> bitCount) & WORD_MASK);
+        }
+        bits &= (1UL << bitCount) - 1;
+    }
+    if (bitCount > 0)
+        out[index++] = (word_t)((bits << (ISA_WORD_BITS - bitCount)) & WORD_MASK);
+    munmap((void *)bytes, (size_t)size);
+
+    *DC += index;
+    return TRUE;
+}
 
-    /*save the string as data words*/
-    while (token.value.string[i] != '\0') {
-        asciiValue = (unsigned char)token.value.string[i];
-        if ((*IC + counter + *DC) < MAX_MEMORY_SPACE) {
-            i++;
-            dataImage[*DC + counter].word.data_word.data = asciiValue & 0xFFF; /*Convert to a 12-bit word */
-            dataImage[*DC + counter].word.data_word.line_number = lineNumber;
-            dataImage[*DC + counter].wordType = DATA_WORD_TYPE;
-            counter++;
-        } else {
-            printWarning("Maximum number of machine words (1024) reached.", lineNumber);
+
+
+/* Scans the quoted string operand of a string directive straight from the line, decoding escape sequences,
+   and widens each character into a word of out. Checks that nothing follows the closing quotation mark.*/
+static boolean scanStringLiteral(char **line, const char *lineStart, word_t *out, int capacity, int *length, int lineNumber) {
+    char *p = skipSpaces(*line), *literal = p;
+    int ch;
+
+    if (*p != '"') {
+        printDataError("String should start with a quotation mark", p, lineStart, lineNumber);
+        return FALSE;
+    }
+    *length = 0;
+    for (p++; *p != '"'; p++) {
+        ch = (unsigned char)*p;
+        if (ch == '\0' || ch == '\n') {
+            printDataError("String is missing its closing quotation mark", literal, lineStart, lineNumber);
+            return FALSE;
+        }
+        if (ch == '\\') {
+            p++;
+            switch (*p) {
+                case 'n': ch = '\n'; break;
+                case 't': ch = '\t'; break;
+                case '"': ch = '"'; break;
+                case '\\': ch = '\\'; break;
+                default:
+                    printDataError("Unknown escape sequence", p - 1, lineStart, lineNumber);
+                    return FALSE;
+            }
+        }
+        if (*length == capacity) {
+            printWarning("Maximum number of machine words reached.", lineNumber);
             return FALSE;
         }
+        out[(*length)++] = (word_t)(ch & WORD_MASK);
     }
-    /*adding '\0'*/
-    if ((*DC + counter + *IC) < MAX_MEMORY_SPACE) {
-        dataImage[*DC + counter].word.data_word.data = '\0'; /*Convert to a 12-bit word */
-        dataImage[*DC + counter].word.data_word.line_number = lineNumber;
-        counter++;
-    } else {
-        printWarning("Maximum number of machine words (1024) reached.", lineNumber);
+
+    /*check that the string is the last operand of the line*/
+    p = skipSpaces(p + 1);
+    if (*p != '\0') {
+        printDataError("Invalid character after string", p, lineStart, lineNumber);
         return FALSE;
     }
+    *line = p;
+    return TRUE;
+}
+
+/* Processes a string directive - the characters are written into the data image as they are scanned.*/
+static boolean parseDirectiveString(char **line, const char *lineStart, machine_image *image, const int *IC, int *DC, int lineNumber) {
+    int length, capacity;
+
+    /*leave room for the terminating zero word*/
+    if (!reserveData(image, *IC, *DC, 1, lineNumber))
+        return FALSE;
+    /*a string is no longer than its line, so the characters are scanned straight into the data image*/
+    capacity = MIN(MAX_LINE_LENGTH, image->memorySize - *IC - *DC - 1);
+    if (!reserveData(image, *IC, *DC, capacity + 1, lineNumber))
+        return FALSE;
+    if (!scanStringLiteral(line, lineStart, storedData(image, *DC), capacity, &length, lineNumber))
+        return FALSE;
+    storedData(image, *DC)[length] = 0;
 
     /*update the DC counter*/
-    *DC += counter;
+    *DC += length + 1;
+    return TRUE;
+}
+
+
+/* Maps a character to its 6-bit packed code - space to '^' are 1 to 63, lower case letters fold to upper case, 0 is the terminator.*/
+static int packedCharCode(int ch) {
+    ch = toupper(ch);
+    if (ch < ' ' || ch > '^')
+        return -1;
+    return ch - ' ' + 1;
+}
+
+/* Processes a packed string directive - PACKED_CHARS_PER_WORD 6-bit characters per data word, ended by a zero code.*/
+static boolean parseDirectivePackedString(char **line, const char *lineStart, machine_image *image, const int *IC, int *DC, int lineNumber) {
+    int i, code, length, words;
+    word_t string[MAX_LINE_LENGTH], *out;
+
+    if (!scanStringLiteral(line, lineStart, string, MAX_LINE_LENGTH, &length, lineNumber))
+        return FALSE;
+
+    /*the characters, PACKED_CHARS_PER_WORD to a word, and the terminator code*/
+    words = length / PACKED_CHARS_PER_WORD + 1;
+    if (!reserveData(image, *IC, *DC, words, lineNumber))
+        return FALSE;
+
+    /*the first character of a word goes to its highest 6 bits - a string whose last word is not full ends with its zero low bits*/
+    out = storedData(image, *DC);
+    for (i = 0; i < words; i++)
+        out[i] = 0;
+    for (i = 0; i < length; i++) {
+        code = packedCharCode(string[i]);
+        if (code < 0) {
+            printError("Character cannot be stored in a packed string.", lineNumber);
+            return FALSE;
+        }
+        out[i / PACKED_CHARS_PER_WORD] |= code << (PACKED_CHAR_BITS * (PACKED_CHARS_PER_WORD - 1 - i % PACKED_CHARS_PER_WORD));
+    }
+
+    /*update the DC counter*/
+    *DC += words;
     return TRUE;
 }
 
 
 /*Handles ".entry" and ".extern" directives, updating the label table.*/
-static boolean parseDirectiveExtEnt(Token token, char ** line, machine_word codeImage[], machine_word dataImage[], label_table 
+static boolean parseDirectiveExtEnt(Token token, char ** line, machine_image *image, label_table 
 *labelTable, boolean isData, boolean isExternal, boolean isEntry, int *IC, int *DC, int lineNumber) {
     int tokenCounter = 1;
     boolean isLable = FALSE;
@@ -153,14 +449,7 @@ static boolean parseDirectiveExtEnt(Token token, char ** line, machine_word code
     }
     while (token.type != END && tokenCounter <= 3 && token.type != INVALID) {
         if (tokenCounter == 2 && token.type == LABEL) {
-        	if(isEntry){
-        
-            	isLable = parseLabel(token, line, codeImage, dataImage, labelTable, 0, isExternal, TRUE, IC, DC, lineNumber);
-            }
-            if(isExternal)
-            {
-            	isLable = parseLabel(token, line, codeImage, dataImage, labelTable, 0, isExternal, TRUE, IC, DC, lineNumber);
-            }
+            isLable = parseLabel(token, line, image, labelTable, FALSE, isExternal, isEntry, IC, DC, lineNumber);
         }
         token = getNextToken(line, lineNumber);
         tokenCounter++;
@@ -180,19 +469,33 @@ static boolean parseDirectiveExtEnt(Token token, char ** line, machine_word code
     return TRUE;
 }
 
+/*Checks if a directive stores words in the data image.*/
+boolean isDataDirective(const char *name) {
+    return strcmp(name, ".data") == 0 || strcmp(name, ".string") == 0 || strcmp(name, ".pstring") == 0
+        || strcmp(name, ".fill") == 0 || strcmp(name, ".space") == 0 || strcmp(name, ".incbin") == 0;
+}
+
 /*Main function that selects the appropriate parsing function based on the provided directive.*/
-boolean parseDirective(Token token, char ** line, machine_word codeImage[], machine_word dataImage[], label_table *labelTable, boolean isData, boolean isExternal, boolean isEntry, int *IC, int *DC, int lineNumber) {
+boolean parseDirective(Token token, char ** line, const char *lineStart, machine_image *image, label_table *labelTable, boolean isData, boolean isExternal, boolean isEntry, int *IC, int *DC, int lineNumber) {
     if (strcmp(token.value.string,  ".data") == 0) {
-        return parseDirectiveData(line, dataImage, IC, DC, lineNumber);
+        return parseDirectiveData(line, lineStart, image, IC, DC, lineNumber);
     } else if (strcmp(token.value.string,  ".string") == 0) {
-        return parseDirectiveString(token, line, dataImage, IC, DC, lineNumber);
+        return parseDirectiveString(line, lineStart, image, IC, DC, lineNumber);
+    } else if (strcmp(token.value.string,  ".pstring") == 0) {
+        return parseDirectivePackedString(line, lineStart, image, IC, DC, lineNumber);
+    } else if (strcmp(token.value.string,  ".fill") == 0) {
+        return parseDirectiveFill(TRUE, line, lineStart, image, IC, DC, lineNumber);
+    } else if (strcmp(token.value.string,  ".space") == 0) {
+        return parseDirectiveFill(FALSE, line, lineStart, image, IC, DC, lineNumber);
+    } else if (strcmp(token.value.string,  ".incbin") == 0) {
+        return parseDirectiveIncbin(line, image, IC, DC, lineNumber);
     }
     else if (strcmp(token.value.string,  ".entry") == 0) {
         isEntry = TRUE;
-        return parseDirectiveExtEnt(token, line, codeImage, dataImage, labelTable, FALSE, isExternal, isEntry, IC, DC, lineNumber);
+        return parseDirectiveExtEnt(token, line, image, labelTable, FALSE, isExternal, isEntry, IC, DC, lineNumber);
     } else if (strcmp(token.value.string,  ".extern") == 0) {
         isExternal = TRUE;
-        return parseDirectiveExtEnt(token, line, codeImage, dataImage, labelTable, FALSE, isExternal, isEntry, IC, DC, lineNumber);
+        return parseDirectiveExtEnt(token, line, image, labelTable, FALSE, isExternal, isEntry, IC, DC, lineNumber);
     } else {
         printError("If a word starts with a dot it must be an directive name.", lineNumber);
         return FALSE;
@@ -8,14 +8,14 @@
 
 
 /*Directives */
-extern char *directives[4];
+extern char *directives[NUM_OF_DIRECTIVES]; /*generated from the ISA description file*/
 
 /**
  * Processes an directive token and generates machines words appropriately.
  * @param token The directive token.
  * @param line The current line of assembly code.
- * @param codeImage Array to store the machine words for instructions.
- * @param dataImage Array to store the machine words for data.
+ * @param lineStart The beginning of the line, for error columns.
+ * @param image The code and data images.
  * @param labelTable The table of labels.
  * @param isData Indicates if the directive is defined as data.
  * @param isExternal Indicates if the directive is defined as external.
@@ -25,18 +25,28 @@ extern char *directives[4];
  * @param lineNumber The current line number being processed.
  * @return TRUE if processing was successful, FALSE otherwise.
  */
-boolean parseDirective(Token token, char ** line, machine_word codeImage[], machine_word dataImage[], label_table *labelTable, boolean isData, boolean isExternal, boolean isEntry, int *IC, int *DC, int lineNumber);
+boolean parseDirective(Token token, char ** line, const char *lineStart, machine_image *image, label_table *labelTable, boolean isData, boolean isExternal, boolean isEntry, int *IC, int *DC, int lineNumber);
 
 
 /**
  * @brief Processes ".data" directive and saves the numbers into the data image.
+ * The list is scanned directly, without building tokens, and the digits are converted four at a time.
+ * The column of the first malformed element is reported on error.
  * @param line Pointer to the current line being processed.
- * @param dataImage Machine words array to store the data.
+ * @param lineStart The beginning of the line, for error columns.
+ * @param image The code and data images.
  * @param IC Instruction counter.
  * @param DC Data counter.
  * @param lineNumber  Current line number.
  * @return TRUE if successful parsing, FALSE otherwise.
  */
-boolean parseDirectiveData(char ** line, machine_word dataImage[], const int *IC, int *DC, int lineNumber);
+boolean parseDirectiveData(char ** line, const char *lineStart, machine_image *image, const int *IC, int *DC, int lineNumber);
+
+/**
+ * Checks if a directive stores words in the data image, so that a label before it is a data label.
+ * @param name The directive name.
+ * @return TRUE if the directive is a data directive, FALSE otherwise.
+ */
+boolean isDataDirective(const char *name);
 
 #endif /* DIRECTIVES_H */
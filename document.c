@@ -0,0 +1,633 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "document.h"
+#include "parser.h"
+#include "labels.h"
+#include "image.h"
+#include "utils.h"
+
+/* Sum of the values of the first count lines in a Fenwick tree.*/
+static int prefixSum(const int *tree, int count) {
+    int sum = 0;
+    for (; count > 0; count -= count & -count)
+        sum += tree[count];
+    return sum;
+}
+
+/* Adds to the value of a line in a Fenwick tree.*/
+static void addToTree(int *tree, int size, int line, int delta) {
+    for (line++; line <= size; line += line & -line)
+        tree[line] += delta;
+}
+
+/* Builds the Fenwick trees of the sizes of the lines, in O(n).*/
+static void buildTrees(source_document *document) {
+    int i, parent, size = document->lineCount;
+    for (i = 1; i <= size; i++) {
+        document->codeTree[i] = document->lines[i - 1].codeWords;
+        document->dataTree[i] = document->lines[i - 1].dataWords;
+    }
+    for (i = 1; i <= size; i++) {
+        parent = i + (i & -i);
+        if (parent <= size) {
+            document->codeTree[parent] += document->codeTree[i];
+            document->dataTree[parent] += document->dataTree[i];
+        }
+    }
+}
+
+/* Finds the first line after which the code and data words together exceed a bound, or -1 if there is none.*/
+static int lineExceeding(const source_document *document, int bound) {
+    int position = 0, step = 1, sum = 0;
+    if (prefixSum(document->codeTree, document->lineCount) + prefixSum(document->dataTree, document->lineCount) <= bound)
+        return -1;
+    while (step * 2 <= document->lineCount)
+        step *= 2;
+    /*both trees have the same shape, so a node of their sum is the sum of their nodes*/
+    for (; step > 0; step /= 2) {
+        if (position + step <= document->lineCount && sum + document->codeTree[position + step] + document->dataTree[position + step] <= bound) {
+            position += step;
+            sum += document->codeTree[position] + document->dataTree[position];
+        }
+    }
+    return position;
+}
+
+/* Frees what a line was parsed into, and leaves it empty.*/
+static void clearLine(source_line *line) {
+    free(line->words);
+    free(line->symbols);
+    free(line->messages);
+    line->words = NULL;
+    line->symbols = NULL;
+    line->messages = NULL;
+    line->symbolCount = 0;
+    line->codeWords = 0;
+    line->dataWords = 0;
+}
+
+/* Copies a line the way the preprocessor reads it - at most MAX_LINE_LEN-1 characters, without its comment.*/
+static void preprocessedText(const char *text, char *line) {
+    char *commentStart;
+    sprintf(line, "%.*s", MAX_LINE_LEN - 1, text);
+    commentStart = strchr(line, ';');
+    if (commentStart)
+        *commentStart = '\0';
+}
+
+/* Checks if a line is blank to the preprocessor.*/
+static boolean isBlank(const char *line) {
+    return strspn(line, "\t\n\r\f\v") == strlen(line);
+}
+
+/* Checks if a line may start, end or be part of the definition of a macro - an edit of such a line may change the lines after it.*/
+static boolean isMacroLine(const source_line *line) {
+    return line->kind == LINE_MACRO_START || line->kind == LINE_MACRO_BODY || line->kind == LINE_MACRO_END || strstr(line->text, "mcro") != NULL;
+}
+
+/* Parses lines of source, as one line of the document that starts at address 0 of the code and data images.*/
+static void parseText(source_document *document, int index, const char *text) {
+    source_line *line = &document->lines[index];
+    char buffer[MAX_LINE_LENGTH+1]; /*the size the assembler reads lines with*/
+    const char *end = text + strlen(text);
+    label_table labelTable;
+    diagnostics messages, *previous;
+    label *current;
+    int IC = 0, DC = 0, i, ref, codeKept, dataKept;
+
+    labelTable.head = NULL;
+    labelTable.spare = NULL;
+    memset(&messages, 0, sizeof(messages));
+    initImage(document->scratch);
+    previous = setDiagnosticSink(&messages);
+    while (readSourceLine(&text, end, buffer, sizeof(buffer)) > 0)
+        parseLine(buffer, document->scratch, &labelTable, &IC, &DC, index + 1);
+    setDiagnosticSink(previous);
+
+    line->codeWords = IC;
+    line->dataWords = DC;
+    line->messages = messages.text;
+    codeKept = MIN(IC, LINE_HOVER_WORDS);
+    dataKept = MIN(DC, LINE_HOVER_WORDS);
+    if (codeKept + dataKept > 0 && (line->words = malloc((codeKept + dataKept) * sizeof(word_t))) != NULL) {
+        memcpy(line->words, document->scratch->code, codeKept * sizeof(word_t));
+        for (i = 0; i < dataKept; i++)
+            line->words[codeKept + i] = dataWord(document->scratch, i);
+    }
+
+    /*every label the line declares or names, and every word that holds the address of a label*/
+    for (current = labelTable.head; current != NULL; current = current->next)
+        line->symbolCount += (current->isDefined ? 1 : 0) + (current->isExternal ? 1 : 0) + (current->isEntry ? 1 : 0);
+    line->symbolCount += document->scratch->refCount;
+    if (line->symbolCount > 0 && (line->symbols = malloc(line->symbolCount * sizeof(line_symbol))) == NULL)
+        line->symbolCount = 0;
+    i = 0;
+    for (current = labelTable.head; current != NULL && line->symbols != NULL; current = current->next) {
+        if (current->isDefined) {
+            strcpy(line->symbols[i].name, current->name);
+            line->symbols[i].kind = current->isData ? SYMBOL_DATA : SYMBOL_CODE;
+            line->symbols[i++].offset = current->address;
+        }
+        if (current->isExternal) {
+            strcpy(line->symbols[i].name, current->name);
+            line->symbols[i].kind = SYMBOL_EXTERN;
+            line->symbols[i++].offset = 0;
+        }
+        if (current->isEntry) {
+            strcpy(line->symbols[i].name, current->name);
+            line->symbols[i].kind = SYMBOL_ENTRY;
+            line->symbols[i++].offset = 0;
+        }
+    }
+    for (ref = 0; ref < document->scratch->refCount && line->symbols != NULL; ref++) {
+        strcpy(line->symbols[i].name, document->scratch->refs[ref].name);
+        line->symbols[i].kind = SYMBOL_REFERENCE;
+        line->symbols[i++].offset = document->scratch->refs[ref].index;
+    }
+    freeLabelTable(&labelTable);
+    freeImage(document->scratch);
+}
+
+/* Parses a statement or a macro call, once its kind is known.*/
+static void parseDocumentLine(source_document *document, int index) {
+    source_line *line = &document->lines[index];
+    char text[MAX_LINE_LEN + 1], name[MAX_LINE_LEN];
+
+    clearLine(line);
+    if (line->kind == LINE_STATEMENT) {
+        preprocessedText(line->text, text);
+        strcat(text, "\n");
+        parseText(document, index, text);
+    } else if (line->kind == LINE_MACRO_CALL) {
+        preprocessedText(line->text, text);
+        sscanf(text, "%80s", name);
+        parseText(document, index, document->macros.macros[findMacro(&document->macros, name)].content);
+    }
+}
+
+/* Finds the kind of a line that does not start, end or belong to the definition of a macro.*/
+static line_kind statementKind(const source_document *document, int index) {
+    char text[MAX_LINE_LEN], name[MAX_LINE_LEN];
+    int macro;
+
+    preprocessedText(document->lines[index].text, text);
+    if (isBlank(text))
+        return LINE_EMPTY;
+    /*a macro is called by its name alone at the start of a line, once it is defined*/
+    name[0] = '\0';
+    sscanf(text, "%80s", name);
+    macro = findMacro(&document->macros, name);
+    return macro != -1 && document->macroEnds[macro] < index ? LINE_MACRO_CALL : LINE_STATEMENT;
+}
+
+/* Records where the last macro added to the table is defined.*/
+static boolean recordMacro(source_document *document, int start, int end) {
+    int index = document->macros.count - 1, *newStarts, *newEnds;
+    if (index >= document->macroCapacity) {
+        /* Double the capacity of the macro lines*/
+        int newCapacity = document->macroCapacity ? document->macroCapacity * 2 : 8;
+        newStarts = realloc(document->macroStarts, newCapacity * sizeof(int));
+        if (newStarts == NULL)
+            return FALSE;
+        document->macroStarts = newStarts;
+        newEnds = realloc(document->macroEnds, newCapacity * sizeof(int));
+        if (newEnds == NULL)
+            return FALSE;
+        document->macroEnds = newEnds;
+        document->macroCapacity = newCapacity;
+    }
+    document->macroStarts[index] = start;
+    document->macroEnds[index] = end;
+    return TRUE;
+}
+
+/* Finds the kind of every line and parses them all, the way the preprocessor and the first pass read a file.*/
+static boolean parseDocument(source_document *document) {
+    char text[MAX_LINE_LEN], macroName[MAX_LINE_LEN] = "", *content = NULL, *newContent;
+    size_t contentLength = 0;
+    boolean isInsideMacro = FALSE, valid = TRUE;
+    int i, start = 0, previousCount;
+    source_line *line;
+
+    freeMacroTable(&document->macros);
+    valid = initializeMacroTable(&document->macros);
+    for (i = 0; i < document->lineCount && valid; i++) {
+        line = &document->lines[i];
+        clearLine(line);
+        preprocessedText(line->text, text);
+        line->kind = LINE_EMPTY;
+        if (isBlank(text))
+            continue;
+        if (strstr(text, "mcro") && !strstr(text, "endmcro")) {
+            sscanf(text + LENGTH_OF_MCRO, "%80s", macroName);
+            if (isValidMacroName(macroName) && findMacro(&document->macros, macroName) == -1) {
+                if (!isInsideMacro)
+                    start = i;
+                isInsideMacro = TRUE;
+                line->kind = LINE_MACRO_START;
+                continue;
+            }
+        }
+        if (strstr(text, "endmcro") && isInsideMacro) {
+            isInsideMacro = FALSE;
+            line->kind = LINE_MACRO_END;
+            previousCount = document->macros.count;
+            addMacro(&document->macros, macroName, content ? content : "");
+            if (document->macros.count > previousCount)
+                valid = recordMacro(document, start, i);
+            free(content);
+            content = NULL;
+            contentLength = 0;
+            continue;
+        }
+        if (isInsideMacro) {
+            line->kind = LINE_MACRO_BODY;
+            newContent = realloc(content, contentLength + strlen(text) + 2);
+            if (newContent == NULL) {
+                valid = FALSE;
+                break;
+            }
+            content = newContent;
+            /*the preprocessor keeps the new line the line was read with*/
+            sprintf(content + contentLength, "%s\n", text);
+            contentLength += strlen(text) + 1;
+            continue;
+        }
+        line->kind = statementKind(document, i);
+        parseDocumentLine(document, i);
+    }
+    free(content);
+    buildTrees(document);
+    document->symbolsStale = TRUE;
+    return valid;
+}
+
+/* Makes room for more lines.*/
+static boolean reserveLines(source_document *document, int count) {
+    source_line *newLines;
+    int *newCodeTree, *newDataTree, newCapacity;
+    if (count <= document->lineCapacity)
+        return TRUE;
+    newCapacity = MAX(document->lineCapacity * 2, count);
+    newLines = realloc(document->lines, newCapacity * sizeof(source_line));
+    if (newLines == NULL)
+        return FALSE;
+    document->lines = newLines;
+    newCodeTree = realloc(document->codeTree, (newCapacity + 1) * sizeof(int));
+    if (newCodeTree == NULL)
+        return FALSE;
+    document->codeTree = newCodeTree;
+    newDataTree = realloc(document->dataTree, (newCapacity + 1) * sizeof(int));
+    if (newDataTree == NULL)
+        return FALSE;
+    document->dataTree = newDataTree;
+    document->lineCapacity = newCapacity;
+    return TRUE;
+}
+
+/* Counts the lines of a text - one more than its new lines.*/
+static int countLines(const char *text, size_t length) {
+    int count = 1;
+    size_t i;
+    for (i = 0; i < length; i++)
+        count += text[i] == '\n' ? 1 : 0;
+    return count;
+}
+
+/* Splits a text into new lines of a document, from the given index on. The lines must have room.*/
+static boolean splitLines(source_document *document, int index, const char *text, size_t length) {
+    const char *end = text + length, *newLine;
+    size_t lineLength;
+    source_line *line;
+
+    for (;; index++) {
+        newLine = memchr(text, '\n', end - text);
+        lineLength = (newLine != NULL ? newLine : end) - text;
+        line = &document->lines[index];
+        memset(line, 0, sizeof(source_line));
+        line->kind = LINE_EMPTY;
+        if ((line->text = malloc(lineLength + 1)) == NULL)
+            return FALSE;
+        memcpy(line->text, text, lineLength);
+        /*the carriage return of a Windows new line is not part of the line*/
+        if (lineLength > 0 && line->text[lineLength - 1] == '\r' && newLine != NULL)
+            lineLength--;
+        line->text[lineLength] = '\0';
+        if (newLine == NULL)
+            return TRUE;
+        text = newLine + 1;
+    }
+}
+
+/* Opens a document and parses all its lines.*/
+boolean openDocument(source_document *document, const char *text, size_t length) {
+    int count = countLines(text, length);
+
+    memset(document, 0, sizeof(source_document));
+    document->scratch = malloc(sizeof(machine_image));
+    if (!initializeMacroTable(&document->macros) || document->scratch == NULL || !reserveLines(document, count))
+        return FALSE;
+    if (!splitLines(document, 0, text, length)) {
+        document->lineCount = count; /*the lines are freed with the document - the ones not split yet have no text*/
+        return FALSE;
+    }
+    document->lineCount = count;
+    return parseDocument(document);
+}
+
+/* Replaces a range of a document with new text.*/
+boolean editDocument(source_document *document, int startLine, int startColumn, int endLine, int endColumn, const char *text, size_t length) {
+    char *joined;
+    size_t startLength, endLength, prefixLength, suffixLength;
+    int oldCount, newCount, delta, i, *oldCode = NULL, *oldData = NULL;
+    boolean reparseAll = FALSE, labelsMoved;
+
+    if (startLine < 0 || endLine >= document->lineCount || startLine > endLine || (startLine == endLine && startColumn > endColumn) || startColumn < 0 || endColumn < 0)
+        return FALSE;
+    startLength = strlen(document->lines[startLine].text);
+    endLength = strlen(document->lines[endLine].text);
+    prefixLength = MIN((size_t)startColumn, startLength);
+    suffixLength = endLength - MIN((size_t)endColumn, endLength);
+
+    /*the new lines are the start of the first line, the new text and the end of the last line*/
+    joined = malloc(prefixLength + length + suffixLength + 1);
+    if (joined == NULL)
+        return FALSE;
+    memcpy(joined, document->lines[startLine].text, prefixLength);
+    memcpy(joined + prefixLength, text, length);
+    memcpy(joined + prefixLength + length, document->lines[endLine].text + endLength - suffixLength, suffixLength);
+    joined[prefixLength + length + suffixLength] = '\0';
+    oldCount = endLine - startLine + 1;
+    newCount = countLines(joined, prefixLength + length + suffixLength);
+    delta = newCount - oldCount;
+    if (!reserveLines(document, document->lineCount + delta + 1)) {
+        free(joined);
+        return FALSE;
+    }
+
+    /*the sizes of the old lines, for the trees, if the lines are replaced one for one*/
+    if (delta == 0) {
+        oldCode = malloc(oldCount * sizeof(int));
+        oldData = malloc(oldCount * sizeof(int));
+    }
+    labelsMoved = delta != 0;
+    for (i = startLine; i <= endLine; i++) {
+        reparseAll |= isMacroLine(&document->lines[i]);
+        labelsMoved |= document->lines[i].symbolCount > 0;
+        if (oldCode != NULL && oldData != NULL) {
+            oldCode[i - startLine] = document->lines[i].codeWords;
+            oldData[i - startLine] = document->lines[i].dataWords;
+        }
+        clearLine(&document->lines[i]);
+        free(document->lines[i].text);
+    }
+    memmove(&document->lines[endLine + 1 + delta], &document->lines[endLine + 1], (document->lineCount - endLine - 1) * sizeof(source_line));
+    memset(&document->lines[startLine], 0, newCount * sizeof(source_line));
+    document->lineCount += delta;
+    if (!splitLines(document, startLine, joined, strlen(joined))) {
+        free(joined);
+        free(oldCode);
+        free(oldData);
+        for (i = startLine; i < startLine + newCount; i++) {
+            if (document->lines[i].text == NULL && (document->lines[i].text = malloc(1)) != NULL)
+                document->lines[i].text[0] = '\0';
+        }
+        parseDocument(document);
+        return FALSE;
+    }
+    free(joined);
+
+    /*the macros after the edit moved with their lines*/
+    for (i = 0; i < document->macros.count; i++) {
+        if (document->macroStarts[i] > endLine) {
+            document->macroStarts[i] += delta;
+            document->macroEnds[i] += delta;
+        }
+    }
+    for (i = startLine; i < startLine + newCount; i++)
+        reparseAll |= isMacroLine(&document->lines[i]);
+    if (reparseAll || (delta == 0 && (oldCode == NULL || oldData == NULL))) {
+        free(oldCode);
+        free(oldData);
+        return parseDocument(document);
+    }
+
+    for (i = startLine; i < startLine + newCount; i++) {
+        document->lines[i].kind = statementKind(document, i);
+        parseDocumentLine(document, i);
+        labelsMoved |= document->lines[i].symbolCount > 0;
+    }
+    if (delta != 0) {
+        buildTrees(document);
+    } else {
+        /*the addresses of all the lines after the edit follow from the prefix sums*/
+        for (i = startLine; i <= endLine; i++) {
+            addToTree(document->codeTree, document->lineCount, i, document->lines[i].codeWords - oldCode[i - startLine]);
+            addToTree(document->dataTree, document->lineCount, i, document->lines[i].dataWords - oldData[i - startLine]);
+        }
+    }
+    free(oldCode);
+    free(oldData);
+    document->symbolsStale |= labelsMoved;
+    return TRUE;
+}
+
+/* Frees a document.*/
+void closeDocument(source_document *document) {
+    int i;
+    for (i = 0; i < document->lineCount; i++) {
+        clearLine(&document->lines[i]);
+        free(document->lines[i].text);
+    }
+    free(document->lines);
+    free(document->codeTree);
+    free(document->dataTree);
+    freeMacroTable(&document->macros);
+    free(document->macroStarts);
+    free(document->macroEnds);
+    free(document->symbols);
+    free(document->symbolBuckets);
+    free(document->scratch);
+    memset(document, 0, sizeof(source_document));
+}
+
+/* Finds the address of the first code word of a line.*/
+int lineCodeAddress(const source_document *document, int line) {
+    return DEFAULT_BASE_ADDRESS + prefixSum(document->codeTree, line);
+}
+
+/* Finds the address of the first data word of a line.*/
+int lineDataAddress(const source_document *document, int line) {
+    return DEFAULT_BASE_ADDRESS + prefixSum(document->codeTree, document->lineCount) + prefixSum(document->dataTree, line);
+}
+
+/* Hashes a label name into a bucket of the symbol index.*/
+static int symbolBucket(const source_document *document, const char *name) {
+    unsigned long hash = 5381;
+    while (*name != '\0')
+        hash = hash * 33 + (unsigned char)*name++;
+    return (int)(hash & (document->bucketCount - 1));
+}
+
+/* Rebuilds the index of the declarations, if the lines that declare labels changed since it was built.*/
+static void indexSymbols(source_document *document) {
+    int i, j, bucket, count = 0, bucketCount = MIN_SYMBOL_BUCKETS, *newBuckets;
+    symbol_entry *newSymbols, *entry;
+    line_symbol *symbol;
+
+    if (!document->symbolsStale)
+        return;
+    document->symbolCount = 0;
+    for (i = 0; i < document->lineCount; i++)
+        count += document->lines[i].symbolCount;
+    if (count > document->symbolCapacity) {
+        newSymbols = realloc(document->symbols, count * sizeof(symbol_entry));
+        if (newSymbols == NULL)
+            return;
+        document->symbols = newSymbols;
+        document->symbolCapacity = count;
+    }
+    /*short chains - a fixed number of buckets would make every lookup of a large document walk a long one*/
+    while (bucketCount < 2 * count)
+        bucketCount *= 2;
+    if (bucketCount > document->bucketCount) {
+        newBuckets = realloc(document->symbolBuckets, bucketCount * sizeof(int));
+        if (newBuckets == NULL)
+            return;
+        document->symbolBuckets = newBuckets;
+        document->bucketCount = bucketCount;
+    }
+    for (i = 0; i < document->bucketCount; i++)
+        document->symbolBuckets[i] = -1;
+    /*the lines are added last to first, so every bucket lists its labels from the first line*/
+    for (i = document->lineCount - 1; i >= 0; i--) {
+        for (j = document->lines[i].symbolCount - 1; j >= 0; j--) {
+            symbol = &document->lines[i].symbols[j];
+            if (symbol->kind == SYMBOL_REFERENCE)
+                continue;
+            bucket = symbolBucket(document, symbol->name);
+            entry = &document->symbols[document->symbolCount];
+            entry->name = symbol->name;
+            entry->line = i;
+            entry->kind = symbol->kind;
+            entry->offset = symbol->offset;
+            entry->next = document->symbolBuckets[bucket];
+            document->symbolBuckets[bucket] = document->symbolCount++;
+        }
+    }
+    document->symbolsStale = FALSE;
+}
+
+/* Looks up the first entry of a label of the given kinds.*/
+static const symbol_entry *findSymbol(const source_document *document, const char *name, symbol_kind first, symbol_kind last) {
+    int index;
+    if (document->bucketCount == 0)
+        return NULL; /*never indexed - memory ran out*/
+    for (index = document->symbolBuckets[symbolBucket(document, name)]; index != -1; index = document->symbols[index].next) {
+        if (document->symbols[index].kind >= first && document->symbols[index].kind <= last && strcmp(document->symbols[index].name, name) == 0)
+            return &document->symbols[index];
+    }
+    return NULL;
+}
+
+/* Looks up the declaration of a label.*/
+const symbol_entry *findDeclaration(source_document *document, const char *name) {
+    const symbol_entry *declaration;
+    indexSymbols(document);
+    declaration = findSymbol(document, name, SYMBOL_CODE, SYMBOL_DATA);
+    return declaration != NULL ? declaration : findSymbol(document, name, SYMBOL_EXTERN, SYMBOL_EXTERN);
+}
+
+/* Finds the address of a label.*/
+int declarationAddress(const source_document *document, const symbol_entry *declaration) {
+    switch (declaration->kind) {
+        case SYMBOL_CODE:
+            return lineCodeAddress(document, declaration->line) + declaration->offset;
+        case SYMBOL_DATA:
+            return lineDataAddress(document, declaration->line) + declaration->offset;
+        default:
+            return -1;
+    }
+}
+
+/* Finds a code word of a line, with the address of the label it refers to filled in.*/
+word_t resolvedCodeWord(source_document *document, int line, int index, boolean *resolved) {
+    const source_line *current = &document->lines[line];
+    const symbol_entry *declaration;
+    int i;
+
+    *resolved = TRUE;
+    for (i = 0; i < current->symbolCount; i++) {
+        if (current->symbols[i].kind != SYMBOL_REFERENCE || current->symbols[i].offset != index)
+            continue;
+        declaration = findDeclaration(document, current->symbols[i].name);
+        *resolved = declaration != NULL;
+        if (declaration == NULL)
+            return current->words[index];
+        return declaration->kind == SYMBOL_EXTERN ? EXTERNAL_WORD : RELOCATABLE_WORD(declarationAddress(document, declaration));
+    }
+    return current->words[index];
+}
+
+/* Finds the definition of a macro.*/
+int findMacroDefinition(const source_document *document, const char *name) {
+    int macro = findMacro(&document->macros, name);
+    return macro != -1 ? document->macroStarts[macro] : -1;
+}
+
+/* Reports the errors and warnings a line printed, without the line numbers the assembler adds to them.*/
+static void reportLineMessages(const source_line *line, int index, problem_function report, void *arg) {
+    char message[MAX_LINE_LENGTH * 4], *text;
+    const char *start, *end;
+    size_t length;
+
+    for (start = line->messages; *start != '\0'; start = *end != '\0' ? end + 1 : end) {
+        end = strchr(start, '\n');
+        if (end == NULL)
+            end = start + strlen(start);
+        sprintf(message, "%.*s", (int)MIN(end - start, (long)sizeof(message) - 1), start);
+        length = strlen(message);
+        if (length >= 2 && strcmp(message + length - 2, "..") == 0)
+            message[length - 1] = '\0'; /*printError ends with a period of its own, after messages that already have one*/
+        /*"ERROR - line #N: message." or "WARNING - line #N: message."*/
+        text = strstr(message, ": ");
+        report(index, strncmp(message, "WARNING", 7) != 0, text != NULL ? text + 2 : message, arg);
+    }
+}
+
+/* Reports the problems of a document.*/
+void reportProblems(source_document *document, problem_function report, void *arg) {
+    const symbol_entry *entry, *definition;
+    const line_symbol *symbol;
+    int i, j, line;
+
+    for (i = 0; i < document->lineCount; i++) {
+        if (document->lines[i].messages != NULL)
+            reportLineMessages(&document->lines[i], i, report, arg);
+    }
+
+    /*what the second pass finds - the labels of the whole document, in the words of createLabel and resolveSymbols*/
+    indexSymbols(document);
+    for (i = 0; i < document->symbolCount; i++) {
+        entry = &document->symbols[i];
+        definition = findSymbol(document, entry->name, SYMBOL_CODE, SYMBOL_DATA);
+        if ((entry->kind == SYMBOL_CODE || entry->kind == SYMBOL_DATA) && definition != entry)
+            report(entry->line, TRUE, "Label is already defined.", arg);
+        else if (entry->kind != SYMBOL_EXTERN && findSymbol(document, entry->name, SYMBOL_EXTERN, SYMBOL_EXTERN) != NULL)
+            report(entry->line, TRUE, "Label is declared as external and cannot be defined in this file.", arg);
+        else if (entry->kind == SYMBOL_ENTRY && definition == NULL)
+            report(entry->line, TRUE, "Entry label is never defined.", arg);
+    }
+    for (i = 0; i < document->lineCount; i++) {
+        for (j = 0; j < document->lines[i].symbolCount; j++) {
+            symbol = &document->lines[i].symbols[j];
+            if (symbol->kind == SYMBOL_REFERENCE && findSymbol(document, symbol->name, SYMBOL_CODE, SYMBOL_EXTERN) == NULL)
+                report(i, TRUE, "Label is used but never defined.", arg);
+        }
+    }
+    line = lineExceeding(document, DEFAULT_MEMORY_SPACE);
+    if (line != -1)
+        report(line, TRUE, "Maximum number of machine words reached.", arg);
+}
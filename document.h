@@ -0,0 +1,176 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+#include "utils.h"
+#include "preprocessor.h"
+
+/*Most code words and most data words of a line kept for hovers - the others are only counted*/
+#define LINE_HOVER_WORDS 8
+/*Fewest buckets of the symbol index of a document - it keeps at least two buckets per declaration*/
+#define MIN_SYMBOL_BUCKETS 64
+
+/*What a line of a document is to the preprocessor*/
+typedef enum {
+    LINE_EMPTY, /*blank, or only a comment*/
+    LINE_STATEMENT, /*an instruction or a directive*/
+    LINE_MACRO_START,
+    LINE_MACRO_BODY,
+    LINE_MACRO_END,
+    LINE_MACRO_CALL /*replaced by the body of a macro, which is parsed in its place*/
+} line_kind;
+
+/*The ways a line names a label*/
+typedef enum {
+    SYMBOL_CODE, /*declares a label of the code image*/
+    SYMBOL_DATA, /*declares a label of the data image*/
+    SYMBOL_EXTERN,
+    SYMBOL_ENTRY,
+    SYMBOL_REFERENCE /*a word of the line holds the address of the label*/
+} symbol_kind;
+
+/*A label named by a line*/
+typedef struct line_symbol {
+    char name[MAX_LABEL_LENGTH+1]; /*adding one extra space for NULL ending*/
+    symbol_kind kind;
+    int offset; /*declarations: the address, from the first word of the line; references: the index of the word in the line*/
+} line_symbol;
+
+/*A line of a document and what parseLine made of it, as if the line were the first of a file*/
+typedef struct source_line {
+    char *text; /*without the new line*/
+    line_kind kind;
+    int codeWords;
+    int dataWords;
+    word_t *words; /*up to LINE_HOVER_WORDS code words and then up to LINE_HOVER_WORDS data words - NULL if none*/
+    line_symbol *symbols;
+    int symbolCount;
+    char *messages; /*the errors and warnings of the line, as the assembler prints them - NULL if none*/
+} source_line;
+
+/*A declaration of a label, in the symbol index of a document*/
+typedef struct symbol_entry {
+    const char *name;
+    int line;
+    symbol_kind kind;
+    int offset;
+    int next; /*next entry in the same bucket, -1 if none*/
+} symbol_entry;
+
+/*Reports a problem of a document - line is 0 based*/
+typedef void (*problem_function)(int line, boolean isError, const char *message, void *arg);
+
+/*
+ * A source open in an editor. Every line is parsed on its own, so an edit parses only the lines it changed, and the
+ * address of every line comes from Fenwick trees over the words of the lines - an edit that changes the size of a line
+ * updates them in O(log n), without parsing the lines after it again. The labels are resolved lazily, through an index
+ * of the declarations that is rebuilt only when the declarations may have moved.
+ * Edits that touch the definition of a macro parse the whole document again, as they may change any line after them.
+ */
+typedef struct source_document {
+    source_line *lines;
+    int lineCount;
+    int lineCapacity;
+    int *codeTree; /*Fenwick tree of the code words of the lines, 1 based*/
+    int *dataTree; /*Fenwick tree of the data words of the lines, 1 based*/
+    MacroTable macros;
+    int *macroStarts; /*the line of the 'mcro' of each macro of the table*/
+    int *macroEnds; /*the line of the 'endmcro' of each macro - a call must come after it*/
+    int macroCapacity;
+    symbol_entry *symbols;
+    int symbolCount;
+    int symbolCapacity;
+    int *symbolBuckets; /*first entry of each bucket, -1 if none*/
+    int bucketCount; /*a power of 2*/
+    boolean symbolsStale;
+    machine_image *scratch; /*where the lines are parsed*/
+} source_document;
+
+/**
+ * Opens a document and parses all its lines.
+ * @param document The document.
+ * @param text The text of the document.
+ * @param length The length of the text.
+ * @return TRUE on success, FALSE if memory ran out.
+ */
+boolean openDocument(source_document *document, const char *text, size_t length);
+
+/**
+ * Replaces a range of a document with new text, and parses the lines it changed.
+ * The positions are 0 based; columns beyond the end of their line stand for its end.
+ * @param document The document.
+ * @param startLine The line of the start of the range.
+ * @param startColumn The column of the start of the range.
+ * @param endLine The line of the end of the range.
+ * @param endColumn The column of the end of the range.
+ * @param text The new text.
+ * @param length The length of the new text.
+ * @return TRUE on success, FALSE if the range is not in the document or memory ran out.
+ */
+boolean editDocument(source_document *document, int startLine, int startColumn, int endLine, int endColumn, const char *text, size_t length);
+
+/**
+ * Frees a document.
+ * @param document The document.
+ */
+void closeDocument(source_document *document);
+
+/**
+ * Finds the address of the first code word of a line.
+ * @param document The document.
+ * @param line The line.
+ * @return The address.
+ */
+int lineCodeAddress(const source_document *document, int line);
+
+/**
+ * Finds the address of the first data word of a line - the data image follows the code image.
+ * @param document The document.
+ * @param line The line.
+ * @return The address.
+ */
+int lineDataAddress(const source_document *document, int line);
+
+/**
+ * Looks up the declaration of a label: its definition, or else its '.extern'.
+ * @param document The document.
+ * @param name The name of the label.
+ * @return The declaration, or NULL if there is none - valid until the next edit.
+ */
+const symbol_entry *findDeclaration(source_document *document, const char *name);
+
+/**
+ * Finds the address of a label.
+ * @param document The document.
+ * @param declaration The declaration of the label.
+ * @return The address, or -1 for an external label.
+ */
+int declarationAddress(const source_document *document, const symbol_entry *declaration);
+
+/**
+ * Finds a code word of a line, with the address of the label it refers to filled in.
+ * @param document The document.
+ * @param line The line.
+ * @param index The index of the word in the line - less than LINE_HOVER_WORDS.
+ * @param resolved Output - FALSE if the word refers to a label that is never declared.
+ * @return The word.
+ */
+word_t resolvedCodeWord(source_document *document, int line, int index, boolean *resolved);
+
+/**
+ * Finds the definition of a macro.
+ * @param document The document.
+ * @param name The name of the macro.
+ * @return The line of its 'mcro', or -1 if there is no such macro.
+ */
+int findMacroDefinition(const source_document *document, const char *name);
+
+/**
+ * Reports the problems of a document - the errors and warnings of every line, and those of the document as a
+ * whole: labels that are defined twice or never, and a program that does not fit in the memory.
+ * @param document The document.
+ * @param report Called for every problem.
+ * @param arg Passed to every call of report.
+ */
+void reportProblems(source_document *document, problem_function report, void *arg);
+
+#endif /*DOCUMENT_H*/
@@ -0,0 +1,255 @@
+#define _DEFAULT_SOURCE /*pread, pwrite and syscall*/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && !defined(NO_IO_URING)
+#define HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+#include "fileIO.h"
+#include "utils.h"
+
+/*Longest transfer of a single ring request - the rest is completed with pread or pwrite*/
+#define MAX_RING_TRANSFER (1UL << 30)
+
+/* Transfers what is left of a request with pread or pwrite.*/
+static void finishRequest(io_request *request, size_t done) {
+    ssize_t result;
+    while (done < request->length) {
+        if (request->write)
+            result = pwrite(request->fd, request->buffer + done, request->length - done, (off_t)done);
+        else
+            result = pread(request->fd, request->buffer + done, request->length - done, (off_t)done);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result < 0) {
+            request->result = -errno;
+            return;
+        }
+        if (result == 0)
+            break; /*the file is shorter than the buffer*/
+        done += (size_t)result;
+    }
+    request->result = (long)done;
+}
+
+#ifdef HAVE_IO_URING
+/* The io_uring system calls - C library wrappers are not available everywhere.*/
+static int setupRing(unsigned int entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int enterRing(int ringFd, unsigned int toSubmit, unsigned int minComplete) {
+    return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, IORING_ENTER_GETEVENTS, NULL, 0);
+}
+
+/* Maps the rings of a new io_uring. Returns FALSE, leaving the queue without a ring, if any mapping fails.*/
+static boolean mapRing(io_queue *queue, int ringFd, const struct io_uring_params *params) {
+    char *sq, *cq;
+
+    queue->sqRingSize = params->sq_off.array + params->sq_entries * sizeof(unsigned int);
+    queue->cqRingSize = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+    /*newer kernels map both rings at once*/
+    if (params->features & IORING_FEAT_SINGLE_MMAP)
+        queue->sqRingSize = queue->cqRingSize = MAX(queue->sqRingSize, queue->cqRingSize);
+    sq = mmap(NULL, queue->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED, ringFd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED)
+        return FALSE;
+    cq = sq;
+    if (!(params->features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(NULL, queue->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED, ringFd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            munmap(sq, queue->sqRingSize);
+            return FALSE;
+        }
+    }
+    queue->sqesSize = params->sq_entries * sizeof(struct io_uring_sqe);
+    queue->sqes = mmap(NULL, queue->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED, ringFd, IORING_OFF_SQES);
+    if (queue->sqes == MAP_FAILED) {
+        if (cq != sq)
+            munmap(cq, queue->cqRingSize);
+        munmap(sq, queue->sqRingSize);
+        return FALSE;
+    }
+    queue->sqRing = sq;
+    queue->cqRing = cq;
+    queue->sqTail = (unsigned int *)(sq + params->sq_off.tail);
+    queue->sqMask = (unsigned int *)(sq + params->sq_off.ring_mask);
+    queue->sqArray = (unsigned int *)(sq + params->sq_off.array);
+    queue->cqHead = (unsigned int *)(cq + params->cq_off.head);
+    queue->cqTail = (unsigned int *)(cq + params->cq_off.tail);
+    queue->cqMask = (unsigned int *)(cq + params->cq_off.ring_mask);
+    queue->cqes = cq + params->cq_off.cqes;
+    queue->entries = params->sq_entries;
+    return TRUE;
+}
+
+/* Submits some requests to the ring and waits for all of them. Returns how many were submitted - the rest were not run.*/
+static int runOnRing(io_queue *queue, io_request requests[], int count) {
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe *cqe;
+    unsigned int tail = *queue->sqTail, head;
+    int i, submitted, completed = 0, result;
+
+    for (i = 0; i < count; i++) {
+        sqe = (struct io_uring_sqe *)queue->sqes + (tail & *queue->sqMask);
+        memset(sqe, 0, sizeof(struct io_uring_sqe));
+        sqe->opcode = requests[i].write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = requests[i].fd;
+        sqe->off = 0;
+        sqe->addr = (unsigned long)requests[i].buffer;
+        sqe->len = (unsigned int)(requests[i].length > MAX_RING_TRANSFER ? MAX_RING_TRANSFER : requests[i].length);
+        sqe->user_data = (unsigned long)i;
+        queue->sqArray[tail & *queue->sqMask] = tail & *queue->sqMask;
+        tail++;
+    }
+    __sync_synchronize(); /*the entries are visible before the new tail*/
+    *queue->sqTail = tail;
+
+    do {
+        submitted = enterRing(queue->ringFd, (unsigned int)count, (unsigned int)count);
+    } while (submitted < 0 && errno == EINTR);
+    if (submitted <= 0)
+        return 0;
+
+    while (completed < submitted) {
+        head = *queue->cqHead;
+        __sync_synchronize(); /*the entries are read after the tail that covers them*/
+        while (head != *queue->cqTail && completed < submitted) {
+            cqe = (struct io_uring_cqe *)queue->cqes + (head & *queue->cqMask);
+            requests[cqe->user_data].result = cqe->res;
+            head++;
+            completed++;
+        }
+        __sync_synchronize();
+        *queue->cqHead = head;
+        if (completed < submitted) {
+            do {
+                result = enterRing(queue->ringFd, 0, (unsigned int)(submitted - completed));
+            } while (result < 0 && errno == EINTR);
+            if (result < 0)
+                break; /*the ring is broken - its requests are redone with pread and pwrite*/
+        }
+    }
+    return completed;
+}
+#endif
+
+/* Sets up a queue of file requests.*/
+void openIOQueue(io_queue *queue, unsigned int entries) {
+#ifdef HAVE_IO_URING
+    struct io_uring_params params;
+    int ringFd;
+#endif
+    memset(queue, 0, sizeof(io_queue));
+    queue->ringFd = -1;
+#ifdef HAVE_IO_URING
+    memset(&params, 0, sizeof(params));
+    ringFd = setupRing(entries, &params);
+    if (ringFd < 0)
+        return; /*an older kernel, or io_uring is not allowed here*/
+    if (!mapRing(queue, ringFd, &params)) {
+        close(ringFd);
+        return;
+    }
+    queue->ringFd = ringFd;
+#endif
+}
+
+/* Releases a queue.*/
+void closeIOQueue(io_queue *queue) {
+    if (queue->ringFd < 0)
+        return;
+    munmap(queue->sqes, queue->sqesSize);
+    if (queue->cqRing != queue->sqRing)
+        munmap(queue->cqRing, queue->cqRingSize);
+    munmap(queue->sqRing, queue->sqRingSize);
+    close(queue->ringFd);
+    queue->ringFd = -1;
+}
+
+/* Runs a batch of requests, all submitted at once.*/
+boolean runIORequests(io_queue *queue, io_request requests[], int count) {
+    int i;
+    boolean complete = TRUE;
+
+    /*-ECANCELED marks the requests the ring did not run*/
+    for (i = 0; i < count; i++)
+        requests[i].result = -ECANCELED;
+#ifdef HAVE_IO_URING
+    {
+        int start, chunk;
+        for (start = 0; queue->ringFd >= 0 && start < count; start += chunk) {
+            chunk = MIN(count - start, (int)queue->entries);
+            if (runOnRing(queue, requests + start, chunk) < chunk)
+                closeIOQueue(queue); /*from now on every request of this queue runs through pread and pwrite*/
+        }
+    }
+#else
+    (void)queue;
+#endif
+    for (i = 0; i < count; i++) {
+        /*kernels before 5.6 reject the read and write requests of the ring*/
+        if (requests[i].result == -ECANCELED || requests[i].result == -EINVAL || requests[i].result == -EOPNOTSUPP)
+            finishRequest(&requests[i], 0);
+        else if (requests[i].result >= 0 && (size_t)requests[i].result < requests[i].length)
+            finishRequest(&requests[i], (size_t)requests[i].result);
+        if (requests[i].result < 0 || (size_t)requests[i].result < requests[i].length)
+            complete = FALSE;
+    }
+    return complete;
+}
+
+/* Reads whole files, with all the reads submitted at once.*/
+boolean readFiles(io_queue *queue, char * const fileNames[], int count, file_contents contents[]) {
+    io_request *requests = malloc((count + 1) * sizeof(io_request));
+    struct stat info;
+    boolean read = TRUE;
+    int i;
+
+    if (requests == NULL) {
+        for (i = 0; i < count; i++)
+            contents[i].bytes = NULL;
+        return FALSE;
+    }
+    for (i = 0; i < count; i++) {
+        requests[i].fd = open(fileNames[i], O_RDONLY);
+        requests[i].buffer = NULL;
+        requests[i].length = 0;
+        requests[i].write = FALSE;
+        if (requests[i].fd >= 0 && fstat(requests[i].fd, &info) == 0) {
+            requests[i].length = (size_t)info.st_size;
+            requests[i].buffer = malloc(requests[i].length > 0 ? requests[i].length : 1);
+        }
+        if (requests[i].buffer == NULL) {
+            /*a file that cannot be read takes no part in the batch*/
+            if (requests[i].fd >= 0)
+                close(requests[i].fd);
+            requests[i].fd = -1;
+            requests[i].length = 0;
+        }
+    }
+    runIORequests(queue, requests, count);
+    for (i = 0; i < count; i++) {
+        if (requests[i].fd < 0 || requests[i].result < 0) {
+            free(requests[i].buffer);
+            contents[i].bytes = NULL;
+            contents[i].length = 0;
+            read = FALSE;
+        } else {
+            contents[i].bytes = requests[i].buffer;
+            contents[i].length = (size_t)requests[i].result; /*a file that shrank since fstat is read as it is now*/
+        }
+        if (requests[i].fd >= 0)
+            close(requests[i].fd);
+    }
+    free(requests);
+    return read;
+}
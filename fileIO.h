@@ -0,0 +1,70 @@
+#ifndef FILEIO_H
+#define FILEIO_H
+
+#include <stddef.h>
+#include "utils.h"
+
+/*A queue of file reads and writes - an io_uring where the kernel has one, plain pread and pwrite otherwise*/
+typedef struct io_queue {
+    int ringFd; /*-1 when the requests run one by one through pread and pwrite*/
+    unsigned int entries;
+    void *sqRing; /*the submission ring, shared with the kernel*/
+    size_t sqRingSize;
+    void *cqRing; /*the completion ring - the same mapping as the submission ring on newer kernels*/
+    size_t cqRingSize;
+    void *sqes; /*the submission entries*/
+    size_t sqesSize;
+    unsigned int *sqTail, *sqMask, *sqArray;
+    unsigned int *cqHead, *cqTail, *cqMask;
+    void *cqes; /*the completion entries*/
+} io_queue;
+
+/*One read or write of a whole buffer at the start of a file*/
+typedef struct io_request {
+    int fd;
+    char *buffer;
+    size_t length;
+    boolean write;
+    long result; /*bytes transferred, or -errno*/
+} io_request;
+
+/*The contents of a file, read in full*/
+typedef struct file_contents {
+    char *bytes; /*NULL if the file could not be read*/
+    size_t length;
+} file_contents;
+
+/**
+ * Sets up a queue of file requests. Falls back to pread and pwrite if the kernel has no io_uring, or it was built with -DNO_IO_URING.
+ * @param queue The queue.
+ * @param entries How many requests are submitted at once.
+ */
+void openIOQueue(io_queue *queue, unsigned int entries);
+
+/**
+ * Releases a queue.
+ * @param queue The queue.
+ */
+void closeIOQueue(io_queue *queue);
+
+/**
+ * Runs a batch of requests: all of them are submitted at once and the call returns when all are done.
+ * A request that transfers less than its whole buffer is completed with pread or pwrite.
+ * @param queue The queue.
+ * @param requests The requests - the result of each is filled in.
+ * @param count The number of requests.
+ * @return TRUE if every request transferred its whole buffer, FALSE otherwise.
+ */
+boolean runIORequests(io_queue *queue, io_request requests[], int count);
+
+/**
+ * Reads whole files, with all the reads submitted at once.
+ * @param queue The queue.
+ * @param fileNames The names of the files.
+ * @param count The number of files.
+ * @param contents Output for the contents of every file - free the bytes of each.
+ * @return TRUE if every file was read, FALSE otherwise.
+ */
+boolean readFiles(io_queue *queue, char * const fileNames[], int count, file_contents contents[]);
+
+#endif /*FILEIO_H*/
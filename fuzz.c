@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "assembler.h"
+#include "utils.h"
+
+/*
+ * Fuzzing entry point - runs the preprocessor, both passes and the encoding of the outputs on a source held in memory.
+ * Every input is assembled with the same context, which assembleBuffer empties again when it is done, so nothing is
+ * set up or torn down per input and no state is left over from the inputs before it.
+ *   make fuzz                      - builds the fuzzer with clang and libFuzzer
+ *   make fuzz FUZZ_CC=gcc FUZZ_FLAGS="-fsanitize=address -DFUZZ_DRIVER"
+ *                                  - builds a driver that runs the inputs given on its command line, to replay a crash
+ */
+
+static AssemblerContext fuzzContext;
+static assembler_options fuzzOptions;
+static boolean fuzzContextReady = FALSE;
+
+/* Assembles one input - called by libFuzzer for every input it generates.*/
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size) {
+    assembler_result result;
+
+    if (!fuzzContextReady) {
+        /*an input must not open files - .incbin of a FIFO would block, and any file could be read*/
+        fuzzOptions.memorySize = DEFAULT_MEMORY_SPACE;
+        fuzzOptions.baseAddress = DEFAULT_BASE_ADDRESS;
+        fuzzOptions.noFiles = TRUE;
+        initAssemblerContext(&fuzzContext, &fuzzOptions);
+        fuzzContextReady = TRUE;
+    }
+    assembleBuffer(&fuzzContext, (const char *)data, size, &result);
+    freeAssemblerResult(&result);
+    return 0;
+}
+
+#ifdef FUZZ_DRIVER
+/* Runs the files given on the command line as inputs, the way the fuzzer would.*/
+int main(int argc, char * argv[]) {
+    unsigned char *data;
+    long size;
+    int i;
+    FILE *file;
+
+    for (i = 1; i < argc; i++) {
+        file = fopen(argv[i], "rb");
+        if (file == NULL || fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) {
+            printf("Error: could not read '%s'.\n", argv[i]);
+            if (file != NULL)
+                fclose(file);
+            return 1;
+        }
+        data = malloc((size_t)size + 1);
+        if (data == NULL || fread(data, 1, (size_t)size, file) != (size_t)size) {
+            printf("Error: could not read '%s'.\n", argv[i]);
+            free(data);
+            fclose(file);
+            return 1;
+        }
+        fclose(file);
+        printf("Running: %s\n", argv[i]);
+        LLVMFuzzerTestOneInput(data, (size_t)size);
+        free(data);
+    }
+    return 0;
+}
+#endif
@@ -0,0 +1,442 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "labels.h"
+#include "image.h"
+#include "utils.h"
+
+/*Words an image starts with once anything is stored in it - it then doubles as it fills*/
+#define MIN_IMAGE_CAPACITY 64
+
+/* Prepares an empty code and data image.*/
+void initImage(machine_image *image) {
+    int i;
+    image->code = NULL;
+    image->data = NULL;
+    image->codeLines = NULL;
+    image->codeLineCount = 0;
+    image->codeLineCapacity = 0;
+    image->chainLinks = NULL;
+    image->codeCapacity = 0;
+    image->dataCapacity = 0;
+    image->pieces = 1;
+    image->memorySize = DEFAULT_MEMORY_SPACE;
+    image->baseAddress = DEFAULT_BASE_ADDRESS;
+    image->refs = NULL;
+    image->refCount = 0;
+    image->refCapacity = 0;
+    image->onePass = FALSE;
+    image->poolAll = FALSE;
+    image->noFiles = FALSE;
+    image->pool = NULL;
+    image->poolCount = 0;
+    image->poolCapacity = 0;
+    for (i = 0; i < POOL_BUCKETS; i++)
+        image->poolBuckets[i] = -1;
+    image->fills = NULL;
+    image->fillCount = 0;
+    image->fillWords = 0;
+    image->fillCapacity = 0;
+    image->includes = NULL;
+    image->includeCount = 0;
+    image->includeCapacity = 0;
+}
+
+/* Releases the words and tables of an image.*/
+void freeImage(machine_image *image) {
+    int i;
+    free(image->code);
+    free(image->data);
+    free(image->codeLines);
+    free(image->chainLinks);
+    image->code = NULL;
+    image->data = NULL;
+    image->codeLines = NULL;
+    image->codeLineCount = 0;
+    image->codeLineCapacity = 0;
+    image->chainLinks = NULL;
+    image->codeCapacity = 0;
+    image->dataCapacity = 0;
+    free(image->refs);
+    image->refs = NULL;
+    image->refCount = 0;
+    image->refCapacity = 0;
+    free(image->pool);
+    image->pool = NULL;
+    image->poolCount = 0;
+    image->poolCapacity = 0;
+    for (i = 0; i < POOL_BUCKETS; i++)
+        image->poolBuckets[i] = -1;
+    free(image->fills);
+    image->fills = NULL;
+    image->fillCount = 0;
+    image->fillWords = 0;
+    image->fillCapacity = 0;
+    for (i = 0; i < image->includeCount; i++)
+        free(image->includes[i]);
+    free(image->includes);
+    image->includes = NULL;
+    image->includeCount = 0;
+    image->includeCapacity = 0;
+}
+
+/* Empties an image for the next source - its buffers are kept, so a source of a similar size allocates nothing.*/
+void clearImage(machine_image *image) {
+    int i;
+    image->codeLineCount = 0;
+    image->pieces = 1;
+    image->refCount = 0;
+    image->poolCount = 0;
+    for (i = 0; i < POOL_BUCKETS; i++)
+        image->poolBuckets[i] = -1;
+    image->fillCount = 0;
+    image->fillWords = 0;
+    for (i = 0; i < image->includeCount; i++)
+        free(image->includes[i]);
+    image->includeCount = 0;
+}
+
+/* Returns the capacity to grow an image to for the given number of words, doubling the current one.*/
+static int growCapacity(int capacity, int needed) {
+    if (capacity == 0)
+        capacity = MIN_IMAGE_CAPACITY;
+    while (capacity < needed)
+        capacity *= 2;
+    return capacity;
+}
+
+/* Makes room at the end of the code image for the words of an instruction.*/
+boolean reserveCode(machine_image *image, int IC, int DC, int words, int lineNumber) {
+    word_t *newCode;
+    int *newLinks = NULL, newCapacity;
+    /*the links of the one-pass chains are ints - a word may be too narrow for the index of a word.
+    Once allocated they grow with the code, as a kept image may be used in one-pass mode again*/
+    boolean links = image->onePass || image->chainLinks != NULL;
+
+    if ((long)IC + DC + words > image->memorySize) {
+        printWarning("Maximum number of machine words reached.", lineNumber);
+        return FALSE;
+    }
+    if (IC + words <= image->codeCapacity && (!links || image->chainLinks != NULL))
+        return TRUE;
+    /* Double the capacity of the code image*/
+    newCapacity = growCapacity(image->codeCapacity, IC + words);
+    newCode = realloc(image->code, newCapacity * sizeof(word_t));
+    if (newCode != NULL)
+        image->code = newCode;
+    if (links) {
+        newLinks = realloc(image->chainLinks, newCapacity * sizeof(int));
+        if (newLinks != NULL)
+            image->chainLinks = newLinks;
+    }
+    if (newCode == NULL || (links && newLinks == NULL)) {
+        printError("Failed to allocate memory for the code image.", lineNumber);
+        return FALSE;
+    }
+    image->codeCapacity = newCapacity;
+    return TRUE;
+}
+
+/* Makes room at the end of the data image for the words of a directive.*/
+boolean reserveData(machine_image *image, int IC, int DC, int words, int lineNumber) {
+    word_t *newData;
+    int newCapacity;
+
+    if ((long)IC + DC + words > image->memorySize) {
+        printWarning("Maximum number of machine words reached.", lineNumber);
+        return FALSE;
+    }
+    /*the words of runs are not stored*/
+    if (DC - image->fillWords + words <= image->dataCapacity)
+        return TRUE;
+    /* Double the capacity of the data image*/
+    newCapacity = growCapacity(image->dataCapacity, DC - image->fillWords + words);
+    newData = realloc(image->data, newCapacity * sizeof(word_t));
+    if (newData == NULL) {
+        printError("Failed to allocate memory for the data image.", lineNumber);
+        return FALSE;
+    }
+    image->data = newData;
+    image->dataCapacity = newCapacity;
+    return TRUE;
+}
+
+/* Records that a word of the code image refers to a label.*/
+boolean addSymbolRef(machine_image *image, int index, const char *name, int lineNumber) {
+    symbol_ref *ref;
+
+    if (image->refCount == image->refCapacity) {
+        /* Double the capacity of the reference table*/
+        int newCapacity = image->refCapacity ? image->refCapacity * 2 : 16;
+        symbol_ref *newRefs = realloc(image->refs, newCapacity * sizeof(symbol_ref));
+        if (newRefs == NULL) {
+            printError("Failed to allocate memory for the symbol references.", lineNumber);
+            return FALSE;
+        }
+        image->refs = newRefs;
+        image->refCapacity = newCapacity;
+    }
+    ref = &image->refs[image->refCount++];
+    ref->index = index;
+    ref->lineNumber = lineNumber;
+    strcpy(ref->name, name);
+    return TRUE;
+}
+
+/* Records the source line of the instruction that starts at a word of the code image.*/
+boolean addCodeLine(machine_image *image, int index, int lineNumber) {
+    code_line *line;
+
+    if (image->codeLineCount == image->codeLineCapacity) {
+        /* Double the capacity of the line table*/
+        int newCapacity = image->codeLineCapacity ? image->codeLineCapacity * 2 : 16;
+        code_line *newLines = realloc(image->codeLines, newCapacity * sizeof(code_line));
+        if (newLines == NULL) {
+            printError("Failed to allocate memory for the line table.", lineNumber);
+            return FALSE;
+        }
+        image->codeLines = newLines;
+        image->codeLineCapacity = newCapacity;
+    }
+    line = &image->codeLines[image->codeLineCount++];
+    line->index = index;
+    line->lineNumber = lineNumber;
+    return TRUE;
+}
+
+/* FNV-1a hash of a block of words.*/
+static unsigned long hashWords(const word_t *words, int length) {
+    unsigned long hash = 2166136261UL;
+    int i;
+    for (i = 0; i < length; i++) {
+        hash ^= words[i] & 0xFF;
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+        hash ^= (words[i] >> 8) & 0xFF;
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return hash;
+}
+
+/* Adds the last block of the data image to the constant pool, or drops it if the pool already holds the same words.*/
+int poolData(machine_image *image, int start, int *DC, int lineNumber) {
+    int length = *DC - start, i;
+    unsigned long hash;
+    pool_entry *entry;
+
+    /*runs of .fill and .space are not stored word by word, so they are not pooled*/
+    if (image->fillCount > 0 && image->fills[image->fillCount - 1].start + image->fills[image->fillCount - 1].length > start)
+        return start;
+    hash = hashWords(storedData(image, start), length);
+
+    for (i = image->poolBuckets[hash % POOL_BUCKETS]; i != -1; i = image->pool[i].next) {
+        entry = &image->pool[i];
+        if (entry->hash == hash && entry->length == length
+            && memcmp(storedData(image, entry->start), storedData(image, start), length * sizeof(word_t)) == 0) {
+            *DC = start; /*the words are already in the data image*/
+            return entry->start;
+        }
+    }
+
+    if (image->poolCount == image->poolCapacity) {
+        /* Double the capacity of the pool*/
+        int newCapacity = image->poolCapacity ? image->poolCapacity * 2 : 16;
+        pool_entry *newPool = realloc(image->pool, newCapacity * sizeof(pool_entry));
+        if (newPool == NULL) {
+            printWarning("Failed to allocate memory for the constant pool - the constant is not pooled.", lineNumber);
+            return start;
+        }
+        image->pool = newPool;
+        image->poolCapacity = newCapacity;
+    }
+    entry = &image->pool[image->poolCount];
+    entry->hash = hash;
+    entry->start = start;
+    entry->length = length;
+    entry->next = image->poolBuckets[hash % POOL_BUCKETS];
+    image->poolBuckets[hash % POOL_BUCKETS] = image->poolCount++;
+    return start;
+}
+
+/* Reserves a run of identical words at the end of the data image.*/
+boolean addFill(machine_image *image, int start, int length, word_t value, int lineNumber) {
+    fill_run *run = image->fillCount > 0 ? &image->fills[image->fillCount - 1] : NULL;
+
+    /*a run that continues the previous one with the same value only makes it longer*/
+    if (run != NULL && run->start + run->length == start && run->value == value) {
+        run->length += length;
+        image->fillWords += length;
+        return TRUE;
+    }
+    if (image->fillCount == image->fillCapacity) {
+        /* Double the capacity of the run table*/
+        int newCapacity = image->fillCapacity ? image->fillCapacity * 2 : 16;
+        fill_run *newFills = realloc(image->fills, newCapacity * sizeof(fill_run));
+        if (newFills == NULL) {
+            printError("Failed to allocate memory for the data image.", lineNumber);
+            return FALSE;
+        }
+        image->fills = newFills;
+        image->fillCapacity = newCapacity;
+    }
+    run = &image->fills[image->fillCount++];
+    run->start = start;
+    run->length = length;
+    run->value = value;
+    run->skipped = image->fillWords;
+    image->fillWords += length;
+    return TRUE;
+}
+
+/* Records a file that the image embeds.*/
+boolean addInclude(machine_image *image, const char *fileName, int lineNumber) {
+    char *name;
+
+    if (image->includeCount == image->includeCapacity) {
+        /* Double the capacity of the include list*/
+        int newCapacity = image->includeCapacity ? image->includeCapacity * 2 : 4;
+        char **newIncludes = realloc(image->includes, newCapacity * sizeof(char *));
+        if (newIncludes == NULL) {
+            printError("Failed to allocate memory for the included files.", lineNumber);
+            return FALSE;
+        }
+        image->includes = newIncludes;
+        image->includeCapacity = newCapacity;
+    }
+    name = malloc(strlen(fileName) + 1);
+    if (name == NULL) {
+        printError("Failed to allocate memory for the included files.", lineNumber);
+        return FALSE;
+    }
+    strcpy(name, fileName);
+    image->includes[image->includeCount++] = name;
+    return TRUE;
+}
+
+/* Finds the run that holds a word of the data image, or the last run before it. Returns -1 if no run starts at or before it.*/
+static int findRun(const machine_image *image, int index) {
+    int low = 0, high = image->fillCount - 1, middle;
+
+    /*binary search for the last run that starts at or before index*/
+    while (low <= high) {
+        middle = (low + high) / 2;
+        if (image->fills[middle].start > index)
+            high = middle - 1;
+        else if (index >= image->fills[middle].start + image->fills[middle].length)
+            low = middle + 1;
+        else
+            return middle;
+    }
+    return high;
+}
+
+/* Returns where a word of the data image that is not part of a run is stored in data.*/
+word_t *storedData(machine_image *image, int index) {
+    int run = findRun(image, index);
+    return image->data + index - (run >= 0 ? image->fills[run].skipped + image->fills[run].length : 0);
+}
+
+/* Returns a word of the data image, looking it up in the runs if it is not stored in data.*/
+word_t dataWord(const machine_image *image, int index) {
+    int run = findRun(image, index);
+
+    if (run >= 0 && index < image->fills[run].start + image->fills[run].length)
+        return image->fills[run].value;
+    return image->data[index - (run >= 0 ? image->fills[run].skipped + image->fills[run].length : 0)];
+}
+
+/* Walks the chain of words waiting for a label and writes the final word into each one.*/
+static void patchChain(machine_image *image, label *lbl, word_t word) {
+    int index = lbl->chain - 1;
+
+    /*each waiting word links to the previous waiting word until it is patched*/
+    while (index >= 0) {
+        int previous = image->chainLinks[index] - 1;
+        image->code[index] = word;
+        index = previous;
+    }
+    lbl->chain = 0;
+}
+
+/* Encodes the word that holds the address of a label, checking that the address fits in the operand field.*/
+boolean addressWord(const machine_image *image, const label *lbl, int IC, int lineNumber, word_t *word) {
+    int address = labelAddress(image, lbl, IC);
+
+    *word = RELOCATABLE_WORD(address);
+    if (address > (int)OPERAND_MASK) {
+        printError("Address does not fit in the operand field.", lineNumber);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* One-pass mode: encodes a code word that refers to a label, or chains it until the label is resolved.*/
+boolean referenceLabel(machine_image *image, label_table *labelTable, int index, const char *name, int lineNumber) {
+    label *lbl = lookupLabel(name, labelTable);
+
+    if (lbl == NULL) {
+        /*a forward reference - keep a placeholder in the table for the words waiting for this label*/
+        lbl = allocateLabel(labelTable);
+        if (lbl == NULL) {
+            printError("Failed to allocate memory for label.", lineNumber);
+            return FALSE;
+        }
+        strcpy(lbl->name, name);
+        insertLabel(lbl, labelTable, lineNumber);
+    }
+
+    /*the use is listed for the externals file and the relocation table, whatever the label turns out to be*/
+    if (!addSymbolRef(image, index, name, lineNumber))
+        return FALSE;
+    if (lbl->isExternal) {
+        image->code[index] = EXTERNAL_WORD; /*the linker fills in the address*/
+        return TRUE;
+    }
+    if (lbl->isDefined && !lbl->isData)
+        return addressWord(image, lbl, 0, lineNumber, &image->code[index]);
+
+    /*link the word to the chain of words waiting for this label*/
+    if (lbl->chain == 0)
+        lbl->chainLine = lineNumber;
+    image->code[index] = 0;
+    image->chainLinks[index] = lbl->chain;
+    lbl->chain = index + 1;
+    return TRUE;
+}
+
+/* One-pass mode: fills in the words waiting for a code label that was just declared.*/
+boolean backpatchLabel(machine_image *image, label *lbl) {
+    word_t word;
+    boolean fits;
+
+    if (lbl == NULL || lbl->chain == 0 || !lbl->isDefined || lbl->isData)
+        return TRUE;
+    fits = addressWord(image, lbl, 0, lbl->chainLine, &word);
+    patchChain(image, lbl, word);
+    return fits;
+}
+
+/* One-pass mode: resolves the words still waiting once the whole file was read.*/
+boolean finishOnePass(machine_image *image, label_table *labelTable, int IC) {
+    boolean NO_ERROR_FLAG = TRUE;
+    label *lbl;
+    word_t word;
+
+    for (lbl = labelTable->head; lbl != NULL; lbl = lbl->next) {
+        if (lbl->chain == 0)
+            continue;
+        if (lbl->isExternal) {
+            patchChain(image, lbl, EXTERNAL_WORD);
+        } else if (lbl->isDefined) {
+            /*data labels are placed after the code image, so their address is known only now*/
+            if (!addressWord(image, lbl, IC, lbl->chainLine, &word))
+                NO_ERROR_FLAG = FALSE;
+            patchChain(image, lbl, word);
+        } else {
+            printError("Label is used but never defined.", lbl->chainLine);
+            NO_ERROR_FLAG = FALSE;
+        }
+    }
+    return NO_ERROR_FLAG;
+}
@@ -0,0 +1,158 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "utils.h"
+
+/**
+ * Prepares an empty code and data image, for a memory of the size and base address the ISA describes.
+ * @param image The image to initialize.
+ */
+void initImage(machine_image *image);
+
+/**
+ * Releases the words and tables of an image.
+ * @param image The image to free.
+ */
+void freeImage(machine_image *image);
+
+/**
+ * Empties an image for the next source, keeping its buffers and its memory model and flags.
+ * @param image The image to empty.
+ */
+void clearImage(machine_image *image);
+
+/**
+ * Makes room at the end of the code image for the words of an instruction, growing it if needed.
+ * @param image The image to store the words in.
+ * @param IC The instruction counter.
+ * @param DC The data counter.
+ * @param words The number of words to store.
+ * @param lineNumber The source line of the instruction.
+ * @return TRUE if the words fit in memory and there is room for them, FALSE otherwise.
+ */
+boolean reserveCode(machine_image *image, int IC, int DC, int words, int lineNumber);
+
+/**
+ * Makes room at the end of the data image for the words of a directive, growing it if needed. The words of runs
+ * take no room, so only the words stored in data count.
+ * @param image The image to store the words in.
+ * @param IC The instruction counter.
+ * @param DC The data counter.
+ * @param words The number of words to store.
+ * @param lineNumber The source line of the directive.
+ * @return TRUE if the words fit in memory and there is room for them, FALSE otherwise.
+ */
+boolean reserveData(machine_image *image, int IC, int DC, int words, int lineNumber);
+
+/**
+ * Records that a word of the code image refers to a label.
+ * @param image The image holding the word.
+ * @param index The position of the word in the code image.
+ * @param name The name of the label.
+ * @param lineNumber The source line of the reference.
+ * @return TRUE if the reference was recorded, FALSE if memory ran out.
+ */
+boolean addSymbolRef(machine_image *image, int index, const char *name, int lineNumber);
+
+/**
+ * Records the source line of an instruction, by the position of its first word. Instructions are recorded in order.
+ * @param image The image holding the instruction.
+ * @param index The position of the first word of the instruction in the code image.
+ * @param lineNumber The source line of the instruction.
+ * @return TRUE if the line was recorded, FALSE if memory ran out.
+ */
+boolean addCodeLine(machine_image *image, int index, int lineNumber);
+
+/**
+ * Adds the words a data directive just stored to the constant pool. If the pool already holds the
+ * same words they are dropped from the data image again, and the address of the pooled copy is returned.
+ * @param image The image holding the words.
+ * @param start The position of the first word of the directive in the data image.
+ * @param DC The data counter, moved back to start if the words were dropped.
+ * @param lineNumber The source line of the directive.
+ * @return The position in the data image where the words are stored.
+ */
+int poolData(machine_image *image, int start, int *DC, int lineNumber);
+
+/**
+ * Reserves a run of identical words at the end of the data image. The words are kept as a single
+ * run instead of being stored one by one - read them back with dataWord.
+ * @param image The image to add the run to.
+ * @param start The position of the first word of the run in the data image.
+ * @param length The number of words in the run.
+ * @param value The value of every word in the run.
+ * @param lineNumber The source line of the directive.
+ * @return TRUE if the run was recorded, FALSE if memory ran out.
+ */
+boolean addFill(machine_image *image, int start, int length, word_t value, int lineNumber);
+
+/**
+ * Records a file that the image embeds, so the build cache and --watch can tell when the module must be assembled again.
+ * @param image The image.
+ * @param fileName The name of the file.
+ * @param lineNumber The source line of the directive.
+ * @return TRUE if the file was recorded, FALSE if memory ran out.
+ */
+boolean addInclude(machine_image *image, const char *fileName, int lineNumber);
+
+/**
+ * Returns where a word of the data image is stored in data - the words of runs are not stored, so the words after
+ * a run are stored earlier than their position. Words stored at the end of the data image go to storedData(image, DC).
+ * @param image The image holding the word.
+ * @param index The position of the word in the data image, which is not part of a run.
+ * @return The place of the word in data.
+ */
+word_t *storedData(machine_image *image, int index);
+
+/**
+ * Returns a word of the data image, whether it is stored in data or is part of a run.
+ * @param image The image holding the word.
+ * @param index The position of the word in the data image.
+ * @return The word.
+ */
+word_t dataWord(const machine_image *image, int index);
+
+/**
+ * Encodes the word that holds the address of a label. Labels past the largest address the operand field holds
+ * are reported - the word would hold a truncated address.
+ * @param image The image, which holds the base address of the module.
+ * @param lbl The label, declared in this file.
+ * @param IC The final instruction counter, or 0 for a code label in one-pass mode.
+ * @param lineNumber The source line of the use of the label.
+ * @param word Output for the word.
+ * @return TRUE if the address fits in the operand field, FALSE otherwise.
+ */
+boolean addressWord(const machine_image *image, const label *lbl, int IC, int lineNumber, word_t *word);
+
+/**
+ * One-pass mode: encodes a code word that refers to a label. Words that refer to labels which are not
+ * declared yet, or whose address depends on the final size of the code image, are chained through
+ * the chainLinks table of the image until the label can be resolved.
+ * @param image The image holding the word.
+ * @param labelTable The table of labels.
+ * @param index The position of the word in the code image.
+ * @param name The name of the label.
+ * @param lineNumber The source line of the reference.
+ * @return TRUE if the reference was encoded or chained, FALSE otherwise.
+ */
+boolean referenceLabel(machine_image *image, label_table *labelTable, int index, const char *name, int lineNumber);
+
+/**
+ * One-pass mode: fills in the words waiting for a code label that was just declared.
+ * @param image The image holding the words.
+ * @param lbl The declared label.
+ * @return TRUE if the words were filled in, FALSE if the address of the label does not fit in them.
+ */
+boolean backpatchLabel(machine_image *image, label *lbl);
+
+/**
+ * One-pass mode: resolves the words still waiting once the whole file was read - uses of data labels,
+ * of external labels and of labels that were never declared.
+ * @param image The image holding the words.
+ * @param labelTable The table of labels.
+ * @param IC The final instruction counter.
+ * @return TRUE if every label was resolved, FALSE otherwise.
+ */
+boolean finishOnePass(machine_image *image, label_table *labelTable, int IC);
+
+#endif /* IMAGE_H */
@@ -6,40 +6,50 @@
 #include "labels.h"
 #include "utils.h"
 
-/*Instructions*/
-extern char *instructions[16];
+/*Opcode descriptor table, indexed by opcode - generated from the ISA description file*/
+extern const opcode_descriptor opcodeTable[NUM_OF_INSTRUCTIONS];
+
+/**
+ * Looks up an instruction name in the opcode descriptor table.
+ * @param name The instruction name.
+ * @return The descriptor of the instruction, or NULL if the name is not an instruction.
+ */
+const opcode_descriptor *findOpcode(const char *name);
 
 /**
  * Processes an instruction with two operands and generates machine words accordingly.
  * @param line The current line of assembly code.
- * @param codeImage Array to store the machine words for instructions.
+ * @param image The code and data images.
+ * @param labelTable The table of labels.
  * @param IC The instruction counter.
  * @param DC The data counter.
  * @param lineNumber The current line number being processed.
  * @return TRUE if processing was successful, FALSE otherwise.
  */
-boolean parseTwoOperands(char **line, Token token, machine_word codeImage[], int *IC, int *DC, int lineNumber);
+boolean parseTwoOperands(char **line, Token token, machine_image *image, label_table *labelTable, int *IC, int *DC, int lineNumber);
 
 /**
  * Processes an instruction with one operand and generates machine words accordingly.
  * @param line The current line of assembly code.
- * @param codeImage Array to store the machine words for instructions.
+ * @param image The code and data images.
+ * @param labelTable The table of labels.
  * @param IC The instruction counter.
  * @param DC The data counter.
  * @param lineNumber The current line number being processed.
  * @return TRUE if processing was successful, FALSE otherwise.
  */
-boolean parseOneOperand(char **line, Token token, machine_word codeImage[], int *IC, int *DC, int lineNumber);
+boolean parseOneOperand(char **line, Token token, machine_image *image, label_table *labelTable, int *IC, int *DC, int lineNumber);
 
 /**
  * Processes an instruction with no operands and generates a machine word accordingly.
  * @param line The current line of assembly code.
- * @param codeImage Array to store the machine words for instructions.
+ * @param image The code and data images.
+ * @param labelTable The table of labels.
  * @param IC The instruction counter.
  * @param DC The data counter.
  * @param lineNumber The current line number being processed.
  * @return TRUE if processing was successful, FALSE otherwise.
  */
-boolean parseNoOperands(char ** line, Token token, machine_word codeImage[], int *IC, int *DC, int lineNumber);
+boolean parseNoOperands(char ** line, Token token, machine_image *image, label_table *labelTable, int *IC, int *DC, int lineNumber);
 
 #endif /* INSTRUCTIONS_H */
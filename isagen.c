@@ -0,0 +1,398 @@
+/*
+ * isagen - generates the machine specific parts of the assembler from an ISA description file.
+ *
+ * Usage:  isagen <description file> <header file> <source file>
+ *
+ * The header gets the machine parameters, the field shifts and masks and the word encoders, all as
+ * compile-time constants. The source file gets the opcode descriptor table, the directive names and
+ * a hash table of the reserved words.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAX_ISA_LINE 256
+#define MAX_ISA_NAME 32
+#define MAX_ISA_ITEMS 64
+
+/*A field of a word - its shift and width in bits*/
+typedef struct isa_field {
+    char name[MAX_ISA_NAME];
+    int shift;
+    int width;
+} isa_field;
+
+/*An addressing mode and its code*/
+typedef struct isa_mode {
+    char name[MAX_ISA_NAME];
+    int code;
+} isa_mode;
+
+/*An instruction: its opcode, operand count and legal addressing modes (as bitmasks of mode codes)*/
+typedef struct isa_opcode {
+    char name[MAX_ISA_NAME];
+    int code;
+    int operandCount;
+    unsigned int srcModes;
+    unsigned int dstModes;
+} isa_opcode;
+
+/*The whole machine description*/
+typedef struct isa_description {
+    int memory, base, wordBits, registers;
+    isa_field fields[MAX_ISA_ITEMS];
+    int fieldCount;
+    isa_mode modes[MAX_ISA_ITEMS];
+    int modeCount;
+    isa_opcode opcodes[MAX_ISA_ITEMS];
+    int opcodeCount;
+    char directives[MAX_ISA_ITEMS][MAX_ISA_NAME];
+    int directiveCount;
+} isa_description;
+
+/*Fields the assembler needs - every description must define them*/
+static const char *requiredFields[] = {"are", "dst_mode", "opcode", "src_mode", "operand", "dst_reg", "src_reg"};
+
+/*Prints an error about the description file and exits.*/
+static void fail(const char *fileName, int lineNumber, const char *error) {
+    fprintf(stderr, "%s:%d: %s\n", fileName, lineNumber, error);
+    exit(1);
+}
+
+/*Copies a name, converting it to upper case, for use in a macro name.*/
+static void upperName(char *dst, const char *src) {
+    while (*src) {
+        *dst++ = (*src == '.') ? '_' : toupper((unsigned char)*src);
+        src++;
+    }
+    *dst = '\0';
+}
+
+/*Reads a number, failing if the word is not one.*/
+static int readNumber(const char *word, const char *fileName, int lineNumber) {
+    char *end;
+    long value;
+    if (word == NULL)
+        fail(fileName, lineNumber, "missing number");
+    value = strtol(word, &end, 10);
+    if (*end != '\0' || value < 0)
+        fail(fileName, lineNumber, "invalid number");
+    return (int)value;
+}
+
+/*Converts a comma separated list of mode names ("-" for none) to a bitmask of mode codes.*/
+static unsigned int readModes(isa_description *isa, char *list, const char *fileName, int lineNumber) {
+    unsigned int modes = 0;
+    char *name;
+    int i;
+    if (list == NULL)
+        fail(fileName, lineNumber, "missing addressing modes");
+    if (strcmp(list, "-") == 0)
+        return 0;
+    for (name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+        for (i = 0; i < isa->modeCount && strcmp(isa->modes[i].name, name) != 0; i++)
+            ;
+        if (i == isa->modeCount)
+            fail(fileName, lineNumber, "unknown addressing mode");
+        modes |= 1u << isa->modes[i].code;
+    }
+    return modes;
+}
+
+/*Finds a field by name.*/
+static const isa_field *findField(const isa_description *isa, const char *name) {
+    int i;
+    for (i = 0; i < isa->fieldCount; i++) {
+        if (strcmp(isa->fields[i].name, name) == 0)
+            return &isa->fields[i];
+    }
+    return NULL;
+}
+
+/*Reads the description file.*/
+static void readDescription(const char *fileName, isa_description *isa) {
+    char line[MAX_ISA_LINE];
+    char *keyword, *comment, *words[6];
+    int lineNumber = 0, i;
+    FILE *file = fopen(fileName, "r");
+
+    if (file == NULL) {
+        perror(fileName);
+        exit(1);
+    }
+    memset(isa, 0, sizeof(isa_description));
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+        keyword = strtok(line, " \t\r\n");
+        if (keyword == NULL)
+            continue;
+        for (i = 0; i < 6; i++)
+            words[i] = strtok(NULL, " \t\r\n");
+        if (strlen(keyword) >= MAX_ISA_NAME || (words[0] && strlen(words[0]) >= MAX_ISA_NAME))
+            fail(fileName, lineNumber, "name too long");
+
+        if (strcmp(keyword, "memory") == 0) {
+            isa->memory = readNumber(words[0], fileName, lineNumber);
+        } else if (strcmp(keyword, "base") == 0) {
+            isa->base = readNumber(words[0], fileName, lineNumber);
+        } else if (strcmp(keyword, "word") == 0) {
+            isa->wordBits = readNumber(words[0], fileName, lineNumber);
+        } else if (strcmp(keyword, "registers") == 0) {
+            isa->registers = readNumber(words[0], fileName, lineNumber);
+        } else if (isa->fieldCount < MAX_ISA_ITEMS && strcmp(keyword, "field") == 0 && words[0]) {
+            isa_field *field = &isa->fields[isa->fieldCount++];
+            strcpy(field->name, words[0]);
+            field->shift = readNumber(words[1], fileName, lineNumber);
+            field->width = readNumber(words[2], fileName, lineNumber);
+        } else if (isa->modeCount < MAX_ISA_ITEMS && strcmp(keyword, "mode") == 0 && words[0]) {
+            isa_mode *mode = &isa->modes[isa->modeCount++];
+            strcpy(mode->name, words[0]);
+            mode->code = readNumber(words[1], fileName, lineNumber);
+        } else if (isa->opcodeCount < MAX_ISA_ITEMS && strcmp(keyword, "opcode") == 0 && words[0]) {
+            isa_opcode *opcode = &isa->opcodes[isa->opcodeCount++];
+            strcpy(opcode->name, words[0]);
+            opcode->code = readNumber(words[1], fileName, lineNumber);
+            opcode->operandCount = readNumber(words[2], fileName, lineNumber);
+            opcode->srcModes = readModes(isa, words[3], fileName, lineNumber);
+            opcode->dstModes = readModes(isa, words[4], fileName, lineNumber);
+        } else if (isa->directiveCount < MAX_ISA_ITEMS && strcmp(keyword, "directive") == 0 && words[0]) {
+            strcpy(isa->directives[isa->directiveCount++], words[0]);
+        } else {
+            fail(fileName, lineNumber, "unknown or malformed line");
+        }
+    }
+    fclose(file);
+}
+
+/*Checks that the description is complete and consistent.*/
+static void checkDescription(const char *fileName, isa_description *isa) {
+    int i, j;
+    const isa_field *field;
+    isa_opcode swap;
+
+    if (isa->memory <= 0 || isa->wordBits <= 0 || isa->wordBits > 32 || isa->registers <= 0)
+        fail(fileName, 0, "memory, word and registers must be given");
+    for (i = 0; i < (int)(sizeof(requiredFields) / sizeof(requiredFields[0])); i++) {
+        field = findField(isa, requiredFields[i]);
+        if (field == NULL)
+            fail(fileName, 0, "a required field is missing");
+        if (field->shift + field->width > isa->wordBits)
+            fail(fileName, 0, "a field does not fit in the word");
+    }
+    if ((1 << findField(isa, "opcode")->width) < isa->opcodeCount)
+        fail(fileName, 0, "the opcode field is too narrow for the number of opcodes");
+    if ((1 << findField(isa, "src_reg")->width) < isa->registers || (1 << findField(isa, "dst_reg")->width) < isa->registers)
+        fail(fileName, 0, "the register fields are too narrow for the number of registers");
+
+    /*the opcode table is indexed by opcode, so the opcodes must be 0 ... n-1*/
+    for (i = 0; i < isa->opcodeCount; i++) {
+        for (j = i + 1; j < isa->opcodeCount; j++) {
+            if (isa->opcodes[j].code < isa->opcodes[i].code) {
+                swap = isa->opcodes[i];
+                isa->opcodes[i] = isa->opcodes[j];
+                isa->opcodes[j] = swap;
+            }
+        }
+        if (isa->opcodes[i].code != i)
+            fail(fileName, 0, "opcodes must be numbered 0, 1, 2, ... without gaps");
+    }
+}
+
+/*Hash of a reserved word - must match isaHash in the generated source.*/
+static unsigned long hashName(const char *name) {
+    unsigned long hash = 2166136261UL;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return hash;
+}
+
+/*Writes the shift and mask of every field and the word encoders.*/
+static void writeHeader(FILE *out, const char *fileName, const isa_description *isa) {
+    char upper[MAX_ISA_NAME];
+    int i;
+
+    fprintf(out, "/* Generated by isagen from %s - do not edit. */\n", fileName);
+    fprintf(out, "#ifndef ISA_H\n#define ISA_H\n\n");
+    fprintf(out, "/*Machine parameters*/\n");
+    fprintf(out, "#define ISA_MEMORY_SPACE %d\n", isa->memory);
+    fprintf(out, "#define ISA_BASE_ADDRESS %d\n", isa->base);
+    fprintf(out, "#define ISA_WORD_BITS %d\n", isa->wordBits);
+    fprintf(out, "#define ISA_WORD_MASK 0x%lXUL\n", (isa->wordBits == 32) ? 0xFFFFFFFFUL : ((1UL << isa->wordBits) - 1));
+    fprintf(out, "#define ISA_WORD_MIN (-%ld)\n", 1L << (isa->wordBits - 1));
+    fprintf(out, "#define ISA_WORD_MAX %ld\n", (1L << (isa->wordBits - 1)) - 1);
+    fprintf(out, "#define ISA_WORD_TYPE %s\n", isa->wordBits <= 16 ? "unsigned short" : "unsigned long");
+    fprintf(out, "#define ISA_BASE64_DIGITS %d\n", (isa->wordBits + 5) / 6);
+    fprintf(out, "#define ISA_NUM_REGISTERS %d\n", isa->registers);
+    fprintf(out, "#define ISA_NUM_OPCODES %d\n", isa->opcodeCount);
+    fprintf(out, "#define ISA_NUM_DIRECTIVES %d\n\n", isa->directiveCount);
+
+    fprintf(out, "/*Fields - shift and (unshifted) mask*/\n");
+    for (i = 0; i < isa->fieldCount; i++) {
+        upperName(upper, isa->fields[i].name);
+        fprintf(out, "#define ISA_%s_SHIFT %d\n", upper, isa->fields[i].shift);
+        fprintf(out, "#define ISA_%s_MASK 0x%lXU\n", upper, (1UL << isa->fields[i].width) - 1);
+    }
+    i = findField(isa, "operand")->width;
+    fprintf(out, "#define ISA_OPERAND_MIN (-%ld)\n", 1L << (i - 1));
+    fprintf(out, "#define ISA_OPERAND_MAX %ld\n\n", (1L << (i - 1)) - 1);
+
+    fprintf(out, "/*Addressing modes*/\n");
+    for (i = 0; i < isa->modeCount; i++) {
+        upperName(upper, isa->modes[i].name);
+        fprintf(out, "#define ISA_MODE_%s %d\n", upper, isa->modes[i].code);
+    }
+    fprintf(out, "\n/*Opcodes*/\n");
+    for (i = 0; i < isa->opcodeCount; i++) {
+        upperName(upper, isa->opcodes[i].name);
+        fprintf(out, "#define ISA_OP_%s %d\n", upper, isa->opcodes[i].code);
+    }
+
+    fprintf(out, "\n/*Word encoders*/\n");
+    fprintf(out, "#define ISA_FIELD(field, value) (((unsigned long)(value) & ISA_##field##_MASK) << ISA_##field##_SHIFT)\n");
+    fprintf(out, "#define ISA_FIELD_OF(field, word) (((unsigned long)(word) >> ISA_##field##_SHIFT) & ISA_##field##_MASK)\n");
+    fprintf(out, "#define ISA_ENCODE_FIRST_WORD(opcode, srcMode, dstMode, are) \\\n"
+                 "    ((ISA_WORD_TYPE)(ISA_FIELD(OPCODE, opcode) | ISA_FIELD(SRC_MODE, srcMode) | ISA_FIELD(DST_MODE, dstMode) | ISA_FIELD(ARE, are)))\n");
+    fprintf(out, "#define ISA_ENCODE_OPERAND_WORD(value, are) \\\n"
+                 "    ((ISA_WORD_TYPE)(ISA_FIELD(OPERAND, value) | ISA_FIELD(ARE, are)))\n");
+    fprintf(out, "#define ISA_ENCODE_REGISTER_WORD(srcReg, dstReg, are) \\\n"
+                 "    ((ISA_WORD_TYPE)(ISA_FIELD(SRC_REG, srcReg) | ISA_FIELD(DST_REG, dstReg) | ISA_FIELD(ARE, are)))\n\n");
+
+    fprintf(out, "/*Kinds of reserved words*/\n");
+    fprintf(out, "#define ISA_NOT_RESERVED 0\n#define ISA_RESERVED_OPCODE 1\n#define ISA_RESERVED_DIRECTIVE 2\n\n");
+    fprintf(out, "/**\n * Looks up a word in the hash table of reserved words.\n"
+                 " * @param name The word.\n"
+                 " * @param code If not NULL, receives the opcode or directive index of the word.\n"
+                 " * @return The kind of reserved word, or ISA_NOT_RESERVED.\n */\n");
+    fprintf(out, "int isaLookup(const char *name, int *code);\n\n");
+    fprintf(out, "#endif /* ISA_H */\n");
+}
+
+/*Writes a mode bitmask as an expression of MODE_BIT terms.*/
+static void writeModes(FILE *out, const isa_description *isa, unsigned int modes) {
+    char upper[MAX_ISA_NAME];
+    int i, first = 1;
+    for (i = 0; i < isa->modeCount; i++) {
+        if (modes & (1u << isa->modes[i].code)) {
+            upperName(upper, isa->modes[i].name);
+            fprintf(out, "%sMODE_BIT(ISA_MODE_%s)", first ? "" : " | ", upper);
+            first = 0;
+        }
+    }
+    if (first)
+        fprintf(out, "NO_MODES");
+}
+
+/*Writes the opcode table, the directive names and the reserved word hash table.*/
+static void writeSource(FILE *out, const char *fileName, const isa_description *isa) {
+    const char *names[2 * MAX_ISA_ITEMS];
+    int kinds[2 * MAX_ISA_ITEMS], codes[2 * MAX_ISA_ITEMS], slots[4 * MAX_ISA_ITEMS];
+    int count = 0, size = 1, i, slot;
+    char upper[MAX_ISA_NAME];
+
+    fprintf(out, "/* Generated by isagen from %s - do not edit. */\n", fileName);
+    fprintf(out, "#include <string.h>\n\n#include \"utils.h\"\n\n");
+
+    fprintf(out, "/*Opcode descriptor table - indexed by opcode*/\n");
+    fprintf(out, "const opcode_descriptor opcodeTable[ISA_NUM_OPCODES] = {\n");
+    for (i = 0; i < isa->opcodeCount; i++) {
+        upperName(upper, isa->opcodes[i].name);
+        fprintf(out, "        {\"%s\", %d, ", isa->opcodes[i].name, isa->opcodes[i].operandCount);
+        writeModes(out, isa, isa->opcodes[i].srcModes);
+        fprintf(out, ", ");
+        writeModes(out, isa, isa->opcodes[i].dstModes);
+        fprintf(out, ", ISA_ENCODE_FIRST_WORD(ISA_OP_%s, 0, 0, 0)}%s\n", upper, i + 1 < isa->opcodeCount ? "," : "");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "/*Directives */\nchar * directives[ISA_NUM_DIRECTIVES] = {\n");
+    for (i = 0; i < isa->directiveCount; i++)
+        fprintf(out, "        \"%s\"%s\n", isa->directives[i], i + 1 < isa->directiveCount ? "," : "");
+    fprintf(out, "};\n\n");
+
+    /*open addressing with linear probing, at most half full*/
+    for (i = 0; i < isa->opcodeCount; i++, count++) {
+        names[count] = isa->opcodes[i].name;
+        kinds[count] = 1;
+        codes[count] = i;
+    }
+    for (i = 0; i < isa->directiveCount; i++, count++) {
+        names[count] = isa->directives[i];
+        kinds[count] = 2;
+        codes[count] = i;
+    }
+    while (size < 2 * count)
+        size *= 2;
+    for (i = 0; i < size; i++)
+        slots[i] = -1;
+    for (i = 0; i < count; i++) {
+        for (slot = hashName(names[i]) & (size - 1); slots[slot] != -1; slot = (slot + 1) & (size - 1))
+            ;
+        slots[slot] = i;
+    }
+
+    fprintf(out, "/*Reserved words - open addressing hash table*/\n");
+    fprintf(out, "#define RESERVED_TABLE_SIZE %d\n", size);
+    fprintf(out, "static const struct reserved_word {\n    const char *name;\n    int kind;\n    int code;\n} reservedWords[RESERVED_TABLE_SIZE] = {\n");
+    for (i = 0; i < size; i++) {
+        if (slots[i] == -1)
+            fprintf(out, "        {NULL, ISA_NOT_RESERVED, 0}");
+        else
+            fprintf(out, "        {\"%s\", %s, %d}", names[slots[i]],
+                    kinds[slots[i]] == 1 ? "ISA_RESERVED_OPCODE" : "ISA_RESERVED_DIRECTIVE", codes[slots[i]]);
+        fprintf(out, "%s\n", i + 1 < size ? "," : "");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "/*FNV-1a hash of a word*/\n");
+    fprintf(out, "static unsigned long isaHash(const char *name) {\n"
+                 "    unsigned long hash = 2166136261UL;\n"
+                 "    while (*name) {\n"
+                 "        hash ^= (unsigned char)*name++;\n"
+                 "        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;\n"
+                 "    }\n"
+                 "    return hash;\n"
+                 "}\n\n");
+    fprintf(out, "/*Looks up a word in the hash table of reserved words.*/\n");
+    fprintf(out, "int isaLookup(const char *name, int *code) {\n"
+                 "    unsigned long slot = isaHash(name) & (RESERVED_TABLE_SIZE - 1);\n"
+                 "    while (reservedWords[slot].name != NULL) {\n"
+                 "        if (strcmp(reservedWords[slot].name, name) == 0) {\n"
+                 "            if (code != NULL)\n"
+                 "                *code = reservedWords[slot].code;\n"
+                 "            return reservedWords[slot].kind;\n"
+                 "        }\n"
+                 "        slot = (slot + 1) & (RESERVED_TABLE_SIZE - 1);\n"
+                 "    }\n"
+                 "    return ISA_NOT_RESERVED;\n"
+                 "}\n");
+}
+
+int main(int argc, char *argv[]) {
+    isa_description isa;
+    FILE *header, *source;
+
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s <description file> <header file> <source file>\n", argv[0]);
+        return 1;
+    }
+    readDescription(argv[1], &isa);
+    checkDescription(argv[1], &isa);
+
+    header = fopen(argv[2], "w");
+    source = fopen(argv[3], "w");
+    if (header == NULL || source == NULL) {
+        perror("Error opening the generated files");
+        return 1;
+    }
+    writeHeader(header, argv[1], &isa);
+    writeSource(source, argv[1], &isa);
+    fclose(header);
+    fclose(source);
+    return 0;
+}
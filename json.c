@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+/*Deepest nesting of arrays and objects - deeper texts are rejected rather than exhausting the stack*/
+#define MAX_JSON_DEPTH 64
+/*Longest number*/
+#define MAX_JSON_NUMBER 64
+
+/*The text being parsed*/
+typedef struct json_parser {
+    const char *p;
+    const char *end;
+    int depth;
+} json_parser;
+
+static boolean parseValue(json_parser *parser, json_value *value);
+
+/* Skips the white space of a JSON text.*/
+static void skipJsonSpaces(json_parser *parser) {
+    while (parser->p < parser->end && (*parser->p == ' ' || *parser->p == '\t' || *parser->p == '\r' || *parser->p == '\n'))
+        parser->p++;
+}
+
+/* Checks that the text goes on with a word, e.g. "true", and skips it.*/
+static boolean skipWord(json_parser *parser, const char *word) {
+    size_t length = strlen(word);
+    if ((size_t)(parser->end - parser->p) < length || memcmp(parser->p, word, length) != 0)
+        return FALSE;
+    parser->p += length;
+    return TRUE;
+}
+
+/* Parses a string into a new C string.*/
+static boolean parseString(json_parser *parser, char **string) {
+    const char *p = parser->p + 1;
+    char *out, digits[5];
+    unsigned int code;
+
+    if (parser->p >= parser->end || *parser->p != '"' || (*string = out = malloc(parser->end - parser->p)) == NULL)
+        return FALSE;
+    for (; p < parser->end && *p != '"'; p++) {
+        if (*p != '\\') {
+            *out++ = *p;
+            continue;
+        }
+        if (++p == parser->end)
+            break;
+        switch (*p) {
+            case 'n': *out++ = '\n'; break;
+            case 't': *out++ = '\t'; break;
+            case 'r': *out++ = '\r'; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case '"': case '\\': case '/': *out++ = *p; break;
+            case 'u':
+                if (parser->end - p <= 4) {
+                    p = parser->end - 1;
+                    break;
+                }
+                memcpy(digits, p + 1, 4);
+                digits[4] = '\0';
+                if (strspn(digits, "0123456789abcdefABCDEF") < 4) {
+                    p = parser->end - 1; /*not a valid escape*/
+                    break;
+                }
+                code = (unsigned int)strtoul(digits, NULL, 16);
+                *out++ = (code > 0 && code < 0x80) ? (char)code : '?';
+                p += 4;
+                break;
+            default:
+                p = parser->end - 1;
+        }
+    }
+    if (p >= parser->end) {
+        free(*string);
+        *string = NULL;
+        return FALSE;
+    }
+    *out = '\0';
+    parser->p = p + 1;
+    return TRUE;
+}
+
+/* Parses the items of an array or the members of an object, up to the closing bracket.*/
+static boolean parseItems(json_parser *parser, json_value *value, char closing) {
+    int capacity = 0;
+    json_value *newItems;
+    boolean isObject = closing == '}';
+
+    parser->p++;
+    skipJsonSpaces(parser);
+    if (parser->p < parser->end && *parser->p == closing) {
+        parser->p++;
+        return TRUE;
+    }
+    for (;;) {
+        if (value->count == capacity) {
+            /* Double the capacity of the items*/
+            capacity = capacity ? capacity * 2 : 4;
+            newItems = realloc(value->items, capacity * sizeof(json_value));
+            if (newItems == NULL)
+                return FALSE;
+            value->items = newItems;
+        }
+        memset(&value->items[value->count], 0, sizeof(json_value));
+        value->count++;
+        skipJsonSpaces(parser);
+        if (isObject) {
+            if (!parseString(parser, &value->items[value->count - 1].key))
+                return FALSE;
+            skipJsonSpaces(parser);
+            if (parser->p >= parser->end || *parser->p++ != ':')
+                return FALSE;
+        }
+        if (!parseValue(parser, &value->items[value->count - 1]))
+            return FALSE;
+        skipJsonSpaces(parser);
+        if (parser->p < parser->end && *parser->p == ',') {
+            parser->p++;
+        } else if (parser->p < parser->end && *parser->p == closing) {
+            parser->p++;
+            return TRUE;
+        } else {
+            return FALSE;
+        }
+    }
+}
+
+/* Parses a value.*/
+static boolean parseValue(json_parser *parser, json_value *value) {
+    char number[MAX_JSON_NUMBER + 1], *end;
+    size_t length;
+    boolean parsed;
+
+    skipJsonSpaces(parser);
+    if (parser->p >= parser->end)
+        return FALSE;
+    switch (*parser->p) {
+        case '{':
+        case '[':
+            if (++parser->depth > MAX_JSON_DEPTH)
+                return FALSE;
+            value->type = *parser->p == '{' ? JSON_OBJECT : JSON_ARRAY;
+            parsed = parseItems(parser, value, *parser->p == '{' ? '}' : ']');
+            parser->depth--;
+            return parsed;
+        case '"':
+            value->type = JSON_STRING;
+            return parseString(parser, &value->string);
+        case 't':
+        case 'f':
+            value->type = JSON_BOOLEAN;
+            value->boolean = *parser->p == 't';
+            return skipWord(parser, value->boolean ? "true" : "false");
+        case 'n':
+            value->type = JSON_NULL;
+            return skipWord(parser, "null");
+        default:
+            for (length = 0; parser->p + length < parser->end && strchr("+-0123456789.eE", parser->p[length]) != NULL && parser->p[length] != '\0'; length++)
+                ;
+            if (length == 0 || length > MAX_JSON_NUMBER)
+                return FALSE;
+            memcpy(number, parser->p, length);
+            number[length] = '\0';
+            value->type = JSON_NUMBER;
+            value->number = strtod(number, &end);
+            parser->p += length;
+            return *end == '\0';
+    }
+}
+
+/* Frees what a value holds.*/
+static void freeValue(json_value *value) {
+    int i;
+    for (i = 0; i < value->count; i++)
+        freeValue(&value->items[i]);
+    free(value->items);
+    free(value->key);
+    free(value->string);
+}
+
+/* Parses a JSON text.*/
+json_value *parseJson(const char *text, size_t length) {
+    json_parser parser;
+    json_value *value = calloc(1, sizeof(json_value));
+
+    parser.p = text;
+    parser.end = text + length;
+    parser.depth = 0;
+    if (value == NULL)
+        return NULL;
+    if (!parseValue(&parser, value) || (skipJsonSpaces(&parser), parser.p != parser.end)) {
+        freeJson(value);
+        return NULL;
+    }
+    return value;
+}
+
+/* Frees a parsed value.*/
+void freeJson(json_value *value) {
+    if (value == NULL)
+        return;
+    freeValue(value);
+    free(value);
+}
+
+/* Looks up a member of an object.*/
+const json_value *jsonMember(const json_value *object, const char *key) {
+    int i;
+    for (i = 0; object != NULL && object->type == JSON_OBJECT && i < object->count; i++) {
+        if (strcmp(object->items[i].key, key) == 0)
+            return &object->items[i];
+    }
+    return NULL;
+}
+
+/* Looks up a member of an object that must be a number.*/
+long jsonNumber(const json_value *object, const char *key, long fallback) {
+    const json_value *member = jsonMember(object, key);
+    return member != NULL && member->type == JSON_NUMBER ? (long)member->number : fallback;
+}
+
+/* Looks up a member of an object that must be a string.*/
+const char *jsonString(const json_value *object, const char *key) {
+    const json_value *member = jsonMember(object, key);
+    return member != NULL && member->type == JSON_STRING ? member->string : NULL;
+}
+
+/* Makes room for more bytes at the end of a buffer.*/
+static boolean reserveJson(output_buffer *buffer, size_t length) {
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t newCapacity = MAX(buffer->capacity * 2, buffer->length + length + 1);
+        char *newBytes = realloc(buffer->bytes, newCapacity);
+        if (newBytes == NULL)
+            return FALSE;
+        buffer->bytes = newBytes;
+        buffer->capacity = newCapacity;
+    }
+    return TRUE;
+}
+
+/* Appends text to a buffer.*/
+boolean appendJsonText(output_buffer *buffer, const char *text) {
+    size_t length = strlen(text);
+    if (!reserveJson(buffer, length))
+        return FALSE;
+    memcpy(buffer->bytes + buffer->length, text, length + 1);
+    buffer->length += length;
+    return TRUE;
+}
+
+/* Appends a string to a buffer as a JSON string.*/
+boolean appendJsonString(output_buffer *buffer, const char *bytes, size_t length) {
+    size_t i;
+    unsigned char ch;
+
+    /*every byte takes at most 6 characters, \u00XX*/
+    if (!reserveJson(buffer, length * 6 + 2))
+        return FALSE;
+    buffer->bytes[buffer->length++] = '"';
+    for (i = 0; i < length; i++) {
+        ch = (unsigned char)bytes[i];
+        if (ch == '"' || ch == '\\') {
+            buffer->bytes[buffer->length++] = '\\';
+            buffer->bytes[buffer->length++] = (char)ch;
+        } else if (ch == '\n') {
+            buffer->bytes[buffer->length++] = '\\';
+            buffer->bytes[buffer->length++] = 'n';
+        } else if (ch < 0x20 || ch >= 0x7F) {
+            sprintf(buffer->bytes + buffer->length, "\\u%04x", ch);
+            buffer->length += 6;
+        } else {
+            buffer->bytes[buffer->length++] = (char)ch;
+        }
+    }
+    buffer->bytes[buffer->length++] = '"';
+    buffer->bytes[buffer->length] = '\0';
+    return TRUE;
+}
+
+/* Appends a number to a buffer.*/
+boolean appendJsonNumber(output_buffer *buffer, long number) {
+    char digits[32];
+    sprintf(digits, "%ld", number);
+    return appendJsonText(buffer, digits);
+}
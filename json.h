@@ -0,0 +1,93 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+#include "utils.h"
+#include "writeFiles.h"
+
+/*Types of JSON values*/
+typedef enum {
+    JSON_NULL,
+    JSON_BOOLEAN,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+} json_type;
+
+/*A parsed JSON value - the members of an object are items with a key*/
+typedef struct json_value {
+    json_type type;
+    char *key; /*the name of a member of an object, NULL otherwise*/
+    boolean boolean;
+    double number;
+    char *string; /*null-terminated - a zero byte inside the string ends it early*/
+    struct json_value *items; /*the items of an array or the members of an object*/
+    int count;
+} json_value;
+
+/**
+ * Parses a JSON text. Escapes of characters beyond ASCII become '?' - the assembler has no use for them.
+ * @param text The text.
+ * @param length The length of the text.
+ * @return The value, to be freed with freeJson, or NULL if the text is not valid JSON or memory ran out.
+ */
+json_value *parseJson(const char *text, size_t length);
+
+/**
+ * Frees a value returned by parseJson.
+ * @param value The value, or NULL.
+ */
+void freeJson(json_value *value);
+
+/**
+ * Looks up a member of an object.
+ * @param object The object - any other value has no members.
+ * @param key The name of the member.
+ * @return The member, or NULL if there is none.
+ */
+const json_value *jsonMember(const json_value *object, const char *key);
+
+/**
+ * Looks up a member of an object that must be a number.
+ * @param object The object.
+ * @param key The name of the member.
+ * @param fallback The result when there is no such number.
+ * @return The number, as an integer.
+ */
+long jsonNumber(const json_value *object, const char *key, long fallback);
+
+/**
+ * Looks up a member of an object that must be a string.
+ * @param object The object.
+ * @param key The name of the member.
+ * @return The string, or NULL when there is no such string.
+ */
+const char *jsonString(const json_value *object, const char *key);
+
+/**
+ * Appends text to a buffer.
+ * @param buffer The buffer.
+ * @param text The text, added as it is.
+ * @return TRUE on success, FALSE if memory ran out.
+ */
+boolean appendJsonText(output_buffer *buffer, const char *text);
+
+/**
+ * Appends a string to a buffer as a JSON string, in quotation marks and escaped.
+ * @param buffer The buffer.
+ * @param bytes The string.
+ * @param length The length of the string.
+ * @return TRUE on success, FALSE if memory ran out.
+ */
+boolean appendJsonString(output_buffer *buffer, const char *bytes, size_t length);
+
+/**
+ * Appends a number to a buffer.
+ * @param buffer The buffer.
+ * @param number The number.
+ * @return TRUE on success, FALSE if memory ran out.
+ */
+boolean appendJsonNumber(output_buffer *buffer, long number);
+
+#endif /*JSON_H*/
@@ -15,130 +15,59 @@ label_table * createLabelTable() {
     label_table * labelTable = (label_table * ) malloc(sizeof(label_table));
     if (labelTable != NULL) {
         labelTable -> head = NULL;
+        labelTable -> spare = NULL;
     }
     return labelTable;
 }
-/*Checks if a given token matches the expected token type and value*/
-boolean match(TokenType expectedType, const char *expectedValue, Token token) {
-    return token.type == expectedType && strcmp(token.value.string, expectedValue) == 0;
-}
 
+/* Frees every label of a table, and the labels it kept, leaving it empty.*/
+void freeLabelTable(label_table *labelTable) {
+    label *current, *next;
 
-/*only add to table if is label declaration*/
-boolean parseLabel(Token token, char ** line, machine_word codeImage[], machine_word dataImage[], label_table *labelTable, boolean isData, boolean isExternal, boolean isEntry, int *IC, int *DC, int lineNumber) {
+    clearLabelTable(labelTable);
+    for (current = labelTable->spare; current != NULL; current = next) {
+        next = current->next;
+        free(current);
+    }
+    labelTable->spare = NULL;
+}
 
-    Token nextToken;
-    int op_count = 0;
-    while(token.type != 0)
-    {
-    char *name = token.value.string;
-    if (token.type == LABEL_DECLARATION) 
-    {
-    	if(token.type == TWO_OPERANDS) 
-    	{
-        	nextToken = getNextToken(line, lineNumber);
-        	op_count++;
-        	if(op_count == 2) 
-        	{
-        		return (parseTwoOperands(line, token, codeImage, IC, DC, lineNumber));
-        	}
-        } if(token.type == ONE_OPERAND) 
-          {
-        	nextToken = getNextToken(line, lineNumber);
-        	op_count++;
-        	if(op_count == 1)
-        	{
-        		return (parseOneOperand(line, token, codeImage, IC, DC, lineNumber));
-        	}
-          }
-          /*here we get the contents of the label - can get any directive or instruction and then parse according to that*/
-        if (token.type == DIRECTIVE) {
-            if (parseDirective(token, line, codeImage, dataImage, labelTable, isData, isExternal, isEntry, IC, DC,
-                               lineNumber) == FALSE) { /*if the label name is grammatically correct*/
-                printError("Invalid input after label name. isDirective - isLabel", lineNumber);
-                return FALSE;
-            } else {
-                if (strcmp(token.value.string, "data") == 0 || strcmp(token.value.string, "string") == 0) {
-                    isData = TRUE;
-                } else {
-                    if (strcmp(token.value.string, ".entry") == 0 || strcmp(token.value.string, ".extern") == 0) {
-                        printError("'.entry' or '.extern' cannot appear after label name. - isLabel", lineNumber);
-                        return FALSE;
-                    }
-                }
-            }
-        }
+/* Empties a table, keeping its labels to be used again by the next source.*/
+void clearLabelTable(label_table *labelTable) {
+    label *current = labelTable->head, *next;
+    while (current != NULL) {
+        next = current->next;
+        current->next = labelTable->spare;
+        labelTable->spare = current;
+        current = next;
+    }
+    labelTable->head = NULL;
+}
 
-        if (nextToken.type == COMMA) {
-            printError("Comma cannot appear right after label name. - isLabel", lineNumber);
-            printf("token type: %d, value: '%s'\n", token.type, token.value.string);
-            return FALSE;
-        }
-        if (nextToken.type == NUMBER || nextToken.type == INVALID) {
-            printError("Invalid character after label name. INVALID OR NUMBER - isLabel", lineNumber);
-            printf("token type: %d, value: '%s'\n", token.type, token.value.string);
-            return FALSE;
-        }
-        return createLabel(name, labelTable, isExternal, isEntry, isData, IC, DC, lineNumber);
-    } else if (isValidLabel(name, token.type, lineNumber)) /*is a label called in the middle of an instruction*/
-    	createLabel(token.value.string, labelTable, isExternal, isEntry, isData, IC, DC, lineNumber);
-        return TRUE;
-    if (nextToken.type != END) {
-        /*here we get the contents of the label - can get any directive or instruction and then parse according to that*/
-        if (token.type == DIRECTIVE) {
-            if ((match(DIRECTIVE, ".data", token)) || match(DIRECTIVE, ".string", token)) {
-                isData = TRUE;
-                /*if the label name is grammatically correct*/
-                if (parseDirective(token, line, codeImage, dataImage, labelTable, isData, isExternal, isEntry, IC, DC,
-                                   lineNumber))
-                    return createLabel(name, labelTable, isExternal, isEntry, isData, IC, DC, lineNumber);
-                else {
-                    printf("Error found at line #%d: Invalid input after label name. isDirective - isLabel\n",
-                           lineNumber);
-                    return FALSE;
-                }
-            } else {
-                if (match(DIRECTIVE, ".entry", token) || match(DIRECTIVE, ".extern", token)) {
-                    printf("Error found at line #%d: '.entry' or '.extern' cannot appear after label name. - isLabel\n",
-                           lineNumber);
-                    return FALSE;
-                }
-            }
-        }/*strcmp(token.value.string, "mov") == 0*/
+/* Returns a zeroed label, one kept by the table if there is any.*/
+label *allocateLabel(label_table *labelTable) {
+    label *lbl = labelTable->spare;
 
-        if (token.type == TWO_OPERANDS) {
-            if (parseTwoOperands(line, token, codeImage, IC, DC, lineNumber))
-                return createLabel(name, labelTable, isExternal, isEntry, isData, IC, DC, lineNumber);
-            else {
-                printf("Error found at line #%d: Invalid input after label name. - isLabel\n", lineNumber);
-                return FALSE;
-            }
-        }
-        if (token.type == ONE_OPERAND) {
-            if (parseOneOperand(line, token, codeImage, IC, DC, lineNumber))
-                return createLabel(name, labelTable, isExternal, isEntry, isData, IC, DC, lineNumber);
-            else {
-                printf("Error found at line #%d: Invalid input after label name. - isLabel\n", lineNumber);
-                return FALSE;
-            }
-        }
-        if (token.type == NO_OPERANDS) {
-            if (parseNoOperands(line, token, codeImage, IC, DC, lineNumber))
-                return createLabel(name, labelTable, isExternal, isEntry, isData, IC, DC, lineNumber);
-            else {
-                printf("Error found at line #%d: Invalid input after label name. - isLabel\n", lineNumber);
-                return FALSE;
-            }
-        }
-        nextToken = getNextToken(line, lineNumber);
-        lineNumber++;
-    }
+    if (lbl == NULL)
+        return (label *) calloc(1, sizeof(label));
+    labelTable->spare = lbl->next;
+    memset(lbl, 0, sizeof(label));
+    return lbl;
+}
 
-  
-  }
+/*Adds a label declaration, or a label named by ".entry" or ".extern", to the label table*/
+boolean parseLabel(Token token, char ** line, machine_image *image, label_table *labelTable, boolean isData, boolean isExternal, boolean isEntry, int *IC, int *DC, int lineNumber) {
+    char *name = token.value.string;
 
-	nextToken = getNextToken(line, lineNumber);
-    return TRUE;  
+    if (token.type == LABEL_DECLARATION) {
+        /*the colon was already removed by the tokenizer*/
+        return createLabel(name, labelTable, FALSE, FALSE, isData, IC, DC, lineNumber);
+    }
+    if (token.type == LABEL && isValidLabel(name, token.type, lineNumber)) {
+        /*is a label named by ".entry" or ".extern"*/
+        return createLabel(name, labelTable, isExternal, isEntry, FALSE, IC, DC, lineNumber);
+    }
+    return FALSE;
 }
         
 /* Checks if a given string is a valid label name.*/
@@ -181,18 +110,26 @@ boolean isValidLabel(char * str, TokenType type, int lineNumber) {
     return TRUE;
 }
 /* Searches the label table for a specific label name.*/
-boolean findLabel(char * name, label_table *labelTable) {
+label * lookupLabel(const char * name, label_table *labelTable) {
     label * current;
-    boolean isInTable = FALSE;
 
     current = labelTable->head;
     while (current != NULL) {
         /*Checks if the label exists in the table*/
         if (strcmp(name, current -> name) == 0)
-            isInTable = TRUE;
+            return current;
         current = current -> next;
     }
-    return isInTable;
+    return NULL;
+}
+/* Returns the final memory address of a label.*/
+int labelAddress(const machine_image *image, const label * lbl, int IC) {
+    /*the data image is placed right after the code image*/
+    return image -> baseAddress + lbl -> address + (lbl -> isData ? IC : 0);
+}
+/* Checks whether a label name is in the label table.*/
+boolean findLabel(char * name, label_table *labelTable) {
+    return lookupLabel(name, labelTable) != NULL;
 }
 /* Inserts a new label into the label table.*/
 boolean insertLabel(label * newLabel, label_table *labelTable, int lineNumber) {
@@ -214,55 +151,62 @@ boolean insertLabel(label * newLabel, label_table *labelTable, int lineNumber) {
 /* Creates a new label and adds it to the label table.*/
 boolean createLabel(char * name, label_table *labelTable, boolean isExternal, boolean isEntry, boolean isData, int *IC, int *DC, int lineNumber) {
     label * newLabel;
-    /*Checks if label is already in the table. If yes, sends an error message. If not, adds the new label to the table.*/
-    if (findLabel(name + ':', labelTable)) {
-        printWarning("Label is already defined. - creatLabel.", lineNumber);
-        return FALSE;
-    }
+    boolean isDefinition = !isExternal && !isEntry;
 
-    /*Defines a new label and allocates space*/
-    newLabel = (label * ) calloc(MAX_LABEL_LENGTH, sizeof(label));
+    /*A label may be named by ".entry" or ".extern" before or after it is declared - merge with what is already in the table*/
+    newLabel = lookupLabel(name, labelTable);
+    if (newLabel != NULL) {
+        if (isDefinition && newLabel -> isDefined) {
+            printError("Label is already defined. - creatLabel", lineNumber);
+            return FALSE;
+        }
+        if ((isDefinition || isEntry) && newLabel -> isExternal) {
+            printError("Label is declared as external and cannot be defined in this file. - creatLabel", lineNumber);
+            return FALSE;
+        }
+        if (isExternal && (newLabel -> isDefined || newLabel -> isEntry)) {
+            printError("Label defined in this file cannot be declared as external. - creatLabel", lineNumber);
+            return FALSE;
+        }
+        newLabel -> isExternal |= isExternal;
+        newLabel -> isEntry |= isEntry;
+        if (!isDefinition)
+            return TRUE;
+    } else {
+        /*Defines a new label and allocates space*/
+        newLabel = allocateLabel(labelTable);
+        if (newLabel == NULL) {
+            printError("Failed to allocate memory for label.", lineNumber);
+            return FALSE;
+        }
 
-    /*Copies information from file*/
-    strcpy(newLabel -> name, name);
-    newLabel -> isExternal = isExternal;
-    newLabel -> isEntry = isEntry;
-    newLabel -> isData = isData;
+        /*Copies information from file*/
+        strcpy(newLabel -> name, name);
+        newLabel -> isExternal = isExternal;
+        newLabel -> isEntry = isEntry;
+        insertLabel(newLabel, labelTable, lineNumber);
+        if (!isDefinition)
+            return TRUE;
+    }
 
     /*Updates the IC or DC accordingly*/
+    newLabel -> isDefined = TRUE;
+    newLabel -> isData = isData;
     if (!isData)
-    
     	newLabel -> address = *IC;
     else
         newLabel -> address = *DC;
-        
-    
-
-    insertLabel(newLabel, labelTable, lineNumber);
 
     return TRUE;
 }
 /* Checks if a label name is a valid label, operation, or instruction name.*/
 int legalLabelName(char * name) {
-    int currentIn = 0;
-    int currentDi = 0;
-    int isInstruction = 1;
-    int isDirective = 1;
-
-    while (currentIn < NUM_OF_INSTRUCTIONS) {
-        /*Checks if the macro name is an operation*/
-        if (strcmp(name, instructions[currentIn]) == 0)
-            isInstruction = 2;
-        currentIn++;
-    }
-
-    while (currentDi < NUM_OF_DIRECTIVES) {
-        /*Checks if the macro name is a directive*/
-        if (strcmp(name, directives[currentDi]) == 0)
-            isDirective = 3;
-        currentDi++;
+    switch (isaLookup(name, NULL)) {
+        case ISA_RESERVED_OPCODE:
+            return 2;
+        case ISA_RESERVED_DIRECTIVE:
+            return 3;
+        default:
+            return 1;
     }
-
-    return MAX(isInstruction, isDirective);
 }
-
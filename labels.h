@@ -12,12 +12,30 @@
  */
 label_table * createLabelTable();
 
+/**
+ * Frees every label of a table, and the labels it kept, leaving it empty.
+ * @param labelTable The table of labels.
+ */
+void freeLabelTable(label_table *labelTable);
+
+/**
+ * Empties a table, keeping its labels to be used again by allocateLabel.
+ * @param labelTable The table of labels.
+ */
+void clearLabelTable(label_table *labelTable);
+
+/**
+ * Allocates a zeroed label, taking one the table kept if there is any.
+ * @param labelTable The table the label will be inserted into.
+ * @return The label, or NULL if memory ran out.
+ */
+label *allocateLabel(label_table *labelTable);
+
 /**
  * Checks if the given token is a valid label and processes its details.
  * @param token The token to be checked.
  * @param line The current line of assembly code.
- * @param codeImage Array to store the machine words for instructions.
- * @param dataImage Array to store the machine words for data.
+ * @param image The code and data images.
  * @param labelTable The table of labels.
  * @param isData Indicates if the instruction is defined as data.
  * @param isExternal Indicates if the instruction is defined as external.
@@ -27,7 +45,7 @@ label_table * createLabelTable();
  * @param lineNumber The current line number being processed.
  * @return TRUE if processing was successful, FALSE otherwise.
  */
-boolean parseLabel(Token token, char ** line, machine_word codeImage[], machine_word dataImage[], label_table *labelTable, boolean isData, boolean isExternal, boolean isEntry, int *IC, int *DC, int lineNumber);
+boolean parseLabel(Token token, char ** line, machine_image *image, label_table *labelTable, boolean isData, boolean isExternal, boolean isEntry, int *IC, int *DC, int lineNumber);
 
 /**
  * Checks if a given string is a valid label name.
@@ -46,6 +64,23 @@ boolean isValidLabel(char * str, TokenType type, int lineNumber);
  */
 boolean findLabel(char * name, label_table *labelTable);
 
+/**
+ * Searches the label table for a specific label name.
+ * @param name The label name to search for.
+ * @param labelTable The table of labels.
+ * @return The label, or NULL if it is not in the table.
+ */
+label * lookupLabel(const char * name, label_table *labelTable);
+
+/**
+ * Returns the final memory address of a label, once the size of the code image is known.
+ * @param image The image, which holds the base address of the module.
+ * @param lbl The label.
+ * @param IC The final instruction counter.
+ * @return The address of the label.
+ */
+int labelAddress(const machine_image *image, const label * lbl, int IC);
+
 /**
  * Inserts a new label into the label table.
  * @param newLabel The label to be inserted.
@@ -0,0 +1,420 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "lsp.h"
+#include "json.h"
+#include "document.h"
+#include "writeFiles.h"
+#include "utils.h"
+
+/*JSON-RPC error codes*/
+#define METHOD_NOT_FOUND (-32601)
+#define INVALID_PARAMS (-32602)
+/*LSP diagnostic severities*/
+#define SEVERITY_ERROR 1
+#define SEVERITY_WARNING 2
+/*TextDocumentSyncKind.Incremental - the client sends the ranges that changed*/
+#define SYNC_INCREMENTAL 2
+
+/*A document the client opened*/
+typedef struct open_document {
+    char *uri;
+    source_document document;
+} open_document;
+
+/*The state of the server*/
+typedef struct language_server {
+    FILE *output;
+    open_document *documents;
+    int documentCount;
+    int documentCapacity;
+    boolean shutdown;
+} language_server;
+
+/* Reads a message - the headers, and as many bytes as Content-Length says. Returns NULL at the end of the input.*/
+static char *readMessage(FILE *input, size_t *length) {
+    char header[256], *body;
+    long contentLength = -1;
+
+    while (fgets(header, sizeof(header), input) != NULL) {
+        if (strcmp(header, "\r\n") == 0 || strcmp(header, "\n") == 0) {
+            if (contentLength < 0 || contentLength > MAX_LSP_MESSAGE)
+                return NULL;
+            body = malloc((size_t)contentLength + 1);
+            if (body == NULL || fread(body, 1, (size_t)contentLength, input) != (size_t)contentLength) {
+                free(body);
+                return NULL;
+            }
+            body[contentLength] = '\0';
+            *length = (size_t)contentLength;
+            return body;
+        }
+        if (strncmp(header, "Content-Length:", 15) == 0)
+            contentLength = strtol(header + 15, NULL, 10);
+    }
+    return NULL;
+}
+
+/* Sends a message that was formatted in a buffer, and empties the buffer.*/
+static void sendMessage(language_server *server, output_buffer *message, boolean formatted) {
+    if (formatted) {
+        fprintf(server->output, "Content-Length: %lu\r\n\r\n", (unsigned long)message->length);
+        fwrite(message->bytes, 1, message->length, server->output);
+        fflush(server->output);
+    }
+    free(message->bytes);
+    message->bytes = NULL;
+    message->length = 0;
+    message->capacity = 0;
+}
+
+/* Appends the id of a request, as the client sent it.*/
+static boolean appendId(output_buffer *message, const json_value *id) {
+    if (id->type == JSON_STRING)
+        return appendJsonString(message, id->string, strlen(id->string));
+    return appendJsonNumber(message, (long)id->number);
+}
+
+/* Sends the result of a request - result is JSON text.*/
+static void sendResult(language_server *server, const json_value *id, output_buffer *result) {
+    output_buffer message = {NULL, 0, 0};
+    boolean formatted = appendJsonText(&message, "{\"jsonrpc\":\"2.0\",\"id\":") && appendId(&message, id)
+        && appendJsonText(&message, ",\"result\":") && appendJsonText(&message, result->bytes != NULL ? result->bytes : "null")
+        && appendJsonText(&message, "}");
+    sendMessage(server, &message, formatted);
+    free(result->bytes);
+}
+
+/* Sends the error of a request.*/
+static void sendError(language_server *server, const json_value *id, int code, const char *text) {
+    output_buffer message = {NULL, 0, 0};
+    boolean formatted = appendJsonText(&message, "{\"jsonrpc\":\"2.0\",\"id\":") && appendId(&message, id)
+        && appendJsonText(&message, ",\"error\":{\"code\":") && appendJsonNumber(&message, code)
+        && appendJsonText(&message, ",\"message\":") && appendJsonString(&message, text, strlen(text))
+        && appendJsonText(&message, "}}");
+    sendMessage(server, &message, formatted);
+}
+
+/* Looks up an open document by its URI. Returns NULL if the client did not open it.*/
+static open_document *findDocument(language_server *server, const char *uri) {
+    int i;
+    for (i = 0; uri != NULL && i < server->documentCount; i++) {
+        if (strcmp(server->documents[i].uri, uri) == 0)
+            return &server->documents[i];
+    }
+    return NULL;
+}
+
+/* Appends a range of a single line.*/
+static boolean appendRange(output_buffer *message, int line, int startColumn, int endColumn) {
+    return appendJsonText(message, "{\"start\":{\"line\":") && appendJsonNumber(message, line)
+        && appendJsonText(message, ",\"character\":") && appendJsonNumber(message, startColumn)
+        && appendJsonText(message, "},\"end\":{\"line\":") && appendJsonNumber(message, line)
+        && appendJsonText(message, ",\"character\":") && appendJsonNumber(message, endColumn)
+        && appendJsonText(message, "}}");
+}
+
+/*The diagnostics of a document, while they are formatted*/
+typedef struct diagnostic_list {
+    output_buffer *message;
+    const source_document *document;
+    int count;
+    boolean formatted;
+} diagnostic_list;
+
+/* Appends a problem of a document to its diagnostics.*/
+static void appendDiagnostic(int line, boolean isError, const char *text, void *arg) {
+    diagnostic_list *list = arg;
+    list->formatted = list->formatted && appendJsonText(list->message, list->count++ > 0 ? ",{\"range\":" : "{\"range\":")
+        && appendRange(list->message, line, 0, (int)strlen(list->document->lines[line].text))
+        && appendJsonText(list->message, ",\"severity\":") && appendJsonNumber(list->message, isError ? SEVERITY_ERROR : SEVERITY_WARNING)
+        && appendJsonText(list->message, ",\"source\":\"assembler\",\"message\":") && appendJsonString(list->message, text, strlen(text))
+        && appendJsonText(list->message, "}");
+}
+
+/* Publishes the problems of a document - or none, for a document that was closed.*/
+static void publishDiagnostics(language_server *server, const char *uri, source_document *document) {
+    output_buffer message = {NULL, 0, 0};
+    diagnostic_list list;
+
+    list.message = &message;
+    list.document = document;
+    list.count = 0;
+    list.formatted = appendJsonText(&message, "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":")
+        && appendJsonString(&message, uri, strlen(uri)) && appendJsonText(&message, ",\"diagnostics\":[");
+    if (document != NULL)
+        reportProblems(document, appendDiagnostic, &list);
+    list.formatted = list.formatted && appendJsonText(&message, "]}}");
+    sendMessage(server, &message, list.formatted);
+}
+
+/* Reads the position of a request - returns FALSE if it is not in the document.*/
+static boolean readPosition(const json_value *params, const source_document *document, int *line, int *column) {
+    const json_value *position = jsonMember(params, "position");
+    *line = (int)jsonNumber(position, "line", -1);
+    *column = (int)jsonNumber(position, "character", -1);
+    return *line >= 0 && *line < document->lineCount && *column >= 0;
+}
+
+/* Copies the name under a position of a line - letters and digits, the characters of labels and macros.*/
+static boolean nameAt(const char *text, int column, char *name, size_t size) {
+    int start = MIN(column, (int)strlen(text)), end = start;
+    while (start > 0 && (isalnum((unsigned char)text[start - 1]) || text[start - 1] == '_'))
+        start--;
+    while (isalnum((unsigned char)text[end]) || text[end] == '_')
+        end++;
+    if (end == start || (size_t)(end - start) >= size)
+        return FALSE;
+    sprintf(name, "%.*s", end - start, text + start);
+    return TRUE;
+}
+
+/* Finds the column of a name in a line, as a whole word - 0 if it is not there.*/
+static int columnOf(const char *text, const char *name) {
+    const char *found;
+    size_t length = strlen(name);
+    for (found = strstr(text, name); found != NULL; found = strstr(found + 1, name)) {
+        if ((found == text || !isalnum((unsigned char)found[-1])) && !isalnum((unsigned char)found[length]))
+            return (int)(found - text);
+    }
+    return 0;
+}
+
+/* Answers textDocument/definition - the declaration of the label, or the definition of the macro, under the cursor.*/
+static void answerDefinition(language_server *server, const json_value *id, const json_value *params) {
+    const json_value *textDocument = jsonMember(params, "textDocument");
+    const char *uri = jsonString(textDocument, "uri");
+    open_document *open = findDocument(server, uri);
+    output_buffer result = {NULL, 0, 0};
+    const symbol_entry *declaration;
+    char name[MAX_LINE_LENGTH + 1];
+    int line, column, target = -1;
+
+    if (open == NULL || !readPosition(params, &open->document, &line, &column)) {
+        sendError(server, id, INVALID_PARAMS, "Unknown document or position.");
+        return;
+    }
+    if (nameAt(open->document.lines[line].text, column, name, sizeof(name))) {
+        declaration = strlen(name) <= MAX_LABEL_LENGTH ? findDeclaration(&open->document, name) : NULL;
+        target = declaration != NULL ? declaration->line : findMacroDefinition(&open->document, name);
+    }
+    if (target != -1) {
+        column = columnOf(open->document.lines[target].text, name);
+        if (!appendJsonText(&result, "{\"uri\":") || !appendJsonString(&result, uri, strlen(uri)) || !appendJsonText(&result, ",\"range\":")
+                || !appendRange(&result, target, column, column + (int)strlen(name)) || !appendJsonText(&result, "}")) {
+            free(result.bytes);
+            result.bytes = NULL;
+        }
+    }
+    sendResult(server, id, &result);
+}
+
+/* Appends the hover lines of the words of a line - "address  base64  bits" for each word.*/
+static boolean appendWords(output_buffer *text, source_document *document, int line, boolean data) {
+    const source_line *current = &document->lines[line];
+    char row[64], base64[ISA_BASE64_DIGITS + 1], binary[ISA_WORD_BITS + 1];
+    int count = data ? current->dataWords : current->codeWords, kept = MIN(count, LINE_HOVER_WORDS), i;
+    int address = data ? lineDataAddress(document, line) : lineCodeAddress(document, line);
+    boolean resolved = TRUE, formatted = TRUE;
+    word_t word;
+
+    for (i = 0; i < kept && formatted; i++) {
+        if (data)
+            word = current->words[MIN(current->codeWords, LINE_HOVER_WORDS) + i];
+        else
+            word = resolvedCodeWord(document, line, i, &resolved);
+        formatWord(word, base64, binary);
+        sprintf(row, "%04d  %s  %s%s\n", address + i, base64, binary, resolved ? "" : "  (undefined label)");
+        formatted = appendJsonText(text, row);
+    }
+    if (count > kept && formatted) {
+        sprintf(row, "... %d more %s words\n", count - kept, data ? "data" : "code");
+        formatted = appendJsonText(text, row);
+    }
+    return formatted;
+}
+
+/* Answers textDocument/hover - the address and the words of the line, and the address of the label under the cursor.*/
+static void answerHover(language_server *server, const json_value *id, const json_value *params) {
+    open_document *open = findDocument(server, jsonString(jsonMember(params, "textDocument"), "uri"));
+    output_buffer text = {NULL, 0, 0}, result = {NULL, 0, 0};
+    const symbol_entry *declaration;
+    const source_line *current;
+    char name[MAX_LINE_LENGTH + 1], row[MAX_LINE_LENGTH + 64];
+    int line, column;
+    boolean formatted;
+
+    if (open == NULL || !readPosition(params, &open->document, &line, &column)) {
+        sendError(server, id, INVALID_PARAMS, "Unknown document or position.");
+        return;
+    }
+    current = &open->document.lines[line];
+    formatted = appendJsonText(&text, "```\n"); /*a code block, so the columns of the words line up*/
+    if (formatted && nameAt(current->text, column, name, sizeof(name)) && strlen(name) <= MAX_LABEL_LENGTH
+            && (declaration = findDeclaration(&open->document, name)) != NULL) {
+        if (declaration->kind == SYMBOL_EXTERN)
+            sprintf(row, "%s - external label\n", name);
+        else
+            sprintf(row, "%s = %04d (%s)\n", name, declarationAddress(&open->document, declaration), declaration->kind == SYMBOL_DATA ? "data" : "code");
+        formatted = appendJsonText(&text, row);
+    }
+    if (current->codeWords > 0 && formatted)
+        formatted = appendWords(&text, &open->document, line, FALSE);
+    if (current->dataWords > 0 && formatted)
+        formatted = appendWords(&text, &open->document, line, TRUE);
+
+    if (formatted && text.length > strlen("```\n")) {
+        formatted = appendJsonText(&text, "```") && appendJsonText(&result, "{\"contents\":{\"kind\":\"markdown\",\"value\":")
+            && appendJsonString(&result, text.bytes, text.length) && appendJsonText(&result, "}}");
+    }
+    if (!formatted) {
+        free(result.bytes);
+        result.bytes = NULL;
+    }
+    free(text.bytes);
+    sendResult(server, id, &result);
+}
+
+/* Handles textDocument/didOpen.*/
+static void openTextDocument(language_server *server, const json_value *params) {
+    const json_value *textDocument = jsonMember(params, "textDocument");
+    const char *uri = jsonString(textDocument, "uri"), *text = jsonString(textDocument, "text");
+    open_document *open = findDocument(server, uri), *newDocuments;
+
+    if (uri == NULL || text == NULL)
+        return;
+    if (open != NULL) {
+        closeDocument(&open->document); /*opened again - the new text replaces the old*/
+    } else {
+        if (server->documentCount == server->documentCapacity) {
+            /* Double the capacity of the document list*/
+            int newCapacity = server->documentCapacity ? server->documentCapacity * 2 : 4;
+            newDocuments = realloc(server->documents, newCapacity * sizeof(open_document));
+            if (newDocuments == NULL)
+                return;
+            server->documents = newDocuments;
+            server->documentCapacity = newCapacity;
+        }
+        open = &server->documents[server->documentCount];
+        if ((open->uri = malloc(strlen(uri) + 1)) == NULL)
+            return;
+        strcpy(open->uri, uri);
+        server->documentCount++;
+    }
+    openDocument(&open->document, text, strlen(text));
+    publishDiagnostics(server, uri, &open->document);
+}
+
+/* Handles textDocument/didChange - every change replaces a range, or the whole text if it has no range.*/
+static void changeTextDocument(language_server *server, const json_value *params) {
+    const char *uri = jsonString(jsonMember(params, "textDocument"), "uri"), *text;
+    const json_value *changes = jsonMember(params, "contentChanges"), *range;
+    open_document *open = findDocument(server, uri);
+    int i;
+
+    if (open == NULL || changes == NULL || changes->type != JSON_ARRAY)
+        return;
+    for (i = 0; i < changes->count; i++) {
+        text = jsonString(&changes->items[i], "text");
+        range = jsonMember(&changes->items[i], "range");
+        if (text == NULL)
+            continue;
+        if (range == NULL) {
+            closeDocument(&open->document);
+            openDocument(&open->document, text, strlen(text));
+        } else {
+            editDocument(&open->document,
+                (int)jsonNumber(jsonMember(range, "start"), "line", -1), (int)jsonNumber(jsonMember(range, "start"), "character", -1),
+                (int)jsonNumber(jsonMember(range, "end"), "line", -1), (int)jsonNumber(jsonMember(range, "end"), "character", -1),
+                text, strlen(text));
+        }
+    }
+    publishDiagnostics(server, uri, &open->document);
+}
+
+/* Handles textDocument/didClose.*/
+static void closeTextDocument(language_server *server, const json_value *params) {
+    const char *uri = jsonString(jsonMember(params, "textDocument"), "uri");
+    open_document *open = findDocument(server, uri);
+
+    if (open == NULL)
+        return;
+    publishDiagnostics(server, uri, NULL);
+    closeDocument(&open->document);
+    free(open->uri);
+    *open = server->documents[--server->documentCount];
+}
+
+/* Answers initialize with what the server can do.*/
+static void answerInitialize(language_server *server, const json_value *id) {
+    output_buffer result = {NULL, 0, 0};
+    char capabilities[256];
+    sprintf(capabilities, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":%d},\"hoverProvider\":true,"
+        "\"definitionProvider\":true},\"serverInfo\":{\"name\":\"assembler\"}}", SYNC_INCREMENTAL);
+    if (!appendJsonText(&result, capabilities)) {
+        free(result.bytes);
+        result.bytes = NULL;
+    }
+    sendResult(server, id, &result);
+}
+
+/* Serves the Language Server Protocol.*/
+int serveLanguageServer(FILE *input, FILE *output) {
+    language_server server;
+    char *body;
+    size_t length;
+    json_value *message;
+    const json_value *id, *params;
+    const char *method;
+    output_buffer empty = {NULL, 0, 0};
+    int status = 1, i;
+
+    server.output = output;
+    server.documents = NULL;
+    server.documentCount = 0;
+    server.documentCapacity = 0;
+    server.shutdown = FALSE;
+    while ((body = readMessage(input, &length)) != NULL) {
+        message = parseJson(body, length);
+        free(body);
+        method = jsonString(message, "method");
+        id = jsonMember(message, "id");
+        params = jsonMember(message, "params");
+        if (id != NULL && id->type != JSON_NUMBER && id->type != JSON_STRING)
+            id = NULL;
+        if (method == NULL) {
+            /*a reply to a request of the server, which sends none, or not JSON-RPC at all*/
+        } else if (strcmp(method, "exit") == 0) {
+            status = server.shutdown ? 0 : 1;
+            freeJson(message);
+            break;
+        } else if (strcmp(method, "initialize") == 0 && id != NULL) {
+            answerInitialize(&server, id);
+        } else if (strcmp(method, "shutdown") == 0 && id != NULL) {
+            server.shutdown = TRUE;
+            sendResult(&server, id, &empty);
+        } else if (strcmp(method, "textDocument/didOpen") == 0) {
+            openTextDocument(&server, params);
+        } else if (strcmp(method, "textDocument/didChange") == 0) {
+            changeTextDocument(&server, params);
+        } else if (strcmp(method, "textDocument/didClose") == 0) {
+            closeTextDocument(&server, params);
+        } else if (strcmp(method, "textDocument/hover") == 0 && id != NULL) {
+            answerHover(&server, id, params);
+        } else if (strcmp(method, "textDocument/definition") == 0 && id != NULL) {
+            answerDefinition(&server, id, params);
+        } else if (id != NULL) {
+            sendError(&server, id, METHOD_NOT_FOUND, "Unknown method.");
+        }
+        /*notifications the server has no use for, e.g. initialized, are ignored*/
+        freeJson(message);
+    }
+    for (i = 0; i < server.documentCount; i++) {
+        closeDocument(&server.documents[i].document);
+        free(server.documents[i].uri);
+    }
+    free(server.documents);
+    return status;
+}
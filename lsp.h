@@ -0,0 +1,20 @@
+#ifndef LSP_H
+#define LSP_H
+
+#include <stdio.h>
+
+/*Largest message a client may send, in bytes*/
+#define MAX_LSP_MESSAGE (64L * 1024 * 1024)
+
+/**
+ * Serves the Language Server Protocol - JSON-RPC messages with Content-Length headers - until the client sends 'exit'.
+ * Open documents are kept in memory and parsed a line at a time: an edit parses only the lines it changed.
+ * Publishes the errors and warnings of every document after each change, and answers hovers - the address and the
+ * words of a line - and go-to-definition of labels and macros. Columns are counted in bytes.
+ * @param input The messages of the client.
+ * @param output The messages of the server.
+ * @return The exit status - 0 if the client sent 'shutdown' before 'exit'.
+ */
+int serveLanguageServer(FILE *input, FILE *output);
+
+#endif /*LSP_H*/
@@ -1,100 +1,541 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include "parser.h"
-#include "directives.h"
-#include "instructions.h"
-#include "labels.h"
 #include "utils.h"
-#include "writeFiles.h"
-#include "preprocessor.h"
-
- /**
- * Generates an intermediate file name by replacing the extension with ".am".
- * 
- * @param fileName The original file name.
- * @return A dynamically allocated string containing the intermediate file name.
- *         The caller is responsible for freeing the memory.
+#include "assembler.h"
+#include "threadPool.h"
+#include "fileIO.h"
+#include "cache.h"
+#include "trace.h"
+#include "daemon.h"
+#include "watch.h"
+#include "lsp.h"
+
+/*Most bytes of source read ahead of time, before the workers start*/
+#define PREFETCH_LIMIT (64L * 1024 * 1024)
+/*Reads submitted at once while reading ahead*/
+#define PREFETCH_ENTRIES 64
+
+/*The files of one run of the assembler, assembled by a pool of workers*/
+typedef struct assembly_batch {
+    char **files;
+    int fileCount;
+    assembler_options options;
+    AssemblerContext **contexts; /*one for every worker, created by the worker on its first file*/
+    build_cache *cache; /*NULL without --cache*/
+    file_contents *sources; /*the files read ahead of time - NULL bytes for a file its worker reads itself*/
+    diagnostics *messages; /*the output of every file, printed in the order of the files*/
+    boolean *finished;
+    char ***includes; /*with --watch, the files every source embeds, as a NULL ended list - NULL without --watch*/
+    int nextToPrint;
+    boolean failed; /*a file of the batch could not be read or assembled*/
+    pthread_mutex_t printLock;
+} assembly_batch;
+
+/*What a daemon keeps from one command line to the next - the contexts of the workers, with their buffers and I/O queues*/
+typedef struct warm_state {
+    AssemblerContext **contexts;
+    int contextCount;
+} warm_state;
+
+/**
+ * Reads the options given on the command line. Options may appear anywhere among the file names.
+ *
+ * @param argc The number of command line arguments.
+ * @param argv The command line arguments.
+ * @param options The options to fill in.
+ * @param files Output for the arguments that are not options - room for argc of them.
+ * @param fileCount Output for the number of files.
+ * @return TRUE if all options are known, FALSE otherwise.
  */
-char* generateIntermediateFileName(const char* fileName) {
-    static char intermediateFileName[MAX_FILE_NAME_LENGTH];
-    char* fileExtension;
-    strcpy(intermediateFileName, fileName);
-    fileExtension = strrchr(intermediateFileName, '.'); /* Locate the last dot in the filename */
-    if (fileExtension) {
-        *fileExtension = '\0'; /* Trim the extension */
-    }
-    strcat(intermediateFileName, ".am"); /* Append .am to the name */
-    return intermediateFileName;
+static boolean parseOptions(int argc, char * argv[], assembler_options *options, char * files[], int *fileCount) {
+    int i;
+    char *jobs, *end;
+    long number;
+    options->onePass = FALSE;
+    options->optimize = FALSE;
+    options->pool = FALSE;
+    options->binaryObject = FALSE;
+    options->noFiles = FALSE;
+    options->jobs = 1;
+    options->splits = 1;
+    options->memorySize = DEFAULT_MEMORY_SPACE;
+    options->baseAddress = DEFAULT_BASE_ADDRESS;
+    options->cacheDirectory = NULL;
+    options->cacheMegabytes = DEFAULT_CACHE_MEGABYTES;
+    options->cacheStatistics = FALSE;
+    options->watch = FALSE;
+    options->traceCategories = 0;
+    options->traceLevel = TRACE_OFF;
+    *fileCount = 0;
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            files[(*fileCount)++] = argv[i];
+            continue;
+        }
+        if (strcmp(argv[i], "-1") == 0 || strcmp(argv[i], "--one-pass") == 0) {
+            options->onePass = TRUE;
+        } else if (strcmp(argv[i], "-O") == 0 || strcmp(argv[i], "--optimize") == 0) {
+            options->optimize = TRUE;
+        } else if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "--pool") == 0) {
+            options->pool = TRUE;
+        } else if (strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--obx") == 0) {
+            options->binaryObject = TRUE;
+        } else if (strncmp(argv[i], "-j", 2) == 0 || strncmp(argv[i], "--jobs=", 7) == 0) {
+            /*-j N, -jN or --jobs=N - zero for every core*/
+            jobs = argv[i][1] == 'j' ? argv[i] + 2 : argv[i] + 7;
+            if (*jobs == '\0' && argv[i][1] == 'j' && i + 1 < argc)
+                jobs = argv[++i];
+            options->jobs = (int)strtol(jobs, &end, 10);
+            if (*jobs == '\0' || *end != '\0' || options->jobs < 0) {
+                printf("The number of jobs in '%s' should be a number of at least zero.\n", argv[i]);
+                return FALSE;
+            }
+            if (options->jobs == 0)
+                options->jobs = (int)MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+        } else if (strncmp(argv[i], "--split=", 8) == 0) {
+            /*zero for every core*/
+            options->splits = (int)strtol(argv[i] + 8, &end, 10);
+            if (argv[i][8] == '\0' || *end != '\0' || options->splits < 0) {
+                printf("The number of pieces in '%s' should be a number of at least zero.\n", argv[i]);
+                return FALSE;
+            }
+            if (options->splits == 0)
+                options->splits = (int)MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+        } else if (strncmp(argv[i], "--memory=", 9) == 0) {
+            number = strtol(argv[i] + 9, &end, 10);
+            if (argv[i][9] == '\0' || *end != '\0' || number < 1 || number > LARGEST_MEMORY_SPACE) {
+                printf("The memory size in '%s' should be a number of words from 1 to %ld.\n", argv[i], LARGEST_MEMORY_SPACE);
+                return FALSE;
+            }
+            options->memorySize = (int)number;
+        } else if (strncmp(argv[i], "--base=", 7) == 0) {
+            number = strtol(argv[i] + 7, &end, 10);
+            if (argv[i][7] == '\0' || *end != '\0' || number < 0 || number > LARGEST_MEMORY_SPACE) {
+                printf("The base address in '%s' should be a number from 0 to %ld.\n", argv[i], LARGEST_MEMORY_SPACE);
+                return FALSE;
+            }
+            options->baseAddress = (int)number;
+        } else if (strncmp(argv[i], "--cache=", 8) == 0 && argv[i][8] != '\0') {
+            options->cacheDirectory = argv[i] + 8;
+        } else if (strncmp(argv[i], "--cache-size=", 13) == 0) {
+            options->cacheMegabytes = strtol(argv[i] + 13, &end, 10);
+            if (argv[i][13] == '\0' || *end != '\0' || options->cacheMegabytes < 0) {
+                printf("The cache size in '%s' should be a number of megabytes.\n", argv[i]);
+                return FALSE;
+            }
+        } else if (strcmp(argv[i], "--cache-stats") == 0) {
+            options->cacheStatistics = TRUE;
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            options->watch = TRUE;
+        } else if (strspn(argv[i] + 1, "v") == strlen(argv[i]) - 1) {
+            options->traceLevel += (int)strlen(argv[i]) - 1; /*-v for information, -vv for every detail*/
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            options->traceLevel++;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            if (!parseTraceCategories(argv[i] + 8, &options->traceCategories)) {
+                printf("Unknown trace category in '%s' - the categories are encode, labels and all.\n", argv[i]);
+                return FALSE;
+            }
+        } else {
+            printf("Unknown option '%s'.\n", argv[i]);
+            return FALSE;
+        }
+    }
+    /*-v alone traces every category, --trace alone traces its categories in full*/
+    if (options->traceLevel > TRACE_OFF && options->traceCategories == 0)
+        options->traceCategories = TRACE_ALL;
+    if (options->traceLevel == TRACE_OFF && options->traceCategories != 0)
+        options->traceLevel = TRACE_DEBUG;
+    return TRUE;
 }
 
 
-int main(int argc, char * argv[]) {
-    MacroTable macroTable;
-    int i, IC = 0, DC = 0, lineNumber = 1;
-    boolean ERROR_FOUND = FALSE;
-    machine_word codeImage[MAX_MEMORY_SPACE], dataImage[MAX_MEMORY_SPACE];
-    char codeImage64[MAX_MEMORY_SPACE], dataImage64[MAX_MEMORY_SPACE];
-    unsigned short codeImageBinary[MAX_MEMORY_SPACE], dataImageBinary[MAX_MEMORY_SPACE];
-    char line[MAX_LINE_LENGTH+1]; /*adding one extra space for NULL ending*/
-    FILE *outputFile;
-    char* intermediateFileName;
-    
-    label_table labelTable = *createLabelTable();   
-    label *head;
-    if (argc <= 1) {
-        printError("Error - no files in command line.", 0);
-        return 1;
+/**
+ * Checks if a file name ends with ".as".
+ * @param fileName The file name.
+ * @return TRUE if it does, FALSE otherwise.
+ */
+static boolean isSourceFileName(const char *fileName) {
+    return strlen(fileName) > 3 && strcmp(fileName + strlen(fileName) - 3, ".as") == 0;
+}
+
+/**
+ * Prints the output of the files that are finished, up to the first that is not, so the output keeps the order of the files.
+ * The caller holds the print lock.
+ * @param batch The batch.
+ */
+static void printFinished(assembly_batch *batch) {
+    diagnostics *messages;
+    while (batch->nextToPrint < batch->fileCount && batch->finished[batch->nextToPrint]) {
+        messages = &batch->messages[batch->nextToPrint++];
+        if (messages->text != NULL)
+            fputs(messages->text, stdout);
+        free(messages->text);
+        messages->text = NULL;
     }
+    fflush(stdout);
+}
 
-    for (i = 1; i < argc; i++) {
-        char * fileName = argv[i];
-        /*Check if the file name ends with ".as"*/
-        if (!(strlen(fileName) > 3 && strcmp(fileName + strlen(fileName) - 3, ".as") == 0)) {
-            printf("Skipping file '%s' as it does not have the '.as' extension.\n", fileName);
-            continue;
+/**
+ * Copies the names of the files an image embeds, as the image is reset before the next file.
+ * @param image The image.
+ * @return A NULL ended list of the names, NULL if memory ran out.
+ */
+static char **copyIncludes(const machine_image *image) {
+    char **names = malloc((image->includeCount + 1) * sizeof(char *));
+    int i;
+    for (i = 0; names != NULL && i < image->includeCount; i++) {
+        names[i] = malloc(strlen(image->includes[i]) + 1);
+        if (names[i] != NULL)
+            strcpy(names[i], image->includes[i]);
+        else
+            break;
+    }
+    if (names != NULL)
+        names[i] = NULL;
+    return names;
+}
+
+/**
+ * Frees a list made by copyIncludes.
+ * @param names The list, or NULL.
+ */
+static void freeIncludes(char **names) {
+    int i;
+    for (i = 0; names != NULL && names[i] != NULL; i++)
+        free(names[i]);
+    free(names);
+}
+
+/**
+ * Assembles one file of a batch, collecting its output to be printed in order.
+ * @param job The index of the file.
+ * @param worker The index of the worker.
+ * @param arg The batch.
+ */
+static void assembleJob(int job, int worker, void *arg) {
+    assembly_batch *batch = arg;
+    char * fileName = batch->files[job];
+    AssemblerContext *context = batch->contexts[worker];
+    file_contents *source = &batch->sources[job];
+    size_t firstMessage;
+    boolean assembled = FALSE;
+
+    if (context == NULL) {
+        context = malloc(sizeof(AssemblerContext));
+        if (context != NULL)
+            initAssemblerContext(context, &batch->options);
+        batch->contexts[worker] = context;
+    } else {
+        context->options = batch->options; /*a context kept by a daemon from an earlier command line*/
+    }
+    batch->messages[job].colors = TRUE;
+    setDiagnosticSink(&batch->messages[job]);
+    if (!isSourceFileName(fileName)) {
+        printMessage("Skipping file '%s' as it does not have the '.as' extension.\n", fileName);
+    } else if (context == NULL) {
+        printMessage("Failed to allocate memory for the assembler of '%s'.\n", fileName);
+    } else {
+        printMessage("Processing file: %s\n", fileName);
+        if (source->bytes == NULL && !readFiles(&context->io, &batch->files[job], 1, source)) {
+            printMessage("Error opening files.\n");
+        } else if (batch->cache != NULL && restoreFromCache(batch->cache, fileName, source->bytes, source->length, &context->image)) {
+            assembled = TRUE;
+        } else {
+            firstMessage = batch->messages[job].length;
+            assembled = assembleFileContents(context, fileName, source->bytes, source->length);
+            if (assembled && batch->options.optimize) {
+                printMessage("Optimizer saved %d words in %s.\n", context->wordsSaved, fileName);
+            }
+            /*the messages are kept with the outputs, to be printed again on a hit*/
+            if (assembled && batch->cache != NULL) {
+                addToCache(batch->cache, fileName, source->bytes, source->length, &context->image,
+                    batch->messages[job].text + firstMessage, batch->messages[job].length - firstMessage);
+            }
         }
-        printf("Processing file: %s\n", fileName);
-        lineNumber = 1;
-        ERROR_FOUND = FALSE;
-        /* MacroTable macroTable;*/
-    initializeMacroTable(&macroTable);
-    intermediateFileName = generateIntermediateFileName(fileName);
-	processSourceFile(fileName, intermediateFileName, &macroTable);
-    freeMacroTable(&macroTable);
-          
-        outputFile = fopen(intermediateFileName, "r"); /* Open the processed output file*/
-        if (outputFile == NULL) {
-            perror("Error opening the processed output file");
-            return 1;
-       
+        if (batch->includes != NULL)
+            batch->includes[job] = copyIncludes(&context->image);
+        resetAssemblerContext(context);
+    }
+    setDiagnosticSink(NULL);
+    free(source->bytes);
+    source->bytes = NULL;
+
+    pthread_mutex_lock(&batch->printLock);
+    batch->failed |= !assembled && isSourceFileName(fileName);
+    batch->finished[job] = TRUE;
+    printFinished(batch);
+    pthread_mutex_unlock(&batch->printLock);
+}
+
+/**
+ * Reads the source files of a batch ahead of time, with all the reads submitted at once, up to PREFETCH_LIMIT bytes.
+ * The files beyond the limit, and those that cannot be read, are left to their workers.
+ * @param batch The batch.
+ * @param sizes The size of every file.
+ */
+static void prefetchSources(assembly_batch *batch, const long sizes[]) {
+    io_queue io;
+    char **names = malloc((batch->fileCount + 1) * sizeof(char *));
+    file_contents *contents = malloc((batch->fileCount + 1) * sizeof(file_contents));
+    int *jobs = malloc((batch->fileCount + 1) * sizeof(int));
+    long total = 0;
+    int i, count = 0;
+
+    if (names != NULL && contents != NULL && jobs != NULL) {
+        for (i = 0; i < batch->fileCount; i++) {
+            if (!isSourceFileName(batch->files[i]) || total + sizes[i] > PREFETCH_LIMIT)
+                continue;
+            total += sizes[i];
+            names[count] = batch->files[i];
+            jobs[count++] = i;
         }
-       
-        /* Process the file end with .am line by line*/
-        while (fgets(line, sizeof(line), outputFile) != NULL) {
-        
-            ERROR_FOUND |= (parseLine(line, codeImage, dataImage, &labelTable, &IC, &DC, lineNumber) == FALSE);
-            
-            
-  
-            lineNumber++;
-            
-         continue;     
-             
+        openIOQueue(&io, PREFETCH_ENTRIES);
+        readFiles(&io, names, count, contents);
+        closeIOQueue(&io);
+        for (i = 0; i < count; i++)
+            batch->sources[jobs[i]] = contents[i];
+    }
+    free(names);
+    free(contents);
+    free(jobs);
+}
+
+/**
+ * Assembles the files of a batch - its files, options, contexts and cache are set, the rest is filled in here.
+ * @param batch The batch.
+ * @return TRUE if the files were assembled, FALSE if memory ran out.
+ */
+static boolean runBatch(assembly_batch *batch) {
+    int i;
+    long *sizes;
+    struct stat fileStatus;
+
+    /*the largest files are assembled first, so the last worker to finish does not start a large file late*/
+    sizes = malloc((batch->fileCount + 1) * sizeof(long));
+    batch->sources = calloc(batch->fileCount + 1, sizeof(file_contents));
+    batch->messages = calloc(batch->fileCount + 1, sizeof(diagnostics));
+    batch->finished = calloc(batch->fileCount + 1, sizeof(boolean));
+    if (sizes == NULL || batch->sources == NULL || batch->messages == NULL || batch->finished == NULL) {
+        printf("Failed to allocate memory for the assembler.\n");
+        free(sizes);
+        free(batch->sources);
+        free(batch->messages);
+        free(batch->finished);
+        return FALSE;
+    }
+    for (i = 0; i < batch->fileCount; i++)
+        sizes[i] = stat(batch->files[i], &fileStatus) == 0 ? (long)fileStatus.st_size : 0;
+    /*every source is read before the first is assembled, so the workers do not wait on the file system*/
+    prefetchSources(batch, sizes);
+    batch->nextToPrint = 0;
+    batch->failed = FALSE;
+    pthread_mutex_init(&batch->printLock, NULL);
+
+    if (!runJobs(batch->fileCount, sizes, batch->options.jobs, assembleJob, batch)) {
+        printf("Failed to start the workers - assembling one file at a time.\n");
+        runJobs(batch->fileCount, sizes, 1, assembleJob, batch);
+    }
+
+    pthread_mutex_destroy(&batch->printLock);
+    free(batch->sources);
+    free(batch->messages);
+    free(batch->finished);
+    free(sizes);
+    return TRUE;
+}
+
+/**
+ * Adds a source and the files it embeds to the dependency graph of a watch.
+ * @param watch The watch.
+ * @param source The index of the source.
+ * @param fileName The name of the source.
+ * @param includes The files it embeds, NULL ended - or NULL if they are not known.
+ */
+static void watchSource(file_watch *watch, int source, const char *fileName, char **includes) {
+    int i;
+    if (!watchFile(watch, fileName, source))
+        printf("Could not watch '%s' for changes.\n", fileName);
+    for (i = 0; includes != NULL && includes[i] != NULL; i++) {
+        if (!watchFile(watch, includes[i], source))
+            printf("Could not watch '%s', embedded by '%s', for changes.\n", includes[i], fileName);
+    }
+}
+
+/**
+ * Keeps assembling the files of a batch that was just assembled, each time they or the files they embed change.
+ * Only the files affected by a change are assembled again. Returns on Ctrl-C, or if the files cannot be watched.
+ * @param batch The batch, with the files every source embeds.
+ */
+static void watchBatch(assembly_batch *batch) {
+    file_watch watch;
+    char **files = batch->files, ***includes = batch->includes;
+    int fileCount = batch->fileCount, i, count;
+    boolean *changed = calloc(fileCount + 1, sizeof(boolean));
+    int *sources = malloc((fileCount + 1) * sizeof(int));
+    char **changedFiles = malloc((fileCount + 1) * sizeof(char *));
+    char ***changedIncludes = calloc(fileCount + 1, sizeof(char **));
+
+    if (changed == NULL || sources == NULL || changedFiles == NULL || changedIncludes == NULL || !openWatch(&watch, fileCount)) {
+        printf("Could not watch the files for changes.\n");
+    } else {
+        for (i = 0; i < fileCount; i++) {
+            if (isSourceFileName(files[i]))
+                watchSource(&watch, i, files[i], includes[i]);
         }
-        /* if no errors were found there creates the files*/
-        
-       head = labelTable.head;
-        while (head!=NULL) {
-            printf("%s\n", head->name);
-            head=head->next;
+        printf("Watching for changes - press Ctrl-C to stop.\n");
+        fflush(stdout);
+        while ((count = waitForChanges(&watch, changed)) > 0) {
+            /*the affected files form a batch of their own, in the order of the command line*/
+            for (count = 0, i = 0; i < fileCount; i++) {
+                if (changed[i]) {
+                    sources[count] = i;
+                    changedFiles[count++] = files[i];
+                    changed[i] = FALSE;
+                }
+            }
+            batch->files = changedFiles;
+            batch->fileCount = count;
+            batch->includes = changedIncludes;
+            if (!runBatch(batch))
+                break;
+            /*a source may embed other files now*/
+            for (i = 0; i < count; i++) {
+                forgetSource(&watch, sources[i]);
+                freeIncludes(includes[sources[i]]);
+                includes[sources[i]] = changedIncludes[i];
+                changedIncludes[i] = NULL;
+                watchSource(&watch, sources[i], files[sources[i]], includes[sources[i]]);
+            }
+            fflush(stdout);
         }
-      if (!ERROR_FOUND) {
-            writeFiles("output.am", codeImage, dataImage, codeImage64, dataImage64, codeImageBinary, dataImageBinary, labelTable, IC, DC);
+        printf("Stopped watching.\n");
+        closeWatch(&watch);
+    }
+    batch->files = files;
+    batch->fileCount = fileCount;
+    batch->includes = includes;
+    free(changed);
+    free(sources);
+    free(changedFiles);
+    free(changedIncludes);
+}
+
+/**
+ * Assembles the files of a command line.
+ * @param argc The number of command line arguments.
+ * @param argv The command line arguments.
+ * @param arg The warm_state of a daemon, whose contexts are used and kept - NULL to free the contexts at the end.
+ * @return The exit status.
+ */
+static int assembleCommandLine(int argc, char * argv[], void *arg) {
+    int i;
+    warm_state *warm = arg;
+    assembly_batch batch;
+    build_cache cache;
+    AssemblerContext **contexts;
+    boolean assembled;
+    if (argc <= 1) {
+        printError("Error - no files in command line.", 0);
+        return 1;
+    }
+    batch.files = malloc(argc * sizeof(char *));
+    if (batch.files == NULL || !parseOptions(argc, argv, &batch.options, batch.files, &batch.fileCount)) {
+        free(batch.files);
+        return 1;
+    }
+    if (batch.options.onePass && batch.options.optimize) {
+        printf("The optimizer needs the second pass - ignoring '--optimize' in one-pass mode.\n");
+        batch.options.optimize = FALSE;
+    }
+    if (batch.options.watch && warm != NULL) {
+        printf("A daemon answers every command line once - ignoring '--watch'.\n");
+        batch.options.watch = FALSE;
+    }
+#ifdef NO_TRACE
+    if (batch.options.traceLevel > TRACE_OFF)
+        printf("This build has no tracing - ignoring the trace options.\n");
+#endif
+    traceCategories = batch.options.traceCategories;
+    traceLevel = batch.options.traceLevel;
+
+    /*a daemon keeps the contexts of earlier command lines, adding more when a command line asks for more jobs*/
+    if (warm != NULL && warm->contextCount < batch.options.jobs) {
+        contexts = realloc(warm->contexts, batch.options.jobs * sizeof(AssemblerContext *));
+        if (contexts != NULL) {
+            for (i = warm->contextCount; i < batch.options.jobs; i++)
+                contexts[i] = NULL;
+            warm->contexts = contexts;
+            warm->contextCount = batch.options.jobs;
         }
-        /* Close the file*/
-        fclose(outputFile);
     }
-    return 0;
+    if (warm != NULL)
+        batch.contexts = warm->contextCount >= batch.options.jobs ? warm->contexts : NULL;
+    else
+        batch.contexts = calloc(batch.options.jobs, sizeof(AssemblerContext *));
+    batch.includes = batch.options.watch ? calloc(batch.fileCount + 1, sizeof(char **)) : NULL;
+    if (batch.contexts == NULL || (batch.options.watch && batch.includes == NULL)) {
+        printf("Failed to allocate memory for the assembler.\n");
+        if (warm == NULL)
+            free(batch.contexts);
+        free(batch.includes);
+        free(batch.files);
+        return 1;
     }
+    batch.cache = NULL;
+    if (batch.options.cacheDirectory != NULL && openCache(&cache, batch.options.cacheDirectory, batch.options.cacheMegabytes, &batch.options))
+        batch.cache = &cache;
+
+    assembled = runBatch(&batch);
+    if (assembled && batch.options.watch)
+        watchBatch(&batch);
+
+    if (batch.cache != NULL)
+        closeCache(batch.cache, batch.options.cacheStatistics);
+    if (warm == NULL) {
+        for (i = 0; i < batch.options.jobs; i++) {
+            if (batch.contexts[i] != NULL)
+                freeAssemblerContext(batch.contexts[i]);
+            free(batch.contexts[i]);
+        }
+        free(batch.contexts);
+    }
+    for (i = 0; batch.includes != NULL && i < batch.fileCount; i++)
+        freeIncludes(batch.includes[i]);
+    free(batch.includes);
+    free(batch.files);
+    return assembled && !batch.failed ? 0 : 1;
+}
+
+int main(int argc, char * argv[]) {
+    int i, status;
+    warm_state warm;
+
+    /*--lsp serves an editor over the standard input and output*/
+    if (argc == 2 && strcmp(argv[1], "--lsp") == 0)
+        return serveLanguageServer(stdin, stdout);
+
+    /*--daemon=SOCKET and --serve-stdin keep the assembler running, to assemble one command line after another*/
+    if (argc == 2 && (strncmp(argv[1], "--daemon=", 9) == 0 || strcmp(argv[1], "--serve-stdin") == 0)) {
+        warm.contexts = NULL;
+        warm.contextCount = 0;
+        if (argv[1][2] == 'd')
+            status = serveSocket(argv[1] + 9, assembleCommandLine, &warm);
+        else
+            status = serveRequestStream(stdin, stdout, assembleCommandLine, &warm);
+        for (i = 0; i < warm.contextCount; i++) {
+            if (warm.contexts[i] != NULL)
+                freeAssemblerContext(warm.contexts[i]);
+            free(warm.contexts[i]);
+        }
+        free(warm.contexts);
+        return status;
+    }
+    return assembleCommandLine(argc, argv, NULL);
+}
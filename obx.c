@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "obx.h"
+#include "utils.h"
+
+/* Stores an unsigned 32-bit little-endian field.*/
+static void putField(unsigned char *bytes, unsigned long offset, unsigned long value) {
+    bytes[offset] = (unsigned char)(value & 0xFF);
+    bytes[offset + 1] = (unsigned char)((value >> 8) & 0xFF);
+    bytes[offset + 2] = (unsigned char)((value >> 16) & 0xFF);
+    bytes[offset + 3] = (unsigned char)((value >> 24) & 0xFF);
+}
+
+/* Rounds a size up to a multiple of 4 bytes, so every section starts on a field boundary.*/
+static unsigned long alignField(unsigned long size) {
+    return (size + 3) & ~3UL;
+}
+
+/* Packs a word at its bit position in the words section.*/
+static void putWord(unsigned char *words, int wordBits, unsigned long index, unsigned long word) {
+    unsigned long bit = index * (unsigned long)wordBits;
+    unsigned char *p = words + bit / 8;
+    int shift = (int)(bit % 8), done = 0;
+
+    while (done < wordBits) {
+        *p++ |= (unsigned char)(((word >> done) << shift) & 0xFF);
+        done += 8 - shift;
+        shift = 0;
+    }
+}
+
+/* Lays out a module in the .obx format.*/
+unsigned char * formatObx(const obx_module *module, size_t *size) {
+    unsigned long wordCount = (unsigned long)(module->IC + module->DC);
+    unsigned long wordsOffset = OBX_HEADER_SIZE;
+    unsigned long symbolsOffset = wordsOffset + alignField((wordCount * module->wordBits + 7) / 8);
+    unsigned long relocationsOffset = symbolsOffset + (unsigned long)module->symbolCount * OBX_SYMBOL_SIZE;
+    unsigned long linesOffset = relocationsOffset + (unsigned long)module->relocationCount * OBX_RELOCATION_SIZE;
+    unsigned long stringsOffset = linesOffset + (unsigned long)module->lineCount * OBX_LINE_SIZE;
+    unsigned long stringsSize = 0, entry, i;
+    unsigned char *bytes;
+
+    for (i = 0; i < (unsigned long)module->symbolCount; i++)
+        stringsSize += strlen(module->symbols[i].name) + 1;
+    *size = stringsOffset + alignField(stringsSize);
+    bytes = calloc(1, *size);
+    if (bytes == NULL)
+        return NULL;
+
+    memcpy(bytes, OBX_MAGIC, 4);
+    putField(bytes, OBX_WORD_BITS, (unsigned long)module->wordBits);
+    putField(bytes, OBX_BASE_ADDRESS, (unsigned long)module->base);
+    putField(bytes, OBX_IC, (unsigned long)module->IC);
+    putField(bytes, OBX_DC, (unsigned long)module->DC);
+    putField(bytes, OBX_WORDS_OFFSET, wordsOffset);
+    putField(bytes, OBX_SYMBOLS_OFFSET, symbolsOffset);
+    putField(bytes, OBX_SYMBOL_COUNT, (unsigned long)module->symbolCount);
+    putField(bytes, OBX_RELOCATIONS_OFFSET, relocationsOffset);
+    putField(bytes, OBX_RELOCATION_COUNT, (unsigned long)module->relocationCount);
+    putField(bytes, OBX_LINES_OFFSET, linesOffset);
+    putField(bytes, OBX_LINE_COUNT, (unsigned long)module->lineCount);
+    putField(bytes, OBX_STRINGS_OFFSET, stringsOffset);
+    putField(bytes, OBX_STRINGS_SIZE, alignField(stringsSize));
+
+    /*the code image is followed directly by the data image*/
+    for (i = 0; i < (unsigned long)module->IC; i++)
+        putWord(bytes + wordsOffset, module->wordBits, i, module->code[i]);
+    for (i = 0; i < (unsigned long)module->DC; i++)
+        putWord(bytes + wordsOffset, module->wordBits, module->IC + i, module->data[i]);
+
+    stringsSize = 0;
+    for (i = 0; i < (unsigned long)module->symbolCount; i++) {
+        entry = symbolsOffset + i * OBX_SYMBOL_SIZE;
+        putField(bytes, entry, stringsSize);
+        putField(bytes, entry + 4, module->symbols[i].value);
+        putField(bytes, entry + 8, module->symbols[i].flags);
+        strcpy((char *)bytes + stringsOffset + stringsSize, module->symbols[i].name);
+        stringsSize += strlen(module->symbols[i].name) + 1;
+    }
+    for (i = 0; i < (unsigned long)module->relocationCount; i++) {
+        entry = relocationsOffset + i * OBX_RELOCATION_SIZE;
+        putField(bytes, entry, module->relocations[i].index);
+        putField(bytes, entry + 4, module->relocations[i].type);
+        putField(bytes, entry + 8, module->relocations[i].symbol);
+    }
+    for (i = 0; i < (unsigned long)module->lineCount; i++) {
+        entry = linesOffset + i * OBX_LINE_SIZE;
+        putField(bytes, entry, module->lines[i].index);
+        putField(bytes, entry + 4, module->lines[i].line);
+    }
+    return bytes;
+}
+
+/* Reads a 32-bit field of a .obx file.*/
+unsigned long obxField(const unsigned char *obx, unsigned long offset) {
+    return (unsigned long)obx[offset] | ((unsigned long)obx[offset + 1] << 8)
+        | ((unsigned long)obx[offset + 2] << 16) | ((unsigned long)obx[offset + 3] << 24);
+}
+
+/* Checks that a block of memory starts with a .obx header whose sections lie inside it.*/
+boolean isObx(const unsigned char *obx, size_t size) {
+    unsigned long wordBits, words;
+    if (size < OBX_HEADER_SIZE || memcmp(obx, OBX_MAGIC, 4) != 0)
+        return FALSE;
+    wordBits = obxField(obx, OBX_WORD_BITS);
+    if (wordBits == 0 || wordBits > 32)
+        return FALSE;
+    words = obxField(obx, OBX_IC) + obxField(obx, OBX_DC);
+    return obxField(obx, OBX_WORDS_OFFSET) + (words * wordBits + 7) / 8 <= size
+        && obxField(obx, OBX_SYMBOLS_OFFSET) + obxField(obx, OBX_SYMBOL_COUNT) * OBX_SYMBOL_SIZE <= size
+        && obxField(obx, OBX_RELOCATIONS_OFFSET) + obxField(obx, OBX_RELOCATION_COUNT) * OBX_RELOCATION_SIZE <= size
+        && obxField(obx, OBX_LINES_OFFSET) + obxField(obx, OBX_LINE_COUNT) * OBX_LINE_SIZE <= size
+        && obxField(obx, OBX_STRINGS_OFFSET) + obxField(obx, OBX_STRINGS_SIZE) <= size
+        && (obxField(obx, OBX_STRINGS_SIZE) == 0 || obx[obxField(obx, OBX_STRINGS_OFFSET) + obxField(obx, OBX_STRINGS_SIZE) - 1] == '\0');
+}
+
+/* Reads a word of a .obx file in place.*/
+unsigned long obxWord(const unsigned char *obx, unsigned long index) {
+    int wordBits = (int)obxField(obx, OBX_WORD_BITS), shift, done = 0;
+    unsigned long bit = index * (unsigned long)wordBits, word = 0;
+    const unsigned char *p = obx + obxField(obx, OBX_WORDS_OFFSET) + bit / 8;
+
+    shift = (int)(bit % 8);
+    while (done < wordBits) {
+        word |= (unsigned long)(*p++ >> shift) << done;
+        done += 8 - shift;
+        shift = 0;
+    }
+    return wordBits == 32 ? word & 0xFFFFFFFFUL : word & ((1UL << wordBits) - 1);
+}
+
+/* Returns the name of a symbol of a .obx file.*/
+const char * obxSymbolName(const unsigned char *obx, unsigned long symbol) {
+    unsigned long entry = obxField(obx, OBX_SYMBOLS_OFFSET) + symbol * OBX_SYMBOL_SIZE;
+    return (const char *)obx + obxField(obx, OBX_STRINGS_OFFSET) + obxField(obx, entry);
+}
@@ -0,0 +1,129 @@
+#ifndef OBX_H
+#define OBX_H
+
+#include <stddef.h>
+#include "utils.h"
+
+/*
+ * The binary object format (.obx). A file is a fixed header followed by its sections, and every number is
+ * an unsigned 32-bit little-endian field, so a loader can map the file and read it in place:
+ *
+ * header      - the OBX_ fields below, OBX_HEADER_SIZE bytes
+ * words       - the code image followed by the data image, word_bits bits per word packed back to back,
+ *               least significant bit first, padded to a multiple of 4 bytes
+ * symbols     - symbol_count entries of OBX_SYMBOL_SIZE bytes: name offset, value, flags
+ * relocations - relocation_count entries of OBX_RELOCATION_SIZE bytes: word index, type, symbol index
+ * lines       - line_count entries of OBX_LINE_SIZE bytes: word index, source line - an entry starts a run of
+ *               code words from the same source line
+ * strings     - the null-terminated symbol names
+ */
+
+#define OBX_MAGIC "OBX1"
+
+/*Byte offsets of the header fields*/
+#define OBX_WORD_BITS 4
+#define OBX_BASE_ADDRESS 8
+#define OBX_IC 12
+#define OBX_DC 16
+#define OBX_WORDS_OFFSET 20
+#define OBX_SYMBOLS_OFFSET 24
+#define OBX_SYMBOL_COUNT 28
+#define OBX_RELOCATIONS_OFFSET 32
+#define OBX_RELOCATION_COUNT 36
+#define OBX_LINES_OFFSET 40
+#define OBX_LINE_COUNT 44
+#define OBX_STRINGS_OFFSET 48
+#define OBX_STRINGS_SIZE 52
+#define OBX_HEADER_SIZE 56
+
+#define OBX_SYMBOL_SIZE 12
+#define OBX_RELOCATION_SIZE 12
+#define OBX_LINE_SIZE 8
+
+/*Symbol flags*/
+#define OBX_SYMBOL_ENTRY 0x1UL
+#define OBX_SYMBOL_EXTERNAL 0x2UL
+#define OBX_SYMBOL_DATA 0x4UL
+
+/*Relocation types*/
+#define OBX_RELOCATABLE 1UL /*the word holds an address inside the module*/
+#define OBX_EXTERNAL 2UL /*the word holds the address of an external symbol*/
+#define OBX_NO_SYMBOL 0xFFFFFFFFUL
+
+/*A symbol of a module*/
+typedef struct obx_symbol {
+    const char *name;
+    unsigned long value; /*the address of the symbol, 0 for an external symbol*/
+    unsigned long flags;
+} obx_symbol;
+
+/*A word of the module that holds an address*/
+typedef struct obx_relocation {
+    unsigned long index; /*position of the word in the module, code first*/
+    unsigned long type;
+    unsigned long symbol; /*index of the symbol in the symbol table, OBX_NO_SYMBOL if unknown*/
+} obx_relocation;
+
+/*The first code word of a run of words that come from the same source line*/
+typedef struct obx_line {
+    unsigned long index;
+    unsigned long line;
+} obx_line;
+
+/*Everything a .obx file holds, before it is laid out*/
+typedef struct obx_module {
+    int wordBits;
+    int base; /*address of the first code word*/
+    int IC;
+    int DC;
+    const word_t *code;
+    const word_t *data;
+    const obx_symbol *symbols;
+    int symbolCount;
+    const obx_relocation *relocations;
+    int relocationCount;
+    const obx_line *lines;
+    int lineCount;
+} obx_module;
+
+/**
+ * Lays out a module in the .obx format.
+ * @param module The module.
+ * @param size Output for the size of the file in bytes.
+ * @return The bytes of the file, to be freed by the caller, or NULL if memory ran out.
+ */
+unsigned char * formatObx(const obx_module *module, size_t *size);
+
+/**
+ * Checks that a block of memory starts with a .obx header whose sections lie inside it.
+ * @param obx The bytes of the file.
+ * @param size The size of the file in bytes.
+ * @return TRUE if the file can be read, FALSE otherwise.
+ */
+boolean isObx(const unsigned char *obx, size_t size);
+
+/**
+ * Reads a 32-bit field of a .obx file.
+ * @param obx The bytes of the file.
+ * @param offset The byte offset of the field.
+ * @return The value of the field.
+ */
+unsigned long obxField(const unsigned char *obx, unsigned long offset);
+
+/**
+ * Reads a word of a .obx file in place.
+ * @param obx The bytes of the file.
+ * @param index The position of the word, code first.
+ * @return The word.
+ */
+unsigned long obxWord(const unsigned char *obx, unsigned long index);
+
+/**
+ * Returns the name of a symbol of a .obx file.
+ * @param obx The bytes of the file.
+ * @param symbol The index of the symbol.
+ * @return The null-terminated name, inside the file.
+ */
+const char * obxSymbolName(const unsigned char *obx, unsigned long symbol);
+
+#endif /* OBX_H */
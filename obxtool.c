@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "obx.h"
+#include "utils.h"
+
+/*
+ * Converts objects between the text format (.ob) and the binary format (.obx):
+ *   obxtool to-ob  <file.obx> <file.ob>   - also writes the .ent, .ext and .rel files next to the .ob file
+ *   obxtool to-obx <file.ob> <file.obx>   - also reads the .ent, .ext and .rel files next to the .ob file
+ * The text format keeps no line table.
+ */
+
+/*The label files next to a text object*/
+typedef enum {
+    ENTRIES, /*.ent - the entry symbols*/
+    EXTERNALS, /*.ext - the words that use external symbols*/
+    RELOCATIONS /*.rel - the words that hold addresses inside the module*/
+} label_file;
+
+static const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* Replaces the extension of a file name.*/
+static void replaceExtension(char *target, const char *fileName, const char *extension) {
+    char *dot;
+    strncpy(target, fileName, FILENAME_MAX - 5);
+    target[FILENAME_MAX - 5] = '\0';
+    dot = strrchr(target, '.');
+    if (dot != NULL && strchr(dot, '/') == NULL)
+        *dot = '\0';
+    strcat(target, extension);
+}
+
+/* Writes a label file of a .obx file, if it has any lines.*/
+static boolean writeLabelFile(const unsigned char *obx, const char *fileName, label_file kind) {
+    unsigned long base = obxField(obx, OBX_BASE_ADDRESS), i, entry;
+    FILE *file = NULL;
+
+    if (kind != ENTRIES) {
+        for (i = 0; i < obxField(obx, OBX_RELOCATION_COUNT); i++) {
+            entry = obxField(obx, OBX_RELOCATIONS_OFFSET) + i * OBX_RELOCATION_SIZE;
+            if (obxField(obx, entry + 4) != (kind == EXTERNALS ? OBX_EXTERNAL : OBX_RELOCATABLE) || obxField(obx, entry + 8) == OBX_NO_SYMBOL)
+                continue;
+            if (file == NULL && (file = fopen(fileName, "w")) == NULL)
+                return FALSE;
+            fprintf(file, "%s %lu\n", obxSymbolName(obx, obxField(obx, entry + 8)), base + obxField(obx, entry));
+        }
+    } else {
+        for (i = 0; i < obxField(obx, OBX_SYMBOL_COUNT); i++) {
+            entry = obxField(obx, OBX_SYMBOLS_OFFSET) + i * OBX_SYMBOL_SIZE;
+            if (!(obxField(obx, entry + 8) & OBX_SYMBOL_ENTRY))
+                continue;
+            if (file == NULL && (file = fopen(fileName, "w")) == NULL)
+                return FALSE;
+            fprintf(file, "%s %lu\n", obxSymbolName(obx, i), obxField(obx, entry + 4));
+        }
+    }
+    return file == NULL || fclose(file) == 0;
+}
+
+/* Converts a .obx file to the text format.*/
+static boolean toText(const char *obxFileName, const char *obFileName) {
+    char labelFileName[FILENAME_MAX];
+    const unsigned char *obx;
+    unsigned long i, words, base, wordBits, word;
+    int digits, d, fd;
+    struct stat info;
+    FILE *file;
+    boolean ok;
+
+    fd = open(obxFileName, O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) < 0) {
+        printf("Error: could not open '%s'.\n", obxFileName);
+        return FALSE;
+    }
+    obx = info.st_size > 0 ? mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (obx == MAP_FAILED || !isObx(obx, (size_t)info.st_size)) {
+        printf("Error: '%s' is not a .obx file.\n", obxFileName);
+        if (obx != MAP_FAILED)
+            munmap((void *)obx, (size_t)info.st_size);
+        return FALSE;
+    }
+
+    file = fopen(obFileName, "w");
+    if (file == NULL) {
+        printf("Error: could not open '%s' for writing.\n", obFileName);
+        munmap((void *)obx, (size_t)info.st_size);
+        return FALSE;
+    }
+    base = obxField(obx, OBX_BASE_ADDRESS);
+    wordBits = obxField(obx, OBX_WORD_BITS);
+    words = obxField(obx, OBX_IC) + obxField(obx, OBX_DC);
+    digits = (int)((wordBits + 5) / 6);
+    fprintf(file, "%lu %lu\n", obxField(obx, OBX_IC), obxField(obx, OBX_DC));
+    for (i = 0; i < words; i++) {
+        word = obxWord(obx, i);
+        fprintf(file, "%lu:\t ", base + i);
+        for (d = digits - 1; d >= 0; d--)
+            fputc(base64Chars[(word >> (6 * d)) & 0x3F], file);
+        fputc('\n', file);
+    }
+    ok = fclose(file) == 0;
+
+    replaceExtension(labelFileName, obFileName, ".ent");
+    ok = ok && writeLabelFile(obx, labelFileName, ENTRIES);
+    replaceExtension(labelFileName, obFileName, ".ext");
+    ok = ok && writeLabelFile(obx, labelFileName, EXTERNALS);
+    replaceExtension(labelFileName, obFileName, ".rel");
+    ok = ok && writeLabelFile(obx, labelFileName, RELOCATIONS);
+    munmap((void *)obx, (size_t)info.st_size);
+    if (!ok)
+        printf("Error: could not write the files of '%s'.\n", obFileName);
+    return ok;
+}
+
+/* Decodes a word written in base64 digits.*/
+static boolean decodeWord(const char *digits, unsigned long *word) {
+    const char *digit;
+    *word = 0;
+    for (; *digits != '\0' && *digits != '\n' && *digits != '\r'; digits++) {
+        digit = strchr(base64Chars, *digits);
+        if (digit == NULL)
+            return FALSE;
+        *word = (*word << 6) | (unsigned long)(digit - base64Chars);
+    }
+    return TRUE;
+}
+
+/* Finds a symbol by name, adding it if it is new. Returns its index, or -1 if the table is full.*/
+static int findSymbol(obx_symbol symbols[], char names[][MAX_LABEL_LENGTH + 1], int *count, int capacity, const char *name) {
+    int i;
+    for (i = 0; i < *count; i++) {
+        if (strcmp(symbols[i].name, name) == 0)
+            return i;
+    }
+    if (*count == capacity)
+        return -1;
+    strcpy(names[*count], name);
+    symbols[*count].name = names[*count];
+    symbols[*count].value = 0;
+    symbols[*count].flags = 0;
+    return (*count)++;
+}
+
+/* Reads a label file next to a .ob file into the symbol and relocation tables, if it exists. Every line names a word of
+   the module, so the tables hold as many entries as the module has words.*/
+static boolean readLabelFile(const char *fileName, label_file kind, int base, int IC, int DC, const word_t words[], obx_symbol symbols[],
+                             char names[][MAX_LABEL_LENGTH + 1], int *symbolCount, obx_relocation relocations[], int *relocationCount) {
+    char line[MAX_LINE_LENGTH + 1], name[MAX_LINE_LENGTH + 1];
+    long address;
+    int symbol;
+    FILE *file = fopen(fileName, "r");
+
+    if (file == NULL)
+        return TRUE; /*no labels of this kind*/
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "%80s %ld", name, &address) != 2 || strlen(name) > MAX_LABEL_LENGTH || address < base || address >= (long)base + IC + DC
+            || (symbol = findSymbol(symbols, names, symbolCount, IC + DC, name)) < 0) {
+            printf("Error: invalid line in '%s'.\n", fileName);
+            fclose(file);
+            return FALSE;
+        }
+        if (kind != ENTRIES) {
+            if (kind == EXTERNALS) {
+                symbols[symbol].flags |= OBX_SYMBOL_EXTERNAL;
+            } else if (address - base < IC) {
+                /*the word itself holds the address of the label*/
+                symbols[symbol].value = ISA_FIELD_OF(OPERAND, words[address - base]);
+                symbols[symbol].flags |= symbols[symbol].value >= (unsigned long)(base + IC) ? OBX_SYMBOL_DATA : 0;
+            }
+            if (*relocationCount < IC + DC) {
+                relocations[*relocationCount].index = (unsigned long)(address - base);
+                relocations[*relocationCount].type = kind == EXTERNALS ? OBX_EXTERNAL : OBX_RELOCATABLE;
+                relocations[(*relocationCount)++].symbol = (unsigned long)symbol;
+            }
+        } else {
+            symbols[symbol].flags |= OBX_SYMBOL_ENTRY | (address >= base + IC ? OBX_SYMBOL_DATA : 0);
+            symbols[symbol].value = (unsigned long)address;
+        }
+    }
+    fclose(file);
+    return TRUE;
+}
+
+/* Converts a text object to the .obx format.*/
+static boolean toBinary(const char *obFileName, const char *obxFileName) {
+    word_t *words;
+    obx_symbol *symbols;
+    char (*names)[MAX_LABEL_LENGTH + 1];
+    obx_relocation *relocations;
+    char line[MAX_LINE_LENGTH + 1], digits[MAX_LINE_LENGTH + 1], labelFileName[FILENAME_MAX];
+    obx_module module;
+    unsigned char *bytes;
+    unsigned long word;
+    long address;
+    int IC, DC, count = 0, symbolCount = 0, relocationCount = 0, base = DEFAULT_BASE_ADDRESS;
+    size_t size;
+    boolean ok = FALSE;
+    FILE *file = fopen(obFileName, "r");
+
+    if (file == NULL) {
+        printf("Error: could not open '%s'.\n", obFileName);
+        return FALSE;
+    }
+    if (fgets(line, sizeof(line), file) == NULL || sscanf(line, "%d %d", &IC, &DC) != 2 || IC < 0 || DC < 0 || (long)IC + DC > LARGEST_MEMORY_SPACE) {
+        printf("Error: '%s' has no valid header.\n", obFileName);
+        fclose(file);
+        return FALSE;
+    }
+    /*the tables are sized by the header - every symbol and relocation names a word of the module*/
+    words = malloc((IC + DC + 1) * sizeof(word_t));
+    symbols = malloc((IC + DC + 1) * sizeof(obx_symbol));
+    names = malloc((IC + DC + 1) * sizeof(*names));
+    relocations = malloc((IC + DC + 1) * sizeof(obx_relocation));
+    if (words == NULL || symbols == NULL || names == NULL || relocations == NULL) {
+        printf("Error: failed to allocate memory for '%s'.\n", obFileName);
+        fclose(file);
+        file = NULL;
+    }
+    while (file != NULL && fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "%ld: %80s", &address, digits) != 2 || count == IC + DC || !decodeWord(digits, &word)) {
+            printf("Error: invalid line in '%s'.\n", obFileName);
+            fclose(file);
+            file = NULL;
+            break;
+        }
+        if (count == 0)
+            base = (int)address;
+        words[count++] = (word_t)(word & WORD_MASK);
+    }
+    if (file != NULL) {
+        fclose(file);
+        ok = count == IC + DC;
+        if (!ok)
+            printf("Error: '%s' holds fewer words than its header says.\n", obFileName);
+    }
+
+    replaceExtension(labelFileName, obFileName, ".ent");
+    ok = ok && readLabelFile(labelFileName, ENTRIES, base, IC, DC, words, symbols, names, &symbolCount, relocations, &relocationCount);
+    replaceExtension(labelFileName, obFileName, ".ext");
+    ok = ok && readLabelFile(labelFileName, EXTERNALS, base, IC, DC, words, symbols, names, &symbolCount, relocations, &relocationCount);
+    replaceExtension(labelFileName, obFileName, ".rel");
+    ok = ok && readLabelFile(labelFileName, RELOCATIONS, base, IC, DC, words, symbols, names, &symbolCount, relocations, &relocationCount);
+    if (!ok) {
+        free(words); free(symbols); free(names); free(relocations);
+        return FALSE;
+    }
+
+    module.wordBits = ISA_WORD_BITS;
+    module.base = base;
+    module.IC = IC;
+    module.DC = DC;
+    module.code = words;
+    module.data = words + IC;
+    module.symbols = symbols;
+    module.symbolCount = symbolCount;
+    module.relocations = relocations;
+    module.relocationCount = relocationCount;
+    module.lines = NULL;
+    module.lineCount = 0;
+    bytes = formatObx(&module, &size);
+    free(words); free(symbols); free(names); free(relocations);
+    if (bytes == NULL) {
+        printf("Error: failed to allocate memory for '%s'.\n", obxFileName);
+        return FALSE;
+    }
+    file = fopen(obxFileName, "wb");
+    ok = file != NULL && fwrite(bytes, 1, size, file) == size;
+    if (file != NULL)
+        ok = (fclose(file) == 0) && ok;
+    if (!ok)
+        printf("Error: could not write '%s'.\n", obxFileName);
+    free(bytes);
+    return ok;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc == 4 && strcmp(argv[1], "to-ob") == 0)
+        return toText(argv[2], argv[3]) ? 0 : 1;
+    if (argc == 4 && strcmp(argv[1], "to-obx") == 0)
+        return toBinary(argv[2], argv[3]) ? 0 : 1;
+    printf("Usage: %s to-ob <file.obx> <file.ob>\n       %s to-obx <file.ob> <file.obx>\n", argv[0], argv[0]);
+    return 1;
+}
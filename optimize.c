@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "instructions.h"
+#include "labels.h"
+#include "optimize.h"
+#include "utils.h"
+
+#define MOV_OPCODE ISA_OP_MOV
+#define JMP_OPCODE ISA_OP_JMP
+#define JSR_OPCODE ISA_OP_JSR
+#define RTS_OPCODE ISA_OP_RTS
+
+#define OPCODE_OF(word) ISA_FIELD_OF(OPCODE, word)
+#define SRC_MODE_OF(word) ISA_FIELD_OF(SRC_MODE, word)
+#define DST_MODE_OF(word) ISA_FIELD_OF(DST_MODE, word)
+#define OPCODE_FIELD ISA_FIELD(OPCODE, ISA_OPCODE_MASK)
+
+/*An instruction of the code image - the position of its first word and how many words it takes*/
+typedef struct instruction {
+    int start;
+    int length;
+} instruction;
+
+/*Finds the code address of the label a word refers to, or -1 if it is not a code label of this file.*/
+static int refTarget(machine_image *image, label_table *labelTable, const int refAt[], int index) {
+    label *lbl;
+    if (refAt[index] < 0)
+        return -1;
+    lbl = lookupLabel(image->refs[refAt[index]].name, labelTable);
+    if (lbl == NULL || !lbl->isDefined || lbl->isData || lbl->isExternal)
+        return -1;
+    return lbl->address;
+}
+
+/*Peephole optimizer over the instruction stream of the code image.*/
+int optimizeImage(machine_image *image, label_table *labelTable, int *IC) {
+    instruction *program;
+    int *refAt, *newIndex;
+    boolean *isDeleted, *isTarget;
+    int count = 0, i, j, saved, target;
+    word_t word;
+    label *lbl;
+
+    program = malloc((*IC + 1) * sizeof(instruction));
+    refAt = malloc((*IC + 1) * sizeof(int));
+    newIndex = malloc((*IC + 1) * sizeof(int));
+    isDeleted = calloc(*IC + 1, sizeof(boolean));
+    isTarget = calloc(*IC + 1, sizeof(boolean));
+    if (program == NULL || refAt == NULL || newIndex == NULL || isDeleted == NULL || isTarget == NULL) {
+        printMessage("Failed to allocate memory for the optimizer - the code is left as is.\n");
+        free(program); free(refAt); free(newIndex); free(isDeleted); free(isTarget);
+        return 0;
+    }
+
+    /*index the symbol references and the words that code labels point to*/
+    for (i = 0; i <= *IC; i++)
+        refAt[i] = -1;
+    for (i = 0; i < image->refCount; i++)
+        refAt[image->refs[i].index] = i;
+    for (lbl = labelTable->head; lbl != NULL; lbl = lbl->next) {
+        if (lbl->isDefined && !lbl->isData)
+            isTarget[lbl->address] = TRUE;
+    }
+
+    /*split the code image into instructions - the first pass gives every operand a word of its own*/
+    for (i = 0; i < *IC; i += program[count++].length) {
+        program[count].start = i;
+        program[count].length = 1 + opcodeTable[OPCODE_OF(image->code[i])].operandCount;
+    }
+
+    for (i = 0; i < count; i++) {
+        int start = program[i].start;
+        word = image->code[start];
+
+        if (program[i].length == 3 && SRC_MODE_OF(word) == REGISTER_ADDRESSING && DST_MODE_OF(word) == REGISTER_ADDRESSING) {
+            if (OPCODE_OF(word) == MOV_OPCODE && ISA_FIELD_OF(SRC_REG, image->code[start + 1]) == ISA_FIELD_OF(DST_REG, image->code[start + 2])) {
+                /*a register moved to itself*/
+                isDeleted[start] = isDeleted[start + 1] = isDeleted[start + 2] = TRUE;
+            } else {
+                /*both registers share one word*/
+                image->code[start + 1] |= image->code[start + 2];
+                isDeleted[start + 2] = TRUE;
+            }
+        } else if (OPCODE_OF(word) == JSR_OPCODE && i + 1 < count && OPCODE_OF(image->code[program[i + 1].start]) == RTS_OPCODE
+                   && !isTarget[program[i + 1].start]) {
+            /*a call that returns right away is a jump*/
+            image->code[start] = (word & ~OPCODE_FIELD) | opcodeTable[JMP_OPCODE].firstWord;
+            isDeleted[program[i + 1].start] = TRUE;
+            i++;
+        }
+    }
+
+    /*a jump over nothing but removed words is removed as well*/
+    for (i = 0; i < count; i++) {
+        int start = program[i].start;
+        if (OPCODE_OF(image->code[start]) != JMP_OPCODE || isDeleted[start] || DST_MODE_OF(image->code[start]) != DIRECT_ADDRESSING)
+            continue;
+        target = refTarget(image, labelTable, refAt, start + 1);
+        if (target < start + 2)
+            continue;
+        for (j = start + 2; j < target && isDeleted[j]; j++)
+            ;
+        if (j == target)
+            isDeleted[start] = isDeleted[start + 1] = TRUE;
+    }
+
+    /*compact the code image - a removed word maps to the next word that is kept*/
+    for (i = 0, j = 0; i <= *IC; i++) {
+        newIndex[i] = j;
+        if (i < *IC && !isDeleted[i])
+            image->code[j++] = image->code[i];
+    }
+    saved = *IC - j;
+    *IC = j;
+
+    for (lbl = labelTable->head; lbl != NULL; lbl = lbl->next) {
+        if (lbl->isDefined && !lbl->isData)
+            lbl->address = newIndex[lbl->address];
+    }
+    for (i = 0, j = 0; i < image->refCount; i++) {
+        if (isDeleted[image->refs[i].index])
+            continue;
+        image->refs[j] = image->refs[i];
+        image->refs[j++].index = newIndex[image->refs[i].index];
+    }
+    image->refCount = j;
+    /*an instruction whose first word is removed is removed as a whole*/
+    for (i = 0, j = 0; i < image->codeLineCount; i++) {
+        if (isDeleted[image->codeLines[i].index])
+            continue;
+        image->codeLines[j].lineNumber = image->codeLines[i].lineNumber;
+        image->codeLines[j++].index = newIndex[image->codeLines[i].index];
+    }
+    image->codeLineCount = j;
+
+    free(program); free(refAt); free(newIndex); free(isDeleted); free(isTarget);
+    return saved;
+}
@@ -0,0 +1,21 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "utils.h"
+
+/**
+ * Peephole optimizer over the instruction stream of the code image. Runs after the first pass,
+ * while words that refer to labels are still listed in the symbol side table, and shrinks the code by:
+ * - packing the two operand words of a register to register instruction into one shared register word,
+ * - removing a "jmp" to the address right after it,
+ * - removing a "mov" of a register to itself,
+ * - collapsing "jsr X" immediately followed by "rts" into "jmp X".
+ * Code labels and symbol references are moved to the new addresses of their words.
+ * @param image The code and data images.
+ * @param labelTable The table of labels.
+ * @param IC The instruction counter, updated to the new size of the code image.
+ * @return The number of words saved.
+ */
+int optimizeImage(machine_image *image, label_table *labelTable, int *IC);
+
+#endif /* OPTIMIZE_H */
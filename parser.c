@@ -1,12 +1,16 @@
+#define _DEFAULT_SOURCE /*vsnprintf*/
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <pthread.h>
 
 #include "parser.h"
 #include "directives.h"
 #include "instructions.h"
 #include "labels.h"
+#include "image.h"
 #include "utils.h"
 
 /**
@@ -56,8 +60,8 @@ static boolean isNumber(Token token, int lineNumber) {
         num = num * 10 + (token.value.string[i] - '0');
         i++;
 
-        if (num > 2047) {
-            printError("Number exceeds 12 bits.", lineNumber);
+        if (num > ISA_WORD_MAX) {
+            printError("Number does not fit in a word.", lineNumber);
             return FALSE;
         }
     }
@@ -87,7 +91,8 @@ Token getNextToken(char **line, int lineNumber) {
     int length;
     char *colonIndex = NULL;
     char *quotationIndex = NULL;
-    
+    const opcode_descriptor *opcode;
+
     *line = skipSpaces(*line);
 
     /*check if the line ended*/
@@ -106,11 +111,12 @@ Token getNextToken(char **line, int lineNumber) {
     /* Copy the token value */
     length = 0;
     while (!isspace(**line) && **line != '\0' && **line != ',') {
-        token.value.string[length] = **line;
+        if (length < MAX_LABEL_LENGTH) /*a longer token is rejected below - only its length is counted*/
+            token.value.string[length] = **line;
         length++;
         (*line)++;
     }
-    token.value.string[length] = '\0';
+    token.value.string[MIN(length, MAX_LABEL_LENGTH)] = '\0';
 
     if((token.value.string[0] == '+' || token.value.string[0] == '-' || isdigit(token.value.string[0])) && isNumber(token, lineNumber)) {
         token.type = NUMBER;
@@ -147,16 +153,9 @@ Token getNextToken(char **line, int lineNumber) {
 
 
     /* Determine the token type based on the token value */
-    if (strcmp(token.value.string, "mov") == 0 || strcmp(token.value.string, "cmp") == 0 ||
-        strcmp(token.value.string, "add") == 0 || strcmp(token.value.string, "sub") == 0 ||
-        strcmp(token.value.string, "lea") == 0) {
-        token.type = TWO_OPERANDS;
-    } else if (strcmp(token.value.string, "not") == 0 || strcmp(token.value.string, "clr") == 0 || strcmp(token.value.string, "inc") == 0 ||
-               strcmp(token.value.string, "dec") == 0 || strcmp(token.value.string, "jmp") == 0 || strcmp(token.value.string, "bne") == 0 || strcmp(token.value.string, "red") == 0 ||
-               strcmp(token.value.string, "prn") == 0 || strcmp(token.value.string, "jsr") == 0) {
-        token.type = ONE_OPERAND;
-    } else if (strcmp(token.value.string, "rts") == 0 || strcmp(token.value.string, "stop") == 0) {
-        token.type = NO_OPERANDS;
+    opcode = findOpcode(token.value.string);
+    if (opcode != NULL) {
+        token.type = opcode->operandCount == 2 ? TWO_OPERANDS : opcode->operandCount == 1 ? ONE_OPERAND : NO_OPERANDS;
     } else if (token.value.string[0] == '.') {
         token.type = DIRECTIVE;
     } else if (isalpha(token.value.string[0])) {
@@ -167,14 +166,16 @@ Token getNextToken(char **line, int lineNumber) {
         token.type = INVALID;
     }
 
-    if(token.type == INVALID)  exit(1);
+    /*the caller reports an invalid token, in the words of what it expected*/
     return token;
 }
 
 /*Parses a given line of assembly code and populates code and data images.*/
-boolean parseLine(char * line, machine_word codeImage[], machine_word dataImage[], label_table *labelTable, int* IC, int* DC, int lineNumber) {
+boolean parseLine(char * line, machine_image *image, label_table *labelTable, int* IC, int* DC, int lineNumber) {
     boolean NO_ERROR_FLAG = TRUE;
-    Token token;
+    boolean isData, hasLabel = FALSE, isPooled = FALSE;
+    int startDC, address;
+    Token token, labelToken;
     char *line_index = line;
 
     if(isLineTooLong(line, lineNumber)) {
@@ -187,10 +188,30 @@ boolean parseLine(char * line, machine_word codeImage[], machine_word dataImage[
 
     /*check the first token - the rest of the tokens in the line will be checked in the appropriate functions*/
     if(token.type == LABEL_DECLARATION) {
-        NO_ERROR_FLAG = parseLabel(token, &line_index, codeImage, dataImage, labelTable, FALSE, FALSE, FALSE, IC, DC, lineNumber);
-        /*isData, isEntry and isExtern are all FALSE at this point because the label is at the beginning of the line*/
+        hasLabel = TRUE;
+        labelToken = token;
         token = getNextToken(&line_index, lineNumber);
     }
+    if (token.type == DIRECTIVE && strcmp(token.value.string, ".pool") == 0) {
+        /*the constant of the data directive that follows goes to the constant pool*/
+        isPooled = TRUE;
+        token = getNextToken(&line_index, lineNumber);
+        if (token.type != DIRECTIVE || !isDataDirective(token.value.string)) {
+            printError("'.pool' must be followed by a data directive.", lineNumber);
+            return FALSE;
+        }
+    }
+    if (hasLabel) {
+        if (token.type == DIRECTIVE && (strcmp(token.value.string, ".entry") == 0 || strcmp(token.value.string, ".extern") == 0)) {
+            printWarning("A label before '.entry' or '.extern' is ignored.", lineNumber);
+        } else {
+            /*labels of data directives point into the data image, all others into the code image*/
+            isData = token.type == DIRECTIVE && isDataDirective(token.value.string);
+            NO_ERROR_FLAG = parseLabel(labelToken, &line_index, image, labelTable, isData, FALSE, FALSE, IC, DC, lineNumber);
+            if (NO_ERROR_FLAG && image->onePass)
+                NO_ERROR_FLAG = backpatchLabel(image, lookupLabel(labelToken.value.string, labelTable));
+        }
+    }
     if(NO_ERROR_FLAG == FALSE) {
         return NO_ERROR_FLAG;
     }
@@ -198,16 +219,24 @@ boolean parseLine(char * line, machine_word codeImage[], machine_word dataImage[
     	case END:
     		break;
         case DIRECTIVE:
-            NO_ERROR_FLAG = parseDirective(token, &line_index, codeImage, dataImage, labelTable, FALSE, FALSE, FALSE, IC, DC, lineNumber);
+            startDC = *DC;
+            NO_ERROR_FLAG = parseDirective(token, &line_index, line, image, labelTable, FALSE, FALSE, FALSE, IC, DC, lineNumber);
+            /*-p pools only unlabeled constants - a labeled block may be written through its label, so it is shared only when marked*/
+            if (NO_ERROR_FLAG && (isPooled || (image->poolAll && !hasLabel)) && isDataDirective(token.value.string)) {
+                /*an identical constant is stored once - the label points to the pooled copy*/
+                address = poolData(image, startDC, DC, lineNumber);
+                if (hasLabel && address != startDC)
+                    lookupLabel(labelToken.value.string, labelTable)->address = address;
+            }
             break;
         case ONE_OPERAND:
-            NO_ERROR_FLAG = parseOneOperand(&line_index, token, codeImage, IC, DC, lineNumber);
+            NO_ERROR_FLAG = parseOneOperand(&line_index, token, image, labelTable, IC, DC, lineNumber);
             break;
         case TWO_OPERANDS:
-            NO_ERROR_FLAG = parseTwoOperands(&line_index, token, codeImage, IC, DC, lineNumber);
+            NO_ERROR_FLAG = parseTwoOperands(&line_index, token, image, labelTable, IC, DC, lineNumber);
             break;
         case NO_OPERANDS:
-            NO_ERROR_FLAG = parseNoOperands(&line_index, token, codeImage, IC, DC, lineNumber);
+            NO_ERROR_FLAG = parseNoOperands(&line_index, token, image, labelTable, IC, DC, lineNumber);
             break;
         default:
             printError("Line cannot start with the character given.", lineNumber);
@@ -217,12 +246,86 @@ boolean parseLine(char * line, machine_word codeImage[], machine_word dataImage[
     return NO_ERROR_FLAG;
 }
 
+/*Longest diagnostic message*/
+#define MAX_MESSAGE_LENGTH 512
+
+/*Where the diagnostics of each thread are collected - no value while they are printed*/
+static pthread_key_t diagnosticKey;
+static pthread_once_t diagnosticKeyOnce = PTHREAD_ONCE_INIT;
+
+/* Creates the key of the per-thread sinks.*/
+static void createDiagnosticKey(void) {
+    pthread_key_create(&diagnosticKey, NULL);
+}
+
+/* Returns the sink of the calling thread, or NULL.*/
+static diagnostics *currentSink(void) {
+    pthread_once(&diagnosticKeyOnce, createDiagnosticKey);
+    return pthread_getspecific(diagnosticKey);
+}
+
+/*Collects the diagnostics of the calling thread in memory instead of printing them.*/
+diagnostics *setDiagnosticSink(diagnostics *sink) {
+    diagnostics *previous = currentSink();
+    pthread_setspecific(diagnosticKey, sink);
+    return previous;
+}
+
+/* Prints the messages collected on another thread, or adds them to the collected diagnostics, a line at a time.*/
+void relayDiagnostics(const diagnostics *messages) {
+    const char *line = messages->text, *newLine;
+    while (line != NULL && *line != '\0') {
+        newLine = strchr(line, '\n');
+        printMessage("%.*s", (int)(newLine != NULL ? newLine + 1 - line : (long)strlen(line)), line);
+        line = newLine != NULL ? newLine + 1 : NULL;
+    }
+}
+
+/*Prints a diagnostic message, or adds it to the collected diagnostics.*/
+void printMessage(const char *format, ...) {
+    char message[MAX_MESSAGE_LENGTH];
+    size_t length;
+    va_list args;
+    diagnostics *diagnosticSink = currentSink();
+
+    va_start(args, format);
+    if (diagnosticSink == NULL) {
+        vprintf(format, args);
+        va_end(args);
+        return;
+    }
+    /*a longer message, e.g. one with a long file name, is cut and still ends its line*/
+    if (vsnprintf(message, MAX_MESSAGE_LENGTH, format, args) >= MAX_MESSAGE_LENGTH)
+        message[MAX_MESSAGE_LENGTH - 2] = '\n';
+    va_end(args);
+
+    length = strlen(message);
+    if (diagnosticSink->length + length + 1 > diagnosticSink->capacity) {
+        size_t newCapacity = MAX(diagnosticSink->capacity * 2, diagnosticSink->length + length + 1);
+        char *newText = realloc(diagnosticSink->text, newCapacity);
+        if (newText == NULL)
+            return; /*the message is lost, the result of the assembly still says whether it failed*/
+        diagnosticSink->text = newText;
+        diagnosticSink->capacity = newCapacity;
+    }
+    memcpy(diagnosticSink->text + diagnosticSink->length, message, length + 1);
+    diagnosticSink->length += length;
+}
+
 /*Prints error messages with line number.*/
 void printError (char* error, int lineNumber) {
-    printf("\033[1;31mERROR\033[0m - \033[1;34mline #%d\033[0m:  %s.\n", lineNumber, error);
+    diagnostics *diagnosticSink = currentSink();
+    if (diagnosticSink == NULL || diagnosticSink->colors)
+        printMessage("\033[1;31mERROR\033[0m - \033[1;34mline #%d\033[0m:  %s.\n", lineNumber, error);
+    else
+        printMessage("ERROR - line #%d: %s.\n", lineNumber, error);
 }
 
 /*Prints warning messages with line numbers*/
 void printWarning (char* warning, int lineNumber) {
-    printf("\033[1;33mWARNING\033[0m - \033[1;32mline #%d\033[0m: %s.\n", lineNumber, warning);
+    diagnostics *diagnosticSink = currentSink();
+    if (diagnosticSink == NULL || diagnosticSink->colors)
+        printMessage("\033[1;33mWARNING\033[0m - \033[1;32mline #%d\033[0m: %s.\n", lineNumber, warning);
+    else
+        printMessage("WARNING - line #%d: %s.\n", lineNumber, warning);
 }
@@ -9,15 +9,14 @@
 /**
  * Parses a line of assembly code and processes its tokens.
  * @param line The line of assembly code to be parsed.
- * @param codeImage An array to store the machine word for instructions.
- * @param dataImage An array to store the machine word for data.
+ * @param image The code and data images.
  * @param labelTable The table of labels.
  * @param IC The instruction counter.
  * @param DC The data counter.
  * @param lineNumber The current line number being processed.
  * @return TRUE if parsing was successful, FALSE otherwise.
  */
-boolean parseLine(char *line, machine_word codeImage[], machine_word dataImage[], label_table *labelTable, int *IC, int *DC, int lineNumber);
+boolean parseLine(char *line, machine_image *image, label_table *labelTable, int *IC, int *DC, int lineNumber);
 
 /**
  * Tokenizes the input line to extract the next token.
@@ -49,4 +48,24 @@ void printError (char* error, int lineNumber);
  */
 void printWarning (char* warning, int lineNumber);
 
+/**
+ * Prints a diagnostic message that is not tied to a line, or adds it to the collected diagnostics.
+ * @param format The printf format of the message, followed by its arguments.
+ */
+void printMessage(const char *format, ...);
+
+/**
+ * Collects the diagnostics of the calling thread in memory instead of printing them, until the sink is set back to NULL.
+ * Every thread has its own sink, so threads assembling different files do not mix their messages.
+ * @param sink The diagnostics to add the messages to, or NULL to print them.
+ * @return The previous sink.
+ */
+diagnostics *setDiagnosticSink(diagnostics *sink);
+
+/**
+ * Prints messages that another thread collected, or adds them to the diagnostics of the calling thread, in order.
+ * @param messages The collected messages.
+ */
+void relayDiagnostics(const diagnostics *messages);
+
 #endif /*PARSER_H*/
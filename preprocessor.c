@@ -1,26 +1,59 @@
 #include "preprocessor.h"
+#include "parser.h"
+#include "isa.h"
+
+/* Copies the next line of a buffer, the way fgets reads a file: up to size-1 characters, through the newline.*/
+size_t readSourceLine(const char **source, const char *end, char *line, size_t size) {
+    size_t length = 0;
+    while (*source < end && length < size - 1) {
+        line[length++] = **source;
+        (*source)++;
+        if (line[length - 1] == '\n')
+            break;
+    }
+    line[length] = '\0';
+    return length;
+}
 
-void processSourceFile(char *sourceFileName, char *outputFileName, MacroTable *macroTable) {
+/* Appends a string to the expanded source, growing it as needed.*/
+static int appendExpanded(char **expanded, size_t *length, size_t *capacity, const char *text) {
+    size_t textLength = strlen(text);
+    if (*length + textLength + 1 > *capacity) {
+        size_t newCapacity = (*capacity * 2 > *length + textLength + 1) ? *capacity * 2 : *length + textLength + 1;
+        char *newExpanded = realloc(*expanded, newCapacity);
+        if (newExpanded == NULL) {
+            printMessage("Failed to allocate memory for the expanded source.\n");
+            return 0;
+        }
+        *expanded = newExpanded;
+        *capacity = newCapacity;
+    }
+    memcpy(*expanded + *length, text, textLength + 1);
+    *length += textLength;
+    return 1;
+}
+
+/* Expands the macros of a source held in memory.*/
+char *expandMacros(const char *source, size_t sourceLength, MacroTable *macroTable, size_t *expandedLength) {
 	
 	char line[MAX_LINE_LEN];
 	int isInsideMacro = 0;
-	char macroName[MAX_LINE_LEN];
+	char macroName[MAX_LINE_LEN] = "";
     char *macroContent = NULL;
     size_t macroContentSize=0;
     int index;
     char trimmedLine[MAX_LINE_LEN];
     int macroIndex;
     char *commentStart;
+    const char *end = source + sourceLength;
+    char *expanded = NULL;
+    size_t capacity = 0;
+
+    *expandedLength = 0;
+    if (!appendExpanded(&expanded, expandedLength, &capacity, ""))
+        return NULL;
     
-    FILE *sourceFile = fopen(sourceFileName, "r");
-    FILE *outputFile = fopen(outputFileName, "w");
-    
-    if(sourceFile == NULL || outputFile == NULL) {
-    	printf("Error opening files.\n");
-    	return;
-    }
-    
-    while (sourceFile != NULL && fgets(line, sizeof(line), sourceFile)) {
+    while (readSourceLine(&source, end, line, sizeof(line)) > 0) {
     	/*Skip empty or comment line*/
     	commentStart = strchr(line, ';');
     	if (commentStart) {
@@ -44,9 +77,13 @@ void processSourceFile(char *sourceFileName, char *outputFileName, MacroTable *m
             isInsideMacro = 0;
             index = findMacro(macroTable, macroName);
             if (index == -1) {
-                addMacro(macroTable, macroName, macroContent);
+                if (!addMacro(macroTable, macroName, macroContent ? macroContent : "")) {
+                    free(macroContent);
+                    free(expanded);
+                    return NULL;
+                }
             } else {
-                printf("Macro '%s' is already defined.\n", macroName);
+                printMessage("Macro '%s' is already defined.\n", macroName);
             }
             
             free(macroContent); /*Free the macro content memory*/
@@ -58,47 +95,53 @@ void processSourceFile(char *sourceFileName, char *outputFileName, MacroTable *m
         /*Reading inside macro*/
         if (isInsideMacro) {
             size_t lineLength = strlen(line);
-            macroContent = realloc(macroContent, macroContentSize + lineLength + 1);
-            if (!macroContent) {
-                printf("Failed to allocate memory for macro content.\n");
-                exit(1);
+            char *newContent = realloc(macroContent, macroContentSize + lineLength + 1);
+            if (!newContent) {
+                printMessage("Failed to allocate memory for macro content.\n");
+                free(macroContent);
+                free(expanded);
+                return NULL;
             }
+            macroContent = newContent;
             strcpy(macroContent + macroContentSize, line);
             macroContentSize += lineLength;
             continue;
         }
         
         /*Check if the line is a call to a macro*/
-        sscanf(line, "%s", trimmedLine); /*This will remove leading and trailing spaces*/
+        if (sscanf(line, "%80s", trimmedLine) != 1) /*This will remove leading and trailing spaces*/
+            trimmedLine[0] = '\0'; /*a line of spaces only*/
         macroIndex = findMacro(macroTable, trimmedLine);
         if (macroIndex != -1) {
-            if (macroIndex >= 0 && macroIndex < macroTable->count) {
-                fputs(macroTable->macros[macroIndex].content, outputFile);
-            } else {
-                printf("Invalid macro index: %d\n", macroIndex);
+            if (!appendExpanded(&expanded, expandedLength, &capacity, macroTable->macros[macroIndex].content)) {
+                free(macroContent);
+                return NULL;
             }
             continue;
         }
         
-        /*Write the line to the output file*/
-        fputs(line, outputFile);
+        /*Copy the line to the expanded source*/
+        if (!appendExpanded(&expanded, expandedLength, &capacity, line)) {
+            free(macroContent);
+            return NULL;
+        }
     }
 
-    fclose(sourceFile);
-    fclose(outputFile);
+    free(macroContent);
+    return expanded;
 }
 
-
  /* Initialize a macro table with initial capacity */
-void initializeMacroTable(MacroTable *table) {
+int initializeMacroTable(MacroTable *table) {
     table->count = 0;
     table->capacity = 10;
     table->macros = (Macro *)malloc(table->capacity * sizeof(Macro));  /* Allocate memory for the macros array*/
     if (table->macros == NULL) {
-        printf("Failed to allocate memory for macro table.\n");
-        free(table);
-        exit(1);
+        printMessage("Failed to allocate memory for macro table.\n");
+        table->capacity = 0;
+        return 0;
     }
+    return 1;
 }
 
 /* Trim leading and trailing whitespace characters from a string */
@@ -151,67 +194,58 @@ int findMacro(const MacroTable *table, const char *name) {
 }
 /* this method ensure that the name of the macro is not as same as name of an instruction or prompt*/
 int isValidMacroName(const char *name) {
-    int i;
-
-    /* List of reserved names */
-    const char *reserved[] = {
-        ".", "lea", "sub", "add", "cmp", "mov", "not", "clr", "inc", "dec",
-        "jmp", "bne", "red", "prn", "jsr", "stop", "rts"
-    };
-
-    /* Calculate the number of reserved words */
-    int numReserved = sizeof(reserved) / sizeof(reserved[0]);
 
     /* Check if name starts with a dot */
     if (name[0] == '.') {
         return 0;  /* Not valid */
     }
 
-    /* Check if name is in the list of reserved words */
-    for (i = 0; i < numReserved; i++) {
-        if (strcmp(name, reserved[i]) == 0) {
-            return 0;  /* Not valid */
-        }
+    /* Check if name is a reserved word of the machine */
+    if (isaLookup(name, NULL) != ISA_NOT_RESERVED) {
+        return 0;  /* Not valid */
     }
 
     return 1;  /* Valid */
 }
 
 /* This method is add the macro to the macro table if the macro is valid*/
-void addMacro(MacroTable *table,  char *name,  char *content) {
+int addMacro(MacroTable *table,  char *name,  char *content) {
     int index = findMacro(table, name);
-    Macro *newMacros = realloc(table->macros, table->capacity * sizeof(Macro));
-    if (newMacros == NULL) {
-    	printf("Failed to reallocate memory for macro table.\n");
-        free(newMacros);
-        exit(1);
-    }
-    
-    table->macros = newMacros;
     if (index == -1) {
         if (table->count == table->capacity) {
             /* Double the capacity of the macro table*/
+            Macro *newMacros = realloc(table->macros, table->capacity * 2 * sizeof(Macro));
+            if (newMacros == NULL) {
+                printMessage("Failed to reallocate memory for macro table.\n");
+                return 0;
+            }
+            table->macros = newMacros;
             table->capacity *= 2;
         }
         strcpy(table->macros[table->count].name, name);
-        /*strcpy(table->macros[table->count].content, content);*/
-        
-   
-
-     table->macros[table->count].content = malloc(strlen(content) + 1);
+        table->macros[table->count].content = malloc(strlen(content) + 1);
         if (table->macros[table->count].content == NULL) {
-            printf("Failed to allocate memory for macro content.\n");
-            exit(1);
+            printMessage("Failed to allocate memory for macro content.\n");
+            return 0;
         }
         strcpy(table->macros[table->count].content, content);
         table->count++;
     } else {
-        printf("Macro '%s' is already defined.\n", name);
+        printMessage("Macro '%s' is already defined.\n", name);
     }
+    return 1;
 }
 
 void freeMacroTable(MacroTable *table) {
+    clearMacroTable(table);
     free(table->macros);
+    table->macros = NULL;
 }
 
-
+/* Empties a macro table, keeping its array for the next source */
+void clearMacroTable(MacroTable *table) {
+    int i;
+    for (i = 0; i < table->count; i++)
+        free(table->macros[i].content);
+    table->count = 0;
+}
@@ -1,3 +1,6 @@
+#ifndef PREPROCESSOR_H
+#define PREPROCESSOR_H
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,8 +39,9 @@ typedef struct MacroTable {
  * @brief Initializes a macro table with default values.
  *
  * @param table Pointer to the MacroTable to be initialized.
+ * @return Returns 1 on success, or 0 if memory ran out.
  */
-void initializeMacroTable(MacroTable *);
+int initializeMacroTable(MacroTable *);
 
 /**
  * @brief Finds a macro by its name in the given macro table.
@@ -54,8 +58,9 @@ int findMacro(const MacroTable *, const char *);
  * @param table   Pointer to the MacroTable.
  * @param name    Name of the new macro.
  * @param content Content of the new macro.
+ * @return Returns 1 unless memory ran out - a macro that is already defined is reported and skipped.
  */
-void addMacro(MacroTable *,  char *,  char *);
+int addMacro(MacroTable *,  char *,  char *);
 
 /**
  * @brief Frees the memory allocated for the macro table and its content.
@@ -65,13 +70,33 @@ void addMacro(MacroTable *,  char *,  char *);
 void freeMacroTable(MacroTable *);
 
 /**
- * @brief Processes a source file for macro replacements using the given macro table.
+ * @brief Frees the content of the macros of a table, keeping its array to be used again.
+ *
+ * @param table Pointer to the MacroTable to be emptied.
+ */
+void clearMacroTable(MacroTable *);
+
+/**
+ * @brief Expands the macros of a source held in memory, without any file I/O.
  *
- * @param inputFilename  Name of the source file to be processed.
- * @param outputFilename Name of the output file where the processed content will be written.
+ * @param source         The source.
+ * @param sourceLength   The length of the source.
  * @param table          Pointer to the MacroTable containing the macros.
+ * @param expandedLength Output for the length of the expanded source.
+ * @return The expanded source, null-terminated, to be freed by the caller, or NULL on error.
  */
-void processSourceFile( char *,  char *,  MacroTable *);
+char *expandMacros(const char *, size_t, MacroTable *, size_t *);
+
+/**
+ * @brief Copies the next line of a buffer, the way fgets reads a line of a file.
+ *
+ * @param source Pointer to the position in the buffer, moved past the line.
+ * @param end    The end of the buffer.
+ * @param line   Output for the line.
+ * @param size   The size of line - at most size-1 characters are copied.
+ * @return The number of characters copied, 0 at the end of the buffer.
+ */
+size_t readSourceLine(const char **, const char *, char *, size_t);
 
 /**
  * @brief Checks if the given string is a valid macro name.
@@ -87,3 +112,5 @@ int isValidMacroName(const char *);
  * @param str Pointer to the string to be trimmed.
  */
 void trimWhitespace(char *);
+
+#endif /* PREPROCESSOR_H */
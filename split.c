@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "split.h"
+#include "parser.h"
+#include "labels.h"
+#include "image.h"
+#include "preprocessor.h"
+#include "threadPool.h"
+#include "utils.h"
+
+/*A piece of the source and what its first pass made of it*/
+typedef struct source_piece {
+    const char *start;
+    const char *end;
+    int firstLine; /*line number of the first line of the piece*/
+    machine_image *image;
+    label_table labelTable;
+    int IC;
+    int DC;
+    boolean errorFound;
+    diagnostics messages;
+} source_piece;
+
+/* Checks if a source marks any constant with .pool - pooled constants are shared across the whole source.*/
+static boolean usesPool(const char *source, size_t length) {
+    const char *p = source, *end = source + length;
+    while ((p = memchr(p, '.', end - p)) != NULL) {
+        if ((size_t)(end - p) >= 5 && memcmp(p, ".pool", 5) == 0)
+            return TRUE;
+        p++;
+    }
+    return FALSE;
+}
+
+/* Splits a source into pieces of about the same size at line boundaries, numbering the lines the way readSourceLine reads them.*/
+static int splitSource(const char *source, size_t length, source_piece pieces[], int count) {
+    const char *p = source, *end = source + length, *newLine;
+    int line = 1, piece = 0;
+
+    pieces[0].start = source;
+    pieces[0].firstLine = 1;
+    while (p < end) {
+        /*a line ends after its new line, or after MAX_LINE_LENGTH characters - the rest is read as the next line*/
+        newLine = memchr(p, '\n', MIN((size_t)(end - p), MAX_LINE_LENGTH));
+        p = newLine != NULL ? newLine + 1 : p + MIN((size_t)(end - p), MAX_LINE_LENGTH);
+        line++;
+        if (piece < count - 1 && p < end && (size_t)(p - source) >= length / count * (piece + 1)) {
+            pieces[piece++].end = p;
+            pieces[piece].start = p;
+            pieces[piece].firstLine = line;
+        }
+    }
+    pieces[piece].end = end;
+    return piece + 1;
+}
+
+/* Runs the first pass over a piece of the source - a job of the thread pool.*/
+static void passPiece(int job, int worker, void *arg) {
+    source_piece *piece = (source_piece *)arg + job;
+    char line[MAX_LINE_LENGTH+1]; /*adding one extra space for NULL ending*/
+    const char *source = piece->start;
+    int lineNumber = piece->firstLine;
+    diagnostics *previousSink = setDiagnosticSink(&piece->messages);
+
+    while (readSourceLine(&source, piece->end, line, sizeof(line)) > 0) {
+        piece->errorFound |= (parseLine(line, piece->image, &piece->labelTable, &piece->IC, &piece->DC, lineNumber) == FALSE);
+        lineNumber++;
+    }
+    setDiagnosticSink(previousSink);
+}
+
+/* Hashes a label name into a slot of the merged label index.*/
+static unsigned long labelSlot(const char *name, unsigned long mask) {
+    unsigned long hash = 5381;
+    while (*name != '\0')
+        hash = hash * 33 + (unsigned char)*name++;
+    return hash & mask;
+}
+
+/* Reverses a label table in place - a table lists its labels from the last one added.*/
+static void reverseLabels(label_table *labelTable) {
+    label *current = labelTable->head, *next, *reversed = NULL;
+    while (current != NULL) {
+        next = current->next;
+        current->next = reversed;
+        reversed = current;
+        current = next;
+    }
+    labelTable->head = reversed;
+}
+
+/* Merges the label tables of the pieces into one, in the order the labels first appear in the source. Returns FALSE
+ * if a label is declared in two pieces in ways createLabel rejects, or memory ran out.*/
+static boolean mergeLabels(source_piece pieces[], int count, const int codeBases[], const int dataBases[], label_table *merged) {
+    label **index, *lbl, *found;
+    unsigned long size = 16, slot;
+    int i, labelCount = 0;
+    boolean clash = FALSE;
+
+    for (i = 0; i < count; i++) {
+        for (lbl = pieces[i].labelTable.head; lbl != NULL; lbl = lbl->next)
+            labelCount++;
+    }
+    while (size < 2 * (unsigned long)labelCount)
+        size *= 2;
+    if ((index = calloc(size, sizeof(label *))) == NULL)
+        return FALSE;
+
+    for (i = 0; i < count && !clash; i++) {
+        reverseLabels(&pieces[i].labelTable);
+        while ((lbl = pieces[i].labelTable.head) != NULL && !clash) {
+            pieces[i].labelTable.head = lbl->next;
+            if (lbl->isDefined)
+                lbl->address += lbl->isData ? dataBases[i] : codeBases[i];
+            for (slot = labelSlot(lbl->name, size - 1); (found = index[slot]) != NULL && strcmp(found->name, lbl->name) != 0; slot = (slot + 1) & (size - 1))
+                ;
+            if (found == NULL) {
+                index[slot] = lbl;
+                lbl->next = NULL;
+                insertLabel(lbl, merged, 0);
+                continue;
+            }
+            /*the checks of createLabel, between the declarations of the label before this piece and in it*/
+            clash = (lbl->isDefined && found->isDefined) || ((lbl->isDefined || lbl->isEntry) && found->isExternal)
+                || (lbl->isExternal && (found->isDefined || found->isEntry));
+            found->isExternal |= lbl->isExternal;
+            found->isEntry |= lbl->isEntry;
+            if (lbl->isDefined) {
+                found->isDefined = TRUE;
+                found->isData = lbl->isData;
+                found->address = lbl->address;
+            }
+            free(lbl);
+        }
+    }
+    free(index);
+    return !clash;
+}
+
+/* Moves the words, label uses, runs and embedded files of the pieces into one image.*/
+static boolean mergeImages(source_piece pieces[], int count, const int codeBases[], const int dataBases[], machine_image *image) {
+    const machine_image *piece;
+    int i, j, IC = codeBases[count - 1] + pieces[count - 1].IC, stored = 0;
+
+    /*the words of runs are not stored in data*/
+    for (i = 0; i < count; i++)
+        stored += pieces[i].DC - pieces[i].image->fillWords;
+    if (!reserveCode(image, 0, 0, IC, pieces[0].firstLine) || !reserveData(image, IC, 0, stored, pieces[0].firstLine))
+        return FALSE;
+    for (i = 0; i < count; i++) {
+        piece = pieces[i].image;
+        memcpy(image->code + codeBases[i], piece->code, pieces[i].IC * sizeof(word_t));
+        /*the runs of the pieces before this one are already added, so the stored words follow theirs*/
+        memcpy(image->data + dataBases[i] - image->fillWords, piece->data, (pieces[i].DC - piece->fillWords) * sizeof(word_t));
+        for (j = 0; j < piece->codeLineCount; j++) {
+            if (!addCodeLine(image, piece->codeLines[j].index + codeBases[i], piece->codeLines[j].lineNumber))
+                return FALSE;
+        }
+        for (j = 0; j < piece->refCount; j++) {
+            if (!addSymbolRef(image, piece->refs[j].index + codeBases[i], piece->refs[j].name, piece->refs[j].lineNumber))
+                return FALSE;
+        }
+        /*a run that continues the last run of the piece before with the same value is joined to it, as in one pass*/
+        for (j = 0; j < piece->fillCount; j++) {
+            if (!addFill(image, piece->fills[j].start + dataBases[i], piece->fills[j].length, piece->fills[j].value, pieces[i].firstLine))
+                return FALSE;
+        }
+        for (j = 0; j < piece->includeCount; j++) {
+            if (!addInclude(image, piece->includes[j], pieces[i].firstLine))
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Runs the first pass over a large source in pieces at once.*/
+boolean splitFirstPass(machine_image *image, label_table *labelTable, int *IC, int *DC, const char *source, size_t length, int pieces) {
+    source_piece *piece;
+    diagnostics *sink;
+    long *costs;
+    int *codeBases, *dataBases, count, i;
+    boolean merged = FALSE;
+    label_table labels;
+
+    pieces = (int)MIN((size_t)pieces, length / MIN_SPLIT_BYTES);
+    /*one-pass mode and pooled constants depend on everything read before a line*/
+    if (pieces < 2 || image->onePass || image->poolAll || usesPool(source, length))
+        return FALSE;
+
+    piece = calloc(pieces, sizeof(source_piece));
+    costs = malloc(pieces * sizeof(long));
+    codeBases = malloc(pieces * sizeof(int));
+    dataBases = malloc(pieces * sizeof(int));
+    if (piece == NULL || costs == NULL || codeBases == NULL || dataBases == NULL) {
+        free(piece);
+        free(costs);
+        free(codeBases);
+        free(dataBases);
+        return FALSE;
+    }
+    count = splitSource(source, length, piece, pieces);
+    /*the messages of the pieces are printed later, so they keep their colours unless the caller collects them without*/
+    sink = setDiagnosticSink(NULL);
+    setDiagnosticSink(sink);
+    for (i = 0; i < count; i++) {
+        piece[i].messages.colors = sink == NULL || sink->colors;
+        piece[i].image = malloc(sizeof(machine_image));
+        if (piece[i].image == NULL)
+            break;
+        initImage(piece[i].image);
+        piece[i].image->memorySize = image->memorySize;
+        piece[i].image->baseAddress = image->baseAddress;
+        piece[i].image->noFiles = image->noFiles;
+        costs[i] = (long)(piece[i].end - piece[i].start);
+    }
+
+    if (i == count && runJobs(count, costs, count, passPiece, piece)) {
+        /*the first word of every piece follows the words of the pieces before it*/
+        merged = TRUE;
+        for (i = 0; i < count; i++) {
+            codeBases[i] = i == 0 ? 0 : codeBases[i - 1] + piece[i - 1].IC;
+            dataBases[i] = i == 0 ? 0 : dataBases[i - 1] + piece[i - 1].DC;
+            merged = merged && !piece[i].errorFound;
+        }
+        merged = merged && codeBases[count - 1] + piece[count - 1].IC + dataBases[count - 1] + piece[count - 1].DC <= image->memorySize;
+    }
+    labels.head = NULL;
+    labels.spare = NULL;
+    merged = merged && mergeLabels(piece, count, codeBases, dataBases, &labels);
+    merged = merged && mergeImages(piece, count, codeBases, dataBases, image);
+
+    if (merged) {
+        for (i = 0; i < count; i++)
+            relayDiagnostics(&piece[i].messages);
+        labelTable->head = labels.head;
+        image->pieces = count;
+        *IC = codeBases[count - 1] + piece[count - 1].IC;
+        *DC = dataBases[count - 1] + piece[count - 1].DC;
+    } else {
+        /*the image is left empty for the pass that reads the source line by line*/
+        freeLabelTable(&labels);
+        clearImage(image);
+    }
+    for (i = 0; i < count; i++) {
+        if (piece[i].image != NULL)
+            freeImage(piece[i].image);
+        free(piece[i].image);
+        freeLabelTable(&piece[i].labelTable);
+        free(piece[i].messages.text);
+    }
+    free(piece);
+    free(costs);
+    free(codeBases);
+    free(dataBases);
+    return merged;
+}
@@ -0,0 +1,29 @@
+#ifndef SPLIT_H
+#define SPLIT_H
+
+#include "utils.h"
+
+/*Smallest piece of a source worth a thread of its own, in bytes - smaller sources are read in one piece*/
+#define MIN_SPLIT_BYTES (32 * 1024)
+
+/**
+ * Runs the first pass over a large expanded source in pieces at once. The source is split at line boundaries into
+ * pieces of about the same size, and every piece is parsed on its own thread into its own images and label table,
+ * with IC and DC starting at zero. The pieces are then put together: the words of each piece are moved by the sizes
+ * of the pieces before it, and the label tables are merged in the order the labels first appear.
+ * The result is the same as that of reading the source line by line. When it might not be - the source has errors,
+ * a label is declared in two pieces in ways that clash, the pieces do not fit in the memory together, or constants
+ * are pooled across the source - nothing is changed and the caller reads the source line by line instead, so the
+ * messages are those of the sequential pass.
+ * @param image The code and data images, empty.
+ * @param labelTable The table of labels, empty.
+ * @param IC Output for the instruction counter.
+ * @param DC Output for the data counter.
+ * @param source The expanded source.
+ * @param length The length of the source.
+ * @param pieces The most pieces to split the source into.
+ * @return TRUE if the first pass is done and found no errors, FALSE if the caller must run it line by line.
+ */
+boolean splitFirstPass(machine_image *image, label_table *labelTable, int *IC, int *DC, const char *source, size_t length, int pieces);
+
+#endif /* SPLIT_H */
@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "threadPool.h"
+#include "utils.h"
+
+/*The jobs dealt to one worker, largest first - the owner takes from the head, thieves from the tail*/
+typedef struct job_queue {
+    int *jobs;
+    int head;
+    int tail;
+    pthread_mutex_t lock;
+} job_queue;
+
+/*Everything the workers share*/
+typedef struct thread_pool {
+    job_queue *queues;
+    int workerCount;
+    job_function run;
+    void *arg;
+} thread_pool;
+
+/*What a worker thread starts with*/
+typedef struct worker_start {
+    thread_pool *pool;
+    int worker;
+} worker_start;
+
+/*A job and its cost, for sorting*/
+typedef struct costed_job {
+    long cost;
+    int job;
+} costed_job;
+
+/* Orders jobs by decreasing cost, and jobs of equal cost by their order.*/
+static int compareCosts(const void *a, const void *b) {
+    const costed_job *x = a, *y = b;
+    if (x->cost != y->cost)
+        return x->cost > y->cost ? -1 : 1;
+    return x->job - y->job;
+}
+
+/* Takes the next job of a queue, from its head for the owner or its tail for a thief. Returns -1 if the queue is empty.*/
+static int takeJob(job_queue *queue, boolean steal) {
+    int job = -1;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head < queue->tail)
+        job = steal ? queue->jobs[--queue->tail] : queue->jobs[queue->head++];
+    pthread_mutex_unlock(&queue->lock);
+    return job;
+}
+
+/* Runs jobs until every queue is empty - no job is added once the workers start.*/
+static void *workerLoop(void *start) {
+    thread_pool *pool = ((worker_start *)start)->pool;
+    int worker = ((worker_start *)start)->worker;
+    int job, victim;
+
+    for (;;) {
+        job = takeJob(&pool->queues[worker], FALSE);
+        /*out of jobs - look for one on the other workers, starting with the next*/
+        for (victim = 1; job < 0 && victim < pool->workerCount; victim++)
+            job = takeJob(&pool->queues[(worker + victim) % pool->workerCount], TRUE);
+        if (job < 0)
+            return NULL;
+        pool->run(job, worker, pool->arg);
+    }
+}
+
+/* Runs jobs on a pool of worker threads, largest cost first.*/
+boolean runJobs(int jobCount, const long costs[], int workerCount, job_function run, void *arg) {
+    thread_pool pool;
+    costed_job *order;
+    worker_start *starts;
+    pthread_t *threads;
+    boolean *started;
+    int *slots;
+    int i, j, next;
+
+    if (workerCount > jobCount)
+        workerCount = jobCount;
+    if (workerCount <= 1) {
+        for (i = 0; i < jobCount; i++)
+            run(i, 0, arg);
+        return TRUE;
+    }
+
+    order = malloc(jobCount * sizeof(costed_job));
+    slots = malloc(jobCount * sizeof(int));
+    pool.queues = malloc(workerCount * sizeof(job_queue));
+    starts = malloc(workerCount * sizeof(worker_start));
+    threads = malloc(workerCount * sizeof(pthread_t));
+    started = calloc(workerCount, sizeof(boolean));
+    if (order == NULL || slots == NULL || pool.queues == NULL || starts == NULL || threads == NULL || started == NULL) {
+        free(order);
+        free(slots);
+        free(pool.queues);
+        free(starts);
+        free(threads);
+        free(started);
+        return FALSE;
+    }
+    pool.workerCount = workerCount;
+    pool.run = run;
+    pool.arg = arg;
+
+    for (i = 0; i < jobCount; i++) {
+        order[i].cost = costs[i];
+        order[i].job = i;
+    }
+    qsort(order, jobCount, sizeof(costed_job), compareCosts);
+    /*deal the jobs round robin, so every worker starts with one of the largest - each queue is a slice of slots*/
+    for (i = 0, next = 0; i < workerCount; i++) {
+        pool.queues[i].jobs = slots + next;
+        pool.queues[i].head = 0;
+        pool.queues[i].tail = 0;
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+        for (j = i; j < jobCount; j += workerCount)
+            pool.queues[i].jobs[pool.queues[i].tail++] = order[j].job;
+        next += pool.queues[i].tail;
+    }
+    free(order);
+
+    /*a thread that does not start leaves its jobs to be stolen*/
+    for (i = 0; i < workerCount; i++) {
+        starts[i].pool = &pool;
+        starts[i].worker = i;
+        if (i > 0)
+            started[i] = pthread_create(&threads[i], NULL, workerLoop, &starts[i]) == 0;
+    }
+    workerLoop(&starts[0]);
+    for (i = 1; i < workerCount; i++) {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+    }
+
+    for (i = 0; i < workerCount; i++)
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    free(slots);
+    free(pool.queues);
+    free(starts);
+    free(threads);
+    free(started);
+    return TRUE;
+}
@@ -0,0 +1,22 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "utils.h"
+
+/*Runs one job - worker is the index of the thread running it, from 0 to the number of workers - 1*/
+typedef void (*job_function)(int job, int worker, void *arg);
+
+/**
+ * Runs jobs on a pool of worker threads. The jobs are dealt to the workers largest cost first, each worker runs
+ * its own jobs from the largest down, and a worker that runs out steals the smallest job left on another worker.
+ * The calling thread is worker 0. With a single worker the jobs run on the calling thread in their own order.
+ * @param jobCount The number of jobs.
+ * @param costs The expected cost of every job, e.g. the size of its file.
+ * @param workerCount The number of workers.
+ * @param run The function that runs a job.
+ * @param arg Passed to every call of run.
+ * @return TRUE if every job ran, FALSE if the pool could not be set up.
+ */
+boolean runJobs(int jobCount, const long costs[], int workerCount, job_function run, void *arg);
+
+#endif /* THREAD_POOL_H */
@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "trace.h"
+
+unsigned int traceCategories = 0;
+int traceLevel = TRACE_OFF;
+
+/*Category names for --trace*/
+static const struct {
+    const char *name;
+    unsigned int category;
+} traceNames[] = {
+    {"encode", TRACE_ENCODE},
+    {"labels", TRACE_LABELS},
+    {"all", TRACE_ALL}
+};
+
+/* Prints a trace message to stderr if its category and level are selected.*/
+void traceMessage(unsigned int category, int level, const char *format, ...) {
+    va_list args;
+    if (!TRACE_ENABLED(category, level))
+        return;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+/* Reads a comma separated list of trace category names.*/
+int parseTraceCategories(const char *names, unsigned int *categories) {
+    const char *name = names, *end;
+    size_t length, i;
+
+    *categories = 0;
+    while (*name != '\0') {
+        end = strchr(name, ',');
+        length = end ? (size_t)(end - name) : strlen(name);
+        for (i = 0; i < sizeof(traceNames) / sizeof(traceNames[0]); i++) {
+            if (strlen(traceNames[i].name) == length && strncmp(traceNames[i].name, name, length) == 0)
+                break;
+        }
+        if (i == sizeof(traceNames) / sizeof(traceNames[0]))
+            return 0;
+        *categories |= traceNames[i].category;
+        name += length + (end != NULL);
+    }
+    return *categories != 0;
+}
@@ -0,0 +1,47 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*Trace categories - one bit per module*/
+#define TRACE_ENCODE 0x1U /*every word written to the object file*/
+#define TRACE_LABELS 0x2U /*the label table of every file*/
+#define TRACE_ALL (TRACE_ENCODE | TRACE_LABELS)
+
+/*Trace levels - a message is shown when the selected level is at least its own*/
+#define TRACE_OFF 0
+#define TRACE_INFO 1
+#define TRACE_DEBUG 2
+
+/*The categories and level selected on the command line*/
+extern unsigned int traceCategories;
+extern int traceLevel;
+
+/*
+ * TRACE((category, level, format, ...)) prints a message to stderr when its category and level are selected.
+ * The arguments take a second pair of parentheses since C89 has no variadic macros.
+ * Building with -DNO_TRACE removes every trace statement, arguments included.
+ */
+#ifdef NO_TRACE
+#define TRACE_ENABLED(category, level) 0
+#define TRACE(args) ((void)0)
+#else
+#define TRACE_ENABLED(category, level) ((traceCategories & (category)) != 0 && traceLevel >= (level))
+#define TRACE(args) traceMessage args
+#endif
+
+/**
+ * Prints a trace message to stderr if its category and level are selected.
+ * @param category The category of the message.
+ * @param level The level of the message.
+ * @param format The printf format of the message, followed by its arguments.
+ */
+void traceMessage(unsigned int category, int level, const char *format, ...);
+
+/**
+ * Reads a comma separated list of trace category names, e.g. "encode,labels" or "all".
+ * @param names The list of names.
+ * @param categories Output for the categories.
+ * @return 1 if every name is known, 0 otherwise.
+ */
+int parseTraceCategories(const char *names, unsigned int *categories);
+
+#endif /* TRACE_H */
@@ -1,16 +1,19 @@
 #ifndef UTILS_H
 #define UTILS_H
 
-#define baseAddress 100
-#define MAX_MEMORY_SPACE 1024
+#include <stddef.h>
+#include "isa.h" /*generated from the ISA description file*/
+
+#define DEFAULT_MEMORY_SPACE ISA_MEMORY_SPACE /*words of memory, unless --memory says otherwise*/
+#define DEFAULT_BASE_ADDRESS ISA_BASE_ADDRESS /*address of the first code word, unless --base says otherwise*/
+#define LARGEST_MEMORY_SPACE (1L << 24) /*bound of --memory and --base, so addresses and counters stay within an int*/
 #define MAX_LINE_LENGTH 80
 #define MAX_FILE_NAME_LENGTH 76
-#define MAX_FILE_SIZE 100
 #define MAX_LABEL_LENGTH 31
-#define NUM_OF_DIRECTIVES 4
-#define NUM_OF_INSTRUCTIONS 16
+#define NUM_OF_DIRECTIVES ISA_NUM_DIRECTIVES
+#define NUM_OF_INSTRUCTIONS ISA_NUM_OPCODES
 #define MAX(A, B)((A > B) ? A : B)
-#define BASE_ADD 100
+#define MIN(A, B)((A < B) ? A : B)
 
 /*Boolean variable*/
 typedef enum {
@@ -26,6 +29,9 @@ typedef struct Label {
     boolean isExternal;
     boolean isEntry; 
     boolean isData;
+    boolean isDefined; /*FALSE while the label was only named by .entry or .extern, or used before its declaration*/
+    int chain; /*one-pass mode: 1 + index of the last code word waiting for this label, 0 if none*/
+    int chainLine; /*one-pass mode: source line of the first word waiting for this label*/
     struct Label * next;
 } label;
 
@@ -33,6 +39,7 @@ typedef struct Label {
 /*Label table*/
 typedef struct {
     label * head;
+    label * spare; /*labels of earlier sources, used again before any is allocated*/
 } label_table;
 
 /*Lexmemes*/
@@ -60,52 +67,138 @@ typedef struct {
     } value;
 } Token;
 
-/*Define the machine word that always comes first*/
-typedef struct first_word {
-    unsigned int ARE: 2;
-    unsigned int dst_op_addr: 3;
-    unsigned int src_op_addr: 3;
-    unsigned int op_code: 4;
-} first_word;
-
-/*Define a machine word with direct or immediate addressing*/
-typedef struct immdt_drct_word {
-    unsigned int ARE: 2;
-    unsigned int operand: 10;
-} immdt_drct_word;
-
-/*Define a machine word that is just data*/
-typedef struct data_word {
-    unsigned int data: 12;
-    int line_number;
-} data_word;
-
-/*Define a machine word that holds the value and addresses of between one to two registers*/
-typedef struct rgstr_word {
-    unsigned int ARE: 2;
-    unsigned int dst_op_addr: 5;
-    unsigned int src_op_addr: 5;
-} rgstr_word;
-
-/*Variable to indicate machine word type*/
-typedef enum {
-    FIRST_WORD_TYPE,
-    IMMDT_DRCT_WORD_TYPE,
-    DATA_WORD_TYPE,
-    RGSTR_WORD_TYPE
-} WordType;
-
-/*Define a general machine word - one that is either an instruction, data word, register word or immediate or direct addressing word*/
-typedef struct machine_word {
-    label label; /*Here we will place the labels in the first pass*/
-    boolean isLabel;
-    WordType wordType; /*This indicates the type of word */
-    union word {
-        first_word first_word;
-        immdt_drct_word immdt_drct_word;
-        data_word data_word;
-        rgstr_word register_word;
-    } word;
-} machine_word;
+/*A machine word - as wide as the ISA description says*/
+typedef ISA_WORD_TYPE word_t;
+
+/*Field layout of a machine word - see the ISA description file*/
+#define WORD_MASK ISA_WORD_MASK
+#define ARE_MASK ISA_ARE_MASK
+/*first word: | ARE | destination mode | opcode | source mode |*/
+#define DST_MODE_SHIFT ISA_DST_MODE_SHIFT
+#define OPCODE_SHIFT ISA_OPCODE_SHIFT
+#define SRC_MODE_SHIFT ISA_SRC_MODE_SHIFT
+/*immediate or direct operand word: | ARE | operand |*/
+#define OPERAND_SHIFT ISA_OPERAND_SHIFT
+#define OPERAND_MASK ISA_OPERAND_MASK
+/*register word: | ARE | destination register | - | source register |*/
+#define DST_REG_SHIFT ISA_DST_REG_SHIFT
+#define SRC_REG_SHIFT ISA_SRC_REG_SHIFT
+
+/*A/R/E field of every code word - how a loader treats the word*/
+#define ARE_ABSOLUTE 0 /*the word is final wherever the module is loaded*/
+#define ARE_EXTERNAL 1 /*the word holds the address of a label of another module, filled in by the linker*/
+#define ARE_RELOCATABLE 2 /*the word holds an address inside this module, moved with the module*/
+
+/*Operand words that refer to labels*/
+#define RELOCATABLE_WORD(address) ISA_ENCODE_OPERAND_WORD(address, ARE_RELOCATABLE)
+#define EXTERNAL_WORD ISA_ENCODE_OPERAND_WORD(0, ARE_EXTERNAL)
+
+/*Addressing modes, as encoded in the source and destination fields of the first word*/
+#define IMMEDIATE_ADDRESSING ISA_MODE_IMMEDIATE
+#define DIRECT_ADDRESSING ISA_MODE_DIRECT
+#define REGISTER_ADDRESSING ISA_MODE_REGISTER
+
+/*Bitmask of a single addressing mode - used to describe the modes an opcode accepts*/
+#define MODE_BIT(mode) (1 << (mode))
+#define NO_MODES 0
+
+/*Describes an opcode: how many operands it takes, which addressing modes are legal and its first word*/
+typedef struct opcode_descriptor {
+    char *name;
+    int operandCount;
+    unsigned int srcModes; /*bitmask of the legal source addressing modes*/
+    unsigned int dstModes; /*bitmask of the legal destination addressing modes*/
+    word_t firstWord; /*first word template with the opcode already in place*/
+} opcode_descriptor;
+
+/*The source line of an instruction - the words after its first word, up to the next instruction, come from the same line*/
+typedef struct code_line {
+    int index; /*position of the first word of the instruction in the code image*/
+    int lineNumber;
+} code_line;
+
+/*A word of the code image that refers to a label - its address is filled in once the label table is complete*/
+typedef struct symbol_ref {
+    int index; /*position of the referring word in the code image*/
+    int lineNumber; /*source line, for error messages*/
+    char name[MAX_LABEL_LENGTH+1]; /*adding one extra space for NULL ending*/
+} symbol_ref;
+
+/*A block of the data image that was added to the constant pool*/
+typedef struct pool_entry {
+    unsigned long hash; /*hash of the words of the block*/
+    int start; /*position of the block in the data image*/
+    int length;
+    int next; /*next entry in the same hash bucket, -1 if none*/
+} pool_entry;
+
+#define POOL_BUCKETS 256
+
+/*A run of identical words in the data image - reserved by .fill and .space without storing every word*/
+typedef struct fill_run {
+    int start; /*position of the first word of the run in the data image*/
+    int length;
+    word_t value;
+    int skipped; /*words of the runs before this one - data stores the words after a run that many words, and length, earlier*/
+} fill_run;
+
+/*The code and data images, packed one word per entry, with a side table of the words that refer to labels*/
+typedef struct machine_image {
+    word_t *code; /*grows with the program - see reserveCode*/
+    word_t *data; /*the words of the data image that are not in runs, in order - grows with them, see reserveData*/
+    code_line *codeLines; /*source line of every instruction, in order - words that refer to labels also have theirs in refs*/
+    int codeLineCount;
+    int codeLineCapacity;
+    int *chainLinks; /*one-pass mode: 1 + index of the previous code word waiting for the same label, for every waiting word*/
+    int codeCapacity;
+    int dataCapacity;
+    int pieces; /*pieces the first pass of the source was split into - the second pass resolves its label uses in as many jobs*/
+    int memorySize; /*words of memory - the code and data images together may not be larger*/
+    int baseAddress; /*address of the first code word*/
+    symbol_ref *refs;
+    int refCount;
+    int refCapacity;
+    boolean onePass; /*words are final as soon as they are encoded - refs still lists every use of a label*/
+    boolean poolAll; /*every data directive goes to the constant pool, not only those marked with .pool*/
+    boolean noFiles; /*.incbin is an error - the source may not read files*/
+    pool_entry *pool;
+    int poolCount;
+    int poolCapacity;
+    int poolBuckets[POOL_BUCKETS]; /*first entry of each hash bucket, -1 if none*/
+    fill_run *fills; /*runs of the data image that are not stored in data, ordered by position*/
+    int fillCount;
+    int fillWords; /*words of the data image in runs*/
+    int fillCapacity;
+    char **includes; /*names of the files embedded with .incbin*/
+    int includeCount;
+    int includeCapacity;
+} machine_image;
+
+/*Diagnostics collected in memory, instead of printed, while the library assembles a buffer or a worker thread assembles a file*/
+typedef struct diagnostics {
+    char *text;
+    size_t length;
+    size_t capacity;
+    boolean colors; /*keep the terminal colours of errors and warnings, for text that is printed later*/
+} diagnostics;
+
+/*Command line options*/
+typedef struct assembler_options {
+    boolean onePass; /*assemble in a single pass, backpatching forward references*/
+    boolean optimize; /*run the peephole optimizer over the code image before writing the files*/
+    boolean pool; /*store identical .data and .string constants once*/
+    boolean binaryObject; /*also write the object in the binary .obx format*/
+    boolean noFiles; /*reject .incbin, so assembling a source reads no files - for sources that are not trusted*/
+    int jobs; /*files assembled at once*/
+    int memorySize; /*words of memory of the machine*/
+    int baseAddress; /*address of the first code word*/
+    int splits; /*most pieces the first pass of a large source is split into, run at once - 1 to read it line by line*/
+    char *cacheDirectory; /*where the build cache keeps the outputs of earlier runs, NULL for no cache*/
+    long cacheMegabytes; /*bound of the size of the cache directory*/
+    boolean cacheStatistics; /*print the statistics of the cache at the end of the run*/
+    boolean watch; /*keep running, assembling the files again whenever they or the files they embed change*/
+    unsigned int traceCategories; /*bitmask of the TRACE_ categories to print*/
+    int traceLevel; /*TRACE_OFF, TRACE_INFO or TRACE_DEBUG*/
+} assembler_options;
 
 #endif /* UTILS_H */
@@ -0,0 +1,214 @@
+#define _DEFAULT_SOURCE /*realpath*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "watch.h"
+
+/*The changes that make a watched file worth assembling again*/
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE)
+
+/*Set by Ctrl-C, so the run ends the way it ends without --watch - e.g. with the eviction of the cache*/
+static volatile sig_atomic_t watchStopped = 0;
+
+/* Stops waiting for changes.*/
+static void stopWatching(int signalNumber) {
+    (void)signalNumber;
+    watchStopped = 1;
+}
+
+/* Starts watching for changes.*/
+boolean openWatch(file_watch *watch, int sourceCount) {
+    struct sigaction action;
+
+    /*without SA_RESTART, so a signal ends the wait for events*/
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopWatching;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    watchStopped = 0;
+    watch->descriptor = inotify_init();
+    watch->directories = NULL;
+    watch->directoryCount = 0;
+    watch->directoryCapacity = 0;
+    watch->dependencies = NULL;
+    watch->dependencyCount = 0;
+    watch->dependencyCapacity = 0;
+    watch->sourceCount = sourceCount;
+    return watch->descriptor >= 0;
+}
+
+/* Copies a string to the heap.*/
+static char *copyString(const char *string) {
+    char *copy = malloc(strlen(string) + 1);
+    if (copy != NULL)
+        strcpy(copy, string);
+    return copy;
+}
+
+/* Watches a directory, if it is not watched already. Returns FALSE on failure.*/
+static boolean watchDirectory(file_watch *watch, const char *path) {
+    watched_directory *newDirectories;
+    int descriptor = inotify_add_watch(watch->descriptor, path, WATCH_EVENTS), i;
+
+    if (descriptor < 0)
+        return FALSE;
+    for (i = 0; i < watch->directoryCount; i++) {
+        if (watch->directories[i].descriptor == descriptor)
+            return TRUE;
+    }
+    if (watch->directoryCount == watch->directoryCapacity) {
+        /* Double the capacity of the directory list*/
+        int newCapacity = watch->directoryCapacity ? watch->directoryCapacity * 2 : 4;
+        newDirectories = realloc(watch->directories, newCapacity * sizeof(watched_directory));
+        if (newDirectories == NULL)
+            return FALSE;
+        watch->directories = newDirectories;
+        watch->directoryCapacity = newCapacity;
+    }
+    watch->directories[watch->directoryCount].path = copyString(path);
+    if (watch->directories[watch->directoryCount].path == NULL)
+        return FALSE;
+    watch->directories[watch->directoryCount++].descriptor = descriptor;
+    return TRUE;
+}
+
+/* Adds an edge to the dependency graph.*/
+boolean watchFile(file_watch *watch, const char *fileName, int source) {
+    char directory[PATH_MAX], path[2 * PATH_MAX];
+    const char *slash = strrchr(fileName, '/'), *name = slash != NULL ? slash + 1 : fileName;
+    dependency *newDependencies;
+
+    /*the directory is made canonical - the file itself may not exist while an editor replaces it*/
+    if (slash == NULL)
+        strcpy(path, ".");
+    else if (slash == fileName)
+        strcpy(path, "/");
+    else
+        sprintf(path, "%.*s", (int)MIN(slash - fileName, PATH_MAX - 1), fileName);
+    if (*name == '\0' || realpath(path, directory) == NULL || strlen(directory) + strlen(name) + 2 > PATH_MAX)
+        return FALSE;
+    if (!watchDirectory(watch, directory))
+        return FALSE;
+    sprintf(path, "%s/%s", strcmp(directory, "/") == 0 ? "" : directory, name);
+
+    if (watch->dependencyCount == watch->dependencyCapacity) {
+        /* Double the capacity of the dependency list*/
+        int newCapacity = watch->dependencyCapacity ? watch->dependencyCapacity * 2 : 16;
+        newDependencies = realloc(watch->dependencies, newCapacity * sizeof(dependency));
+        if (newDependencies == NULL)
+            return FALSE;
+        watch->dependencies = newDependencies;
+        watch->dependencyCapacity = newCapacity;
+    }
+    watch->dependencies[watch->dependencyCount].path = copyString(path);
+    if (watch->dependencies[watch->dependencyCount].path == NULL)
+        return FALSE;
+    watch->dependencies[watch->dependencyCount++].source = source;
+    return TRUE;
+}
+
+/* Removes every edge of a source.*/
+void forgetSource(file_watch *watch, int source) {
+    int i, kept = 0;
+    for (i = 0; i < watch->dependencyCount; i++) {
+        if (watch->dependencies[i].source == source)
+            free(watch->dependencies[i].path);
+        else
+            watch->dependencies[kept++] = watch->dependencies[i];
+    }
+    watch->dependencyCount = kept;
+}
+
+/* Marks the sources that depend on a changed file.*/
+static void markChanged(const file_watch *watch, const struct inotify_event *event, boolean changed[]) {
+    char path[PATH_MAX];
+    const char *directory = NULL;
+    int i;
+
+    if (event->mask & IN_Q_OVERFLOW) {
+        /*changes were lost - every source may be affected*/
+        for (i = 0; i < watch->sourceCount; i++)
+            changed[i] = TRUE;
+        return;
+    }
+    for (i = 0; i < watch->directoryCount && directory == NULL; i++) {
+        if (watch->directories[i].descriptor == event->wd)
+            directory = watch->directories[i].path;
+    }
+    if (directory == NULL || event->len == 0 || strlen(directory) + strlen(event->name) + 2 > PATH_MAX)
+        return;
+    sprintf(path, "%s/%s", strcmp(directory, "/") == 0 ? "" : directory, event->name);
+    for (i = 0; i < watch->dependencyCount; i++) {
+        if (strcmp(watch->dependencies[i].path, path) == 0)
+            changed[watch->dependencies[i].source] = TRUE;
+    }
+}
+
+/* Reads the events that are waiting. Returns FALSE if the watch failed.*/
+static boolean readEvents(const file_watch *watch, boolean changed[]) {
+    /*the buffer is aligned for the events, which the kernel writes back to back*/
+    union {
+        struct inotify_event event;
+        char bytes[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+    } buffer;
+    const struct inotify_event *event;
+    ssize_t length, offset;
+
+    do {
+        length = read(watch->descriptor, buffer.bytes, sizeof(buffer.bytes));
+    } while (length < 0 && errno == EINTR && !watchStopped);
+    if (length <= 0)
+        return FALSE;
+    for (offset = 0; offset < length; offset += sizeof(struct inotify_event) + event->len) {
+        event = (const struct inotify_event *)(buffer.bytes + offset);
+        markChanged(watch, event, changed);
+    }
+    return TRUE;
+}
+
+/* Waits for changes to the watched files.*/
+int waitForChanges(file_watch *watch, boolean changed[]) {
+    struct pollfd waiting;
+    int i, count = 0, ready;
+
+    waiting.fd = watch->descriptor;
+    waiting.events = POLLIN;
+    while (count == 0) {
+        /*the first change may take forever - then the burst it starts ends after a short quiet time*/
+        if (!readEvents(watch, changed))
+            return -1;
+        while ((ready = poll(&waiting, 1, WATCH_SETTLE_MILLISECONDS)) != 0) {
+            if (ready < 0 && errno == EINTR && !watchStopped)
+                continue;
+            if (ready < 0 || !readEvents(watch, changed))
+                return -1;
+        }
+        /*changes to other files of the watched directories, e.g. the outputs, start nothing*/
+        for (i = 0; i < watch->sourceCount; i++)
+            count += changed[i] ? 1 : 0;
+    }
+    return count;
+}
+
+/* Stops watching and frees the watch.*/
+void closeWatch(file_watch *watch) {
+    int i;
+    for (i = 0; i < watch->directoryCount; i++)
+        free(watch->directories[i].path);
+    for (i = 0; i < watch->dependencyCount; i++)
+        free(watch->dependencies[i].path);
+    free(watch->directories);
+    free(watch->dependencies);
+    if (watch->descriptor >= 0)
+        close(watch->descriptor);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+}
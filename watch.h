@@ -0,0 +1,75 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "utils.h"
+
+/*How long a burst of changes must be quiet before the sources are assembled again - an editor saves a file in a few steps*/
+#define WATCH_SETTLE_MILLISECONDS 15
+
+/*A directory watched through inotify*/
+typedef struct watched_directory {
+    int descriptor; /*the inotify watch descriptor*/
+    char *path; /*canonical path, without the final '/'*/
+} watched_directory;
+
+/*An edge of the dependency graph - the source with the given index is assembled again when the file changes*/
+typedef struct dependency {
+    char *path; /*canonical path of the file*/
+    int source;
+} dependency;
+
+/*
+ * The files of a run of the assembler and the files they embed, watched for changes.
+ * Directories are watched rather than files, so a file that an editor replaces by renaming a new one over it is still seen.
+ */
+typedef struct file_watch {
+    int descriptor; /*the inotify instance*/
+    watched_directory *directories;
+    int directoryCount;
+    int directoryCapacity;
+    dependency *dependencies;
+    int dependencyCount;
+    int dependencyCapacity;
+    int sourceCount;
+} file_watch;
+
+/**
+ * Starts watching for changes. Until the watch is closed, Ctrl-C and SIGTERM end the wait for changes instead of the process.
+ * @param watch The watch to initialize.
+ * @param sourceCount The number of sources - the sources are numbered from 0.
+ * @return TRUE on success, FALSE if inotify is not available.
+ */
+boolean openWatch(file_watch *watch, int sourceCount);
+
+/**
+ * Adds an edge to the dependency graph: the source is assembled again whenever the file is written, replaced or removed.
+ * The file need not exist yet, but its directory must.
+ * @param watch The watch.
+ * @param fileName The name of the file, relative to the working directory.
+ * @param source The index of the source that depends on it - a source depends on its own file too.
+ * @return TRUE on success, FALSE if the file cannot be watched.
+ */
+boolean watchFile(file_watch *watch, const char *fileName, int source);
+
+/**
+ * Removes every edge of a source, before its dependencies are added again after it was assembled.
+ * @param watch The watch.
+ * @param source The index of the source.
+ */
+void forgetSource(file_watch *watch, int source);
+
+/**
+ * Waits for changes to the watched files, then for WATCH_SETTLE_MILLISECONDS without any.
+ * @param watch The watch.
+ * @param changed Output - set to TRUE for every source affected by a change, left as it is for the others.
+ * @return The number of sources affected, or -1 if the watch failed or was stopped by a signal.
+ */
+int waitForChanges(file_watch *watch, boolean changed[]);
+
+/**
+ * Stops watching and frees the watch.
+ * @param watch The watch.
+ */
+void closeWatch(file_watch *watch);
+
+#endif /*WATCH_H*/
@@ -1,6 +1,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
 
 #include "parser.h"
 #include "directives.h"
@@ -8,6 +13,17 @@
 #include "labels.h"
 #include "utils.h"
 #include "writeFiles.h"
+#include "image.h"
+#include "trace.h"
+#include "obx.h"
+#include "threadPool.h"
+
+/*Longest decimal number the files hold, and the longest lines of the object and label files*/
+#define DECIMAL_DIGITS 12
+#define OBJECT_LINE_LENGTH (DECIMAL_DIGITS + 3 + ISA_BASE64_DIGITS + 1)
+#define LABEL_LINE_LENGTH (MAX_LABEL_LENGTH + 1 + DECIMAL_DIGITS + 1)
+/*The .ob, .ent, .ext, .rel and .obx files of a module*/
+#define MAX_OUTPUT_FILES 5
 
 /**
  * Generates output file names based on the input file name.
@@ -15,47 +31,118 @@
  * @param entFileName Output for the entry file name.
  * @param extFileName Output for the extern file name.
  * @param objFileName Output for the object file name.
+ * @param obxFileName Output for the binary object file name.
+ * @param relFileName Output for the relocation file name.
+ * @return TRUE if the names were generated, FALSE otherwise.
  */
 
-static void generateOutputFileNames(const char * inputFileName, char * entFileName, char * extFileName, char * objFileName);
+static boolean generateOutputFileNames(const char * inputFileName, char * entFileName, char * extFileName, char * objFileName, char * obxFileName, char * relFileName);
 /**
- * Converts a machine_word to a 12-bit binary representation.
- * @param machineWord The machine word to convert.
- * @param externFile External file to write data.
- * @param entryFile Entry file to write data.
+ * Fills in the address of every code word that refers to a label. The label uses of a source whose first pass was
+ * split are resolved in as many jobs at once, one for every piece.
+ * @param image The code and data images.
  * @param labelTable The table of labels.
- * @param lineNumber The current line number.
- * @return The 12-bit binary representation.
+ * @param IC The instruction counter.
+ * @return TRUE if every label was found, FALSE otherwise.
+ */
+static boolean resolveSymbols(machine_image *image, label_table *labelTable, int IC);
+/**
+ * Fills in the address of the code words of a range of the label uses.
+ * @param image The code and data images.
+ * @param labelTable The table of labels.
+ * @param IC The instruction counter.
+ * @param first The first label use of the range.
+ * @param last The label use after the range.
+ * @return TRUE if every label was found, FALSE otherwise.
+ */
+static boolean resolveRange(machine_image *image, label_table *labelTable, int IC, int first, int last);
+/**
+ * Fills the table of base64 digit pairs, once.
  */
-static unsigned short convertToBinary(machine_word * machineWord, FILE * externFile, FILE * entryFile, label_table labelTable, int lineNumber);
+static void initBase64Table(void);
 /**
- * Converts a binary word to a base64 representation.
+ * Converts a binary word to its base64 digits, most significant first, through the table of digit pairs.
  * @param binaryWord The binary word to convert.
- * @return The base64 representation.
+ * @param base64Word Output for the ISA_BASE64_DIGITS digits - not null-terminated.
  */
-static char * binaryToBase64(unsigned short binaryWord);
-
-void printBinaryRepresentation(unsigned short number);
+static void binaryToBase64(word_t binaryWord, char * base64Word);
+/**
+ * Makes room for more bytes at the end of an output buffer.
+ * @param buffer The buffer.
+ * @param length The number of bytes that will be added.
+ * @return TRUE if there is room, FALSE if memory ran out.
+ */
+static boolean reserveOutput(output_buffer * buffer, size_t length);
+/**
+ * Appends a string to an output buffer, which must have room for it.
+ * @param buffer The buffer.
+ * @param string The string to append.
+ */
+static void appendString(output_buffer * buffer, const char * string);
+/**
+ * Appends a non-negative decimal number to an output buffer, which must have room for it.
+ * @param buffer The buffer.
+ * @param number The number to append.
+ */
+static void appendNumber(output_buffer * buffer, long number);
 /**
- * Converts machine_word arrays to binary and base64 representation.
- * @param codeImage Array of machine words for code.
- * @param dataImage Array of machine words for data.
- * @param codeImageBinary Array of binary representation for code.
- * @param dataImageBinary Array of binary representation for data.
- * @param codeImage64 Array of base64-encoded code.
- * @param dataImage64 Array of base64-encoded data.
- * @param externFile External file to write data.
- * @param entryFile Entry file to write data.
+ * Checks if a file already holds exactly the contents of an output buffer.
+ * @param fileName The name of the file.
+ * @param buffer The buffer.
+ * @return TRUE if the file exists and its contents are the same, FALSE otherwise.
+ */
+static boolean sameContents(const char * fileName, const output_buffer * buffer);
+/**
+ * Replaces files with the contents of output buffers: each buffer is written to a temporary file, which is then
+ * renamed over the file. The writes of all the files are submitted to the I/O queue at once. A file that already
+ * holds the same contents is left untouched, and an empty buffer removes the file instead, for the label files.
+ * @param io The I/O queue.
+ * @param fileNames The names of the files.
+ * @param buffers The buffers to write.
+ * @param removeIfEmpty For every file, TRUE if an empty buffer means that the file should not exist.
+ * @param count The number of files, at most MAX_OUTPUT_FILES.
+ * @return TRUE if the files were written, FALSE otherwise.
+ */
+static boolean flushOutputs(io_queue * io, const char * fileNames[], const output_buffer * buffers[], const boolean removeIfEmpty[], int count);
+/**
+ * Completes the words that refer to labels and formats the output files into buffers that may hold the files of an
+ * earlier module - they are emptied first, and grow only if the module needs more than they already hold.
+ * @param image The code and data images.
+ * @param labelTable The table of labels.
+ * @param IC The instruction counter.
+ * @param DC The data counter.
+ * @param outputs The buffers of the files.
+ * @return TRUE if the contents were formatted, FALSE if labels are missing or memory ran out.
+ */
+static boolean formatIntoOutputs(machine_image *image, label_table *labelTable, int IC, int DC, output_files *outputs);
+/**
+ * Formats the binary representation of a word, most significant bit first.
+ * @param number The word.
+ * @param binary Output for the ISA_WORD_BITS digits and a null-terminator.
+ */
+static void formatBinary(word_t number, char * binary);
+/**
+ * Formats the module in the binary .obx format, with its symbol, relocation and line tables.
+ * @param buffer Output for the contents of the file - free its bytes also on failure.
+ * @param image The code and data images.
  * @param labelTable The table of labels.
  * @param IC The instruction counter.
  * @param DC The data counter.
+ * @return TRUE if the contents were formatted, FALSE if memory ran out.
  */
-static void convertArrays(machine_word codeImage[], machine_word dataImage[], unsigned short codeImageBinary[], unsigned short dataImageBinary[], char codeImage64[], char dataImage64[], FILE * externFile, FILE * entryFile, label_table labelTable, int IC, int DC);
+static boolean formatObxFile(output_buffer * buffer, machine_image *image, label_table *labelTable, int IC, int DC);
+/**
+ * Appends a line for a word of the image to the object file buffer, which must have room for it.
+ * @param objBuffer The object file buffer.
+ * @param address The address of the word.
+ * @param binaryWord The 12-bit word.
+ */
+static void writeObjectWord(output_buffer * objBuffer, int address, word_t binaryWord);
 
 /*************************************************************************************************/
 
 /* Generates output file names based on input file name */
-static void generateOutputFileNames(const char * inputFileName, char * entFileName, char * extFileName, char * objFileName) {
+static boolean generateOutputFileNames(const char * inputFileName, char * entFileName, char * extFileName, char * objFileName, char * obxFileName, char * relFileName) {
 
     char nameWithoutExtension[MAX_FILE_NAME_LENGTH];
     char *lastDot = strrchr(inputFileName, '.'); /* Find the last dot in the filename */
@@ -70,196 +157,506 @@ static void generateOutputFileNames(const char * inputFileName, char * entFileNa
             nameWithoutExtension[lengthWithoutExtension] = '\0'; /* Null-terminate the string */
         } else {
             /* Handle the error: filename too long */
-            fprintf(stderr, "Filename too long.\n");
-            return;
+            printMessage("Filename too long.\n");
+            return FALSE;
         }
     } else {
         /* Handle the error: incorrect or unexpected file extension */
-        fprintf(stderr, "Unexpected file extension. Expected \".am\".\n");
-        return;
+        printMessage("Unexpected file extension. Expected \".am\".\n");
+        return FALSE;
     }
 
     /* Create the file names for the output files */
-    snprintf(entFileName, MAX_FILE_NAME_LENGTH, "%s.ent", nameWithoutExtension);
-    snprintf(extFileName, MAX_FILE_NAME_LENGTH, "%s.ext", nameWithoutExtension);
-    snprintf(objFileName, MAX_FILE_NAME_LENGTH, "%s.obj", nameWithoutExtension);
+    sprintf(entFileName, "%s.ent", nameWithoutExtension);
+    sprintf(extFileName, "%s.ext", nameWithoutExtension);
+    sprintf(objFileName, "%s.ob", nameWithoutExtension);
+    sprintf(obxFileName, "%s.obx", nameWithoutExtension);
+    sprintf(relFileName, "%s.rel", nameWithoutExtension);
+    return TRUE;
 }
 
 
 
-/* Converts a machine word to its binary representation */
-static unsigned short convertToBinary(machine_word * machineWord, FILE * externFile, FILE * entryFile, label_table labelTable, int lineNumber) {
-    unsigned short binary = 0;
+/*The label uses one job of the second pass resolves*/
+typedef struct fixup_job {
+    machine_image *image;
+    label_table *labelTable;
+    int IC;
+    int first;
+    int last;
+    boolean resolved;
+    diagnostics messages;
+} fixup_job;
 
-    if (machineWord -> isLabel) {
-        /* Check if the label is in the table */
-        if (findLabel(machineWord -> label.name, &labelTable)) {
-            /* Print address to the appropriate file (extern or entry) */
-            if (machineWord -> label.isExternal)
-                fprintf(externFile, "%s\t%d", machineWord -> label.name, machineWord -> label.address);
-            if (machineWord -> label.isEntry || !(machineWord -> label.isExternal))
-                fprintf(entryFile, "%s\t%d", machineWord -> label.name, machineWord -> label.address);
-        } else {
-            printf("Error found at line #%d: Invalid label name.\n", lineNumber);
-            return binary;
-        }
+/* Resolves the label uses of a job - a job of the thread pool. The labels are only read, and every use has its own word */
+static void resolveJob(int job, int worker, void *arg) {
+    fixup_job *fixup = (fixup_job *)arg + job;
+    diagnostics *previousSink = setDiagnosticSink(&fixup->messages);
+
+    fixup->resolved = resolveRange(fixup->image, fixup->labelTable, fixup->IC, fixup->first, fixup->last);
+    setDiagnosticSink(previousSink);
+}
+
+/* Fills in the address of every code word that refers to a label */
+static boolean resolveSymbols(machine_image *image, label_table *labelTable, int IC) {
+    fixup_job *jobs;
+    long *costs;
+    diagnostics *sink;
+    int i, count = MIN(image->pieces, image->refCount);
+    boolean NO_ERROR_FLAG = TRUE;
+
+    if (count < 2)
+        return resolveRange(image, labelTable, IC, 0, image->refCount);
+    jobs = calloc(count, sizeof(fixup_job));
+    costs = malloc(count * sizeof(long));
+    if (jobs == NULL || costs == NULL) {
+        free(jobs);
+        free(costs);
+        return resolveRange(image, labelTable, IC, 0, image->refCount);
+    }
+    /*the messages of the jobs are printed in order afterwards, keeping their colours unless the caller collects them without*/
+    sink = setDiagnosticSink(NULL);
+    setDiagnosticSink(sink);
+    for (i = 0; i < count; i++) {
+        jobs[i].image = image;
+        jobs[i].labelTable = labelTable;
+        jobs[i].IC = IC;
+        jobs[i].first = (int)((long)image->refCount * i / count);
+        jobs[i].last = (int)((long)image->refCount * (i + 1) / count);
+        jobs[i].messages.colors = sink == NULL || sink->colors;
+        costs[i] = jobs[i].last - jobs[i].first;
+    }
+    if (!runJobs(count, costs, count, resolveJob, jobs)) {
+        NO_ERROR_FLAG = resolveRange(image, labelTable, IC, 0, image->refCount);
     } else {
-        /* Handle different word types */
-        switch (machineWord -> wordType) {
-            case FIRST_WORD_TYPE:
-                binary |= ((machineWord -> word.first_word.ARE & 0x3) << 10) |
-                          ((machineWord -> word.first_word.dst_op_addr & 0x7) << 7) |
-                          ((machineWord -> word.first_word.op_code & 0xF) << 3) |
-                          (machineWord -> word.first_word.src_op_addr & 0x7);
-                break;
-            case IMMDT_DRCT_WORD_TYPE:
-                binary |= ((machineWord -> word.immdt_drct_word.ARE & 0x3) << 10) |
-                          (machineWord -> word.immdt_drct_word.operand & 0x3FF);
-                break;
-            case DATA_WORD_TYPE:
-                binary |= machineWord -> word.data_word.data & 0xFFF; /*Ensured 12 bits*/
-                break;
-            case RGSTR_WORD_TYPE:
-                binary |= ((machineWord -> word.register_word.ARE & 0x3) << 10) |
-                          ((machineWord -> word.register_word.dst_op_addr & 0xF) << 6) | /*Adjusted for 12 bits*/
-                          (machineWord -> word.register_word.src_op_addr & 0xF); /*Adjusted for 12 bits*/
-                break;
-            default:
-                printf("Error found at line #%d: Unknown word type.\n", lineNumber);
-                break;
+        for (i = 0; i < count; i++) {
+            relayDiagnostics(&jobs[i].messages);
+            NO_ERROR_FLAG = NO_ERROR_FLAG && jobs[i].resolved;
         }
     }
+    for (i = 0; i < count; i++)
+        free(jobs[i].messages.text);
+    free(jobs);
+    free(costs);
+    return NO_ERROR_FLAG;
+}
 
-    return binary & 0xFFF; /*Ensuring the result is 12 bits*/
+/* Fills in the address of the code words of a range of the label uses */
+static boolean resolveRange(machine_image *image, label_table *labelTable, int IC, int first, int last) {
+    int i;
+    boolean NO_ERROR_FLAG = TRUE;
+    label *target;
+
+    for (i = first; i < last; i++) {
+        target = lookupLabel(image->refs[i].name, labelTable);
+        if (target == NULL || !(target->isDefined || target->isExternal)) {
+            printError("Label is used but never defined.", image->refs[i].lineNumber);
+            NO_ERROR_FLAG = FALSE;
+        } else if (target->isExternal) {
+            image->code[image->refs[i].index] = EXTERNAL_WORD; /*the linker fills in the address*/
+        } else if (!addressWord(image, target, IC, image->refs[i].lineNumber, &image->code[image->refs[i].index])) {
+            NO_ERROR_FLAG = FALSE;
+        }
+    }
+    return NO_ERROR_FLAG;
 }
 
-/* Converts a binary word to its base64 representation */
-static char * binaryToBase64(unsigned short binaryWord) {
-    static const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    char * base64Word = (char * ) malloc(3 * sizeof(char)); /*2 chars + null-terminator*/
+/*Base64 digits of every 12-bit value, as a pair of characters*/
+#define BASE64_PAIR_BITS 12
+static char base64Pairs[1 << BASE64_PAIR_BITS][2];
+static pthread_once_t base64PairsOnce = PTHREAD_ONCE_INIT;
 
-    /*Ensure that binaryWord is only 12 bits*/
-    binaryWord &= 0xFFF;
+/*Numbers the temporary files of the process, so two threads that write the same file do not share one*/
+static pthread_mutex_t temporaryLock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long nextTemporary = 0;
 
-    /*Extract each 6-bit group and map it to a base64 character*/
-    base64Word[0] = base64Chars[(binaryWord >> 6) & 0x3F];  /*get the leftmost 6 bits*/
-    base64Word[1] = base64Chars[binaryWord & 0x3F];         /*get the rightmost 6 bits*/
-    base64Word[2] = '\0';                                  /*null-terminator*/
+/* Fills the table of base64 digit pairs - called once, through base64PairsOnce */
+static void initBase64Table(void) {
+    static const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    int i;
+    for (i = 0; i < (1 << BASE64_PAIR_BITS); i++) {
+        base64Pairs[i][0] = base64Chars[i >> 6];
+        base64Pairs[i][1] = base64Chars[i & 0x3F];
+    }
+}
 
-    return base64Word;
+/* Converts a binary word to its base64 digits through the table of digit pairs */
+static void binaryToBase64(word_t binaryWord, char * base64Word) {
+    unsigned long word = binaryWord & WORD_MASK; /*Ensure that binaryWord is only as wide as a word*/
+    int pair = ISA_BASE64_DIGITS / 2;
+
+    /*an odd number of digits starts with a single digit - the low character of its pair*/
+    if (ISA_BASE64_DIGITS % 2 != 0)
+        *base64Word++ = base64Pairs[(word >> (BASE64_PAIR_BITS * pair)) & 0x3F][1];
+    while (pair-- > 0) {
+        memcpy(base64Word, base64Pairs[(word >> (BASE64_PAIR_BITS * pair)) & ((1UL << BASE64_PAIR_BITS) - 1)], 2);
+        base64Word += 2;
+    }
 }
 
-/* Prints the binary representation of a number */
-void printBinaryRepresentation(unsigned short number) {
-    int i;
-    for (i = 11; i >= 0; i--) {
-        putchar((number & (1 << i)) ? '1' : '0');
+/* Makes room for more bytes at the end of an output buffer */
+static boolean reserveOutput(output_buffer * buffer, size_t length) {
+    if (buffer->length + length > buffer->capacity) {
+        size_t newCapacity = MAX(buffer->capacity * 2, buffer->length + length);
+        char *newBytes = realloc(buffer->bytes, newCapacity);
+        if (newBytes == NULL) {
+            printMessage("Error: failed to allocate memory for the output files.\n");
+            return FALSE;
+        }
+        buffer->bytes = newBytes;
+        buffer->capacity = newCapacity;
     }
-    putchar('\n');
+    return TRUE;
 }
 
-/* Converts arrays of machine words to their binary and base64 representations */
-static void convertArrays(machine_word codeImage[], machine_word dataImage[], unsigned short codeImageBinary[], unsigned short dataImageBinary[], char codeImage64[], char dataImage64[], FILE * externFile, FILE * entryFile, label_table labelTable, int IC, int DC) {
-    int i;
+/* Appends a string to an output buffer */
+static void appendString(output_buffer * buffer, const char * string) {
+    size_t length = strlen(string);
+    memcpy(buffer->bytes + buffer->length, string, length);
+    buffer->length += length;
+}
 
-    /* converting the codeImage */
-    for (i = 0; i < IC; i++) {
-        codeImageBinary[i] = convertToBinary(&codeImage[i], externFile, entryFile, labelTable, i);
-        printf("Binary representation of word %d: ", i + 1);
-        printBinaryRepresentation(codeImageBinary[i]);
+/* Appends a non-negative decimal number to an output buffer */
+static void appendNumber(output_buffer * buffer, long number) {
+    char digits[DECIMAL_DIGITS];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + number % 10);
+        number /= 10;
+    } while (number > 0);
+    while (count > 0)
+        buffer->bytes[buffer->length++] = digits[--count];
+}
+
+/* Checks if a file already holds exactly the contents of an output buffer */
+static boolean sameContents(const char * fileName, const output_buffer * buffer) {
+    char chunk[4096];
+    size_t compared = 0;
+    ssize_t result;
+    struct stat info;
+    int fd = open(fileName, O_RDONLY);
+
+    if (fd < 0)
+        return FALSE;
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size != buffer->length) {
+        close(fd);
+        return FALSE;
     }
-    
-    /* converting the dataImage */
-    for (i = 0; i < DC; i++) {
-        dataImageBinary[i] = convertToBinary(&dataImage[i], externFile, entryFile, labelTable, i);
-        printf("Binary representation of word %d: ", i + 1);
-        printBinaryRepresentation(dataImageBinary[i]);
+    while (compared < buffer->length) {
+        result = read(fd, chunk, sizeof(chunk));
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0 || memcmp(chunk, buffer->bytes + compared, (size_t)result) != 0)
+            break;
+        compared += (size_t)result;
     }
+    close(fd);
+    return compared == buffer->length;
+}
 
-    for (i = 0; i < IC; i++) {
-        char *base64Rep = binaryToBase64(codeImageBinary[i]);
-        strcpy(&codeImage64[i * 2], base64Rep);  /*Assuming codeImage64 is large enough*/
-        printf("Base64 representation: %s\n", base64Rep);
-        free(base64Rep);  /*Free allocated memory*/
+/* Replaces files with the contents of output buffers, through temporary files and renames - the writes are submitted at once */
+static boolean flushOutputs(io_queue * io, const char * fileNames[], const output_buffer * buffers[], const boolean removeIfEmpty[], int count) {
+    char tempFileNames[MAX_OUTPUT_FILES][FILENAME_MAX];
+    io_request requests[MAX_OUTPUT_FILES];
+    unsigned long number;
+    int targets[MAX_OUTPUT_FILES]; /*the file of every request*/
+    int i, pending = 0;
+    boolean written = TRUE;
+
+    for (i = 0; i < count; i++) {
+        if (removeIfEmpty[i] && buffers[i]->length == 0) {
+            remove(fileNames[i]); /*a label file of an earlier run would be stale*/
+            continue;
+        }
+        /*leave an unchanged file alone, so that its time stamp does not trigger anything downstream*/
+        if (sameContents(fileNames[i], buffers[i]))
+            continue;
+
+        /*the process id and a number of the process keep two assemblers, or two threads, that write the same file
+        from sharing the temporary file. One left by a process that died with the same id is removed first*/
+        pthread_mutex_lock(&temporaryLock);
+        number = nextTemporary++;
+        pthread_mutex_unlock(&temporaryLock);
+        sprintf(tempFileNames[pending], "%.*s.%ld.%lu.tmp", FILENAME_MAX - 64, fileNames[i], (long)getpid(), number);
+        remove(tempFileNames[pending]);
+        requests[pending].fd = open(tempFileNames[pending], O_WRONLY | O_CREAT | O_EXCL, 0666);
+        if (requests[pending].fd < 0) {
+            printMessage("Error: could not open '%s' for writing.\n", tempFileNames[pending]);
+            written = FALSE;
+            continue;
+        }
+        requests[pending].buffer = buffers[i]->bytes;
+        requests[pending].length = buffers[i]->length;
+        requests[pending].write = TRUE;
+        targets[pending++] = i;
+    }
+    runIORequests(io, requests, pending);
+    for (i = 0; i < pending; i++) {
+        if (close(requests[i].fd) != 0 || requests[i].result < 0 || (size_t)requests[i].result < requests[i].length
+            || rename(tempFileNames[i], fileNames[targets[i]]) != 0) {
+            printMessage("Error: could not write '%s'.\n", fileNames[targets[i]]);
+            remove(tempFileNames[i]);
+            written = FALSE;
+        }
+    }
+    return written;
+}
+
+/* Formats the binary representation of a word */
+static void formatBinary(word_t number, char * binary) {
+    int i;
+    for (i = ISA_WORD_BITS - 1; i >= 0; i--) {
+        *binary++ = (number & (1UL << i)) ? '1' : '0';
     }
+    *binary = '\0';
+}
 
+/* Formats a word as base64 digits and as bits */
+void formatWord(word_t word, char * base64Word, char * binary) {
+    pthread_once(&base64PairsOnce, initBase64Table);
+    binaryToBase64(word, base64Word);
+    base64Word[ISA_BASE64_DIGITS] = '\0';
+    formatBinary(word, binary);
+}
 
-    for (i = 0; i < DC; i++) {
-        char *base64Rep = binaryToBase64(dataImageBinary[i]);
-        strcpy(&dataImage64[i * 2], base64Rep);  /*Assuming dataImage64 is large enough*/
-        printf("Base64 representation: %s\n", base64Rep);
-        free(base64Rep);  /*Free allocated memory*/
+/* Appends the line of a word of the image to the object file buffer */
+static void writeObjectWord(output_buffer * objBuffer, int address, word_t binaryWord) {
+    char base64Rep[ISA_BASE64_DIGITS + 1];
+    char binary[ISA_WORD_BITS + 1];
+    binaryToBase64(binaryWord, base64Rep);
+    if (TRACE_ENABLED(TRACE_ENCODE, TRACE_DEBUG)) {
+        base64Rep[ISA_BASE64_DIGITS] = '\0';
+        formatBinary(binaryWord, binary);
+        TRACE((TRACE_ENCODE, TRACE_DEBUG, "Binary representation of word %d: %s\nBase64 representation: %s\n", address, binary, base64Rep));
     }
 
-    codeImage64[IC * 2] = '\0';  /*Null-terminate the strings*/
-    dataImage64[DC * 2] = '\0';
+    appendNumber(objBuffer, address);
+    appendString(objBuffer, ":\t ");
+    memcpy(objBuffer->bytes + objBuffer->length, base64Rep, ISA_BASE64_DIGITS);
+    objBuffer->length += ISA_BASE64_DIGITS;
+    objBuffer->bytes[objBuffer->length++] = '\n';
 }
 
-/* Writing label files based on the label table, given the updated label and label_table structures */
-void writeLabelFiles(FILE* entryFile, FILE* externFile, label_table labelTable) {
+/* Appends a "name address" line of a label file */
+static boolean appendLabelLine(output_buffer * buffer, const char * name, int address) {
+    if (!reserveOutput(buffer, LABEL_LINE_LENGTH))
+        return FALSE;
+    appendString(buffer, name);
+    buffer->bytes[buffer->length++] = ' ';
+    appendNumber(buffer, address);
+    buffer->bytes[buffer->length++] = '\n';
+    return TRUE;
+}
+
+/* Writing label files based on the label table and the external references of the code image */
+boolean writeLabelFiles(output_buffer * entryBuffer, output_buffer * externBuffer, output_buffer * relocationBuffer, label_table labelTable, machine_image *image, int IC) {
+    int i;
     label *current = labelTable.head;
     while (current) {
-        if (current->isEntry) {
-            fprintf(entryFile, "%s %d\n", current->name, current->address);
-        } else if (current->isExternal) {
-            fprintf(externFile, "%s %d\n", current->name, current->address);
+        if (current->isEntry && !appendLabelLine(entryBuffer, current->name, labelAddress(image, current, IC))) {
+            return FALSE;
         }
         current = current->next;
     }
+    /*every word that uses a label is listed once - in the externals file, or in the relocation file if the label is of this file*/
+    for (i = 0; i < image->refCount; i++) {
+        current = lookupLabel(image->refs[i].name, &labelTable);
+        if (!appendLabelLine(current->isExternal ? externBuffer : relocationBuffer, current->name, image->baseAddress + image->refs[i].index)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
 }
 
-/* Writes machine code and data to output files */
-void writeFiles(const char* fileName, machine_word codeImage[], machine_word dataImage[], 
-                char codeImage64[], char dataImage64[], unsigned short codeImageBinary[], 
-                unsigned short dataImageBinary[], label_table labelTable, int IC, int DC) {
+/* Formats the module in the binary .obx format */
+static boolean formatObxFile(output_buffer * buffer, machine_image *image, label_table *labelTable, int IC, int DC) {
+    obx_module module;
+    obx_symbol *symbols;
+    obx_relocation *relocations;
+    obx_line *lines;
+    word_t *data;
+    label *current, *target;
+    int i, count = 0, lineCount = 0, symbol;
+    boolean written = FALSE;
+
+    for (current = labelTable->head; current != NULL; current = current->next)
+        count++;
+    symbols = malloc((count + 1) * sizeof(obx_symbol));
+    relocations = malloc((image->refCount + 1) * sizeof(obx_relocation));
+    lines = malloc((image->codeLineCount + 1) * sizeof(obx_line));
+    data = malloc((DC + 1) * sizeof(word_t));
+    if (symbols == NULL || relocations == NULL || lines == NULL || data == NULL) {
+        printMessage("Error: failed to allocate memory for the .obx file.\n");
+        free(symbols); free(relocations); free(lines); free(data);
+        return FALSE;
+    }
+
+    /*every label is a symbol, in the order of the label table*/
+    for (current = labelTable->head, i = 0; current != NULL; current = current->next, i++) {
+        symbols[i].name = current->name;
+        symbols[i].value = current->isExternal ? 0 : (unsigned long)labelAddress(image, current, IC);
+        symbols[i].flags = (current->isEntry ? OBX_SYMBOL_ENTRY : 0) | (current->isExternal ? OBX_SYMBOL_EXTERNAL : 0)
+            | (current->isData ? OBX_SYMBOL_DATA : 0);
+    }
+    /*every word that holds the address of a label*/
+    for (i = 0; i < image->refCount; i++) {
+        for (target = labelTable->head, symbol = 0; target != NULL && strcmp(target->name, image->refs[i].name) != 0; target = target->next)
+            symbol++;
+        relocations[i].index = (unsigned long)image->refs[i].index;
+        relocations[i].type = (target != NULL && target->isExternal) ? OBX_EXTERNAL : OBX_RELOCATABLE;
+        relocations[i].symbol = target != NULL ? (unsigned long)symbol : OBX_NO_SYMBOL;
+    }
+    /*a line entry starts every run of code words from the same source line*/
+    for (i = 0; i < image->codeLineCount; i++) {
+        if (i == 0 || image->codeLines[i].lineNumber != image->codeLines[i - 1].lineNumber) {
+            lines[lineCount].index = (unsigned long)image->codeLines[i].index;
+            lines[lineCount++].line = (unsigned long)image->codeLines[i].lineNumber;
+        }
+    }
+    for (i = 0; i < DC; i++)
+        data[i] = dataWord(image, i);
+
+    module.wordBits = ISA_WORD_BITS;
+    module.base = image->baseAddress;
+    module.IC = IC;
+    module.DC = DC;
+    module.code = image->code;
+    module.data = data;
+    module.symbols = symbols;
+    module.symbolCount = count;
+    module.relocations = relocations;
+    module.relocationCount = image->refCount;
+    module.lines = lines;
+    module.lineCount = lineCount;
+
+    buffer->bytes = (char *)formatObx(&module, &buffer->length);
+    buffer->capacity = buffer->length;
+    if (buffer->bytes == NULL) {
+        printMessage("Error: failed to allocate memory for the .obx file.\n");
+    } else {
+        written = TRUE;
+    }
+    free(symbols); free(relocations); free(lines); free(data);
+    return written;
+}
+
+/* Completes the code image and formats the contents of the output files in memory */
+boolean formatOutputs(machine_image *image, label_table *labelTable, int IC, int DC, output_files *outputs) {
+    outputs->object.bytes = outputs->entries.bytes = outputs->externals.bytes = outputs->relocations.bytes = NULL;
+    outputs->object.capacity = outputs->entries.capacity = outputs->externals.capacity = outputs->relocations.capacity = 0;
+    return formatIntoOutputs(image, labelTable, IC, DC, outputs);
+}
 
+/* Formats the output files into buffers that may hold the files of an earlier module */
+static boolean formatIntoOutputs(machine_image *image, label_table *labelTable, int IC, int DC, output_files *outputs) {
     int i;
-    char entFileName[MAX_FILE_NAME_LENGTH];
-    char extFileName[MAX_FILE_NAME_LENGTH];
-    char objFileName[MAX_FILE_NAME_LENGTH];
-    
-    FILE *objFile, *externFile, *entryFile;
+    label *current;
+    output_buffer *objBuffer = &outputs->object;
 
-    generateOutputFileNames(fileName, entFileName, extFileName, objFileName);
+    outputs->object.length = outputs->entries.length = outputs->externals.length = outputs->relocations.length = 0;
 
-    objFile = fopen(objFileName, "w");
-    if (objFile == NULL) {
-        perror("Error opening the .obj file.\n");
-        return;
+    /*second pass - complete the words that refer to labels. In one-pass mode they are already final*/
+    if (!image->onePass && !resolveSymbols(image, labelTable, IC)) {
+        return FALSE;
     }
-
-    externFile = fopen(extFileName, "w");
-    if (externFile == NULL) {
-        perror("Error opening the .ext file.\n");
-        return;
+    for (current = labelTable->head; current != NULL; current = current->next) {
+        if (current->isEntry && !current->isDefined) {
+            printMessage("Error: entry label '%s' is never defined.\n", current->name);
+            return FALSE;
+        }
     }
 
-    entryFile = fopen(entFileName, "w");
-    if (entryFile == NULL) {
-        perror("Error opening the .ent file.\n");
-        return;
+    /*each file is formatted into a single buffer, to be written with a single write*/
+    pthread_once(&base64PairsOnce, initBase64Table);
+    if (!reserveOutput(objBuffer, 2 * DECIMAL_DIGITS + 2 + (size_t)(IC + DC) * OBJECT_LINE_LENGTH)) {
+        return FALSE;
     }
+    appendNumber(objBuffer, IC);
+    objBuffer->bytes[objBuffer->length++] = ' ';
+    appendNumber(objBuffer, DC);
+    objBuffer->bytes[objBuffer->length++] = '\n';
 
-    fprintf(objFile, "%d %d\n", IC, DC);
-
-    convertArrays(codeImage, dataImage, codeImageBinary, dataImageBinary, codeImage64, 
-                  dataImage64, externFile, entryFile, labelTable, IC, DC);
-
+    /*the code image is followed directly by the data image*/
     for (i = 0; i < IC; i++) {
-        fprintf(objFile, "%d:\t %s\n", i , &codeImage64[i]);
+        writeObjectWord(objBuffer, image->baseAddress + i, image->code[i]);
     }
-
     for (i = 0; i < DC; i++) {
-        fprintf(objFile, "%d:\t %s\n", IC + i, &dataImage64[i]);
+        writeObjectWord(objBuffer, image->baseAddress + IC + i, dataWord(image, i));
     }
+    return writeLabelFiles(&outputs->entries, &outputs->externals, &outputs->relocations, *labelTable, image, IC);
+}
 
-    writeLabelFiles(entryFile, externFile, labelTable);
-
-    fclose(objFile);
-    fclose(externFile);
-    fclose(entryFile);
+/* Frees the contents of the output files */
+void freeOutputs(output_files *outputs) {
+    free(outputs->object.bytes);
+    free(outputs->entries.bytes);
+    free(outputs->externals.bytes);
+    free(outputs->relocations.bytes);
+    outputs->object.bytes = outputs->entries.bytes = outputs->externals.bytes = outputs->relocations.bytes = NULL;
+    outputs->object.length = outputs->entries.length = outputs->externals.length = outputs->relocations.length = 0;
+    outputs->object.capacity = outputs->entries.capacity = outputs->externals.capacity = outputs->relocations.capacity = 0;
 }
 
+/* Writes machine code and data to output files */
+boolean writeFiles(io_queue * io, const char* fileName, machine_image *image, label_table labelTable, int IC, int DC, boolean binaryObject, output_files *outputs) {
+    char entFileName[MAX_FILE_NAME_LENGTH];
+    char extFileName[MAX_FILE_NAME_LENGTH];
+    char objFileName[MAX_FILE_NAME_LENGTH];
+    char obxFileName[MAX_FILE_NAME_LENGTH];
+    char relFileName[MAX_FILE_NAME_LENGTH];
+    const char *fileNames[MAX_OUTPUT_FILES];
+    const output_buffer *buffers[MAX_OUTPUT_FILES];
+    static const boolean removeIfEmpty[MAX_OUTPUT_FILES] = {FALSE, TRUE, TRUE, TRUE, FALSE};
+    output_buffer obxBuffer;
+    boolean written;
+
+    if (!generateOutputFileNames(fileName, entFileName, extFileName, objFileName, obxFileName, relFileName)) {
+        return FALSE;
+    }
+    obxBuffer.bytes = NULL;
+    written = formatIntoOutputs(image, &labelTable, IC, DC, outputs);
+    if (written && binaryObject)
+        written = formatObxFile(&obxBuffer, image, &labelTable, IC, DC);
+    if (written) {
+        fileNames[0] = objFileName; buffers[0] = &outputs->object;
+        fileNames[1] = extFileName; buffers[1] = &outputs->externals;
+        fileNames[2] = entFileName; buffers[2] = &outputs->entries;
+        fileNames[3] = relFileName; buffers[3] = &outputs->relocations;
+        fileNames[4] = obxFileName; buffers[4] = &obxBuffer;
+        written = flushOutputs(io, fileNames, buffers, removeIfEmpty, binaryObject ? 5 : 4);
+    }
+    free(obxBuffer.bytes);
+    return written;
+}
 
+/* Removes the output files of a module that did not assemble */
+void removeOutputFiles(const char * fileName) {
+    char entFileName[MAX_FILE_NAME_LENGTH];
+    char extFileName[MAX_FILE_NAME_LENGTH];
+    char objFileName[MAX_FILE_NAME_LENGTH];
+    char obxFileName[MAX_FILE_NAME_LENGTH];
+    char relFileName[MAX_FILE_NAME_LENGTH];
 
+    if (!generateOutputFileNames(fileName, entFileName, extFileName, objFileName, obxFileName, relFileName)) {
+        return;
+    }
+    remove(objFileName);
+    remove(entFileName);
+    remove(extFileName);
+    remove(relFileName);
+    remove(obxFileName);
+}
 
+/* Replaces a single file with the given contents */
+boolean writeOutputFile(io_queue * io, const char * fileName, const char * bytes, size_t length) {
+    static const boolean keepIfEmpty[1] = {FALSE};
+    const char *fileNames[1];
+    const output_buffer *buffers[1];
+    output_buffer buffer;
+
+    buffer.bytes = (char *)bytes;
+    buffer.length = buffer.capacity = length;
+    fileNames[0] = fileName;
+    buffers[0] = &buffer;
+    return flushOutputs(io, fileNames, buffers, keepIfEmpty, 1);
+}
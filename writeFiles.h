@@ -1,32 +1,92 @@
 #ifndef WRITEFILES_H
 #define WRITEFILES_H
 
+#include <stddef.h>
+#include "fileIO.h"
+
+/*The contents of an output file, formatted in memory and written at once*/
+typedef struct output_buffer {
+    char *bytes;
+    size_t length;
+    size_t capacity;
+} output_buffer;
+
+/*The contents of the output files of a module*/
+typedef struct output_files {
+    output_buffer object; /*.ob*/
+    output_buffer entries; /*.ent*/
+    output_buffer externals; /*.ext*/
+    output_buffer relocations; /*.rel*/
+} output_files;
 
 /**
- * Writes label information to entry and extern files.
+ * Formats the label information of the entry, extern and relocation files. The relocation file lists every
+ * word that holds the address of a label of this file, so a loader can move the module to another address.
  * 
- * @param entryFile Pointer to the entry file.
- * @param externFile Pointer to the extern file.
+ * @param entryBuffer The contents of the entry file.
+ * @param externBuffer The contents of the extern file.
+ * @param relocationBuffer The contents of the relocation file.
  * @param labelTable The label table containing label information.
+ * @param image The code and data images, whose symbol references list the uses of external labels.
+ * @param IC The instruction counter.
+ * @return TRUE if the lines were added, FALSE if memory ran out.
  */
- 
-void writeLabelFiles(FILE* entryFile, FILE* externFile, label_table labelTable);
+boolean writeLabelFiles(output_buffer * entryBuffer, output_buffer * externBuffer, output_buffer * relocationBuffer, label_table labelTable, machine_image *image, int IC);
 
 /**
- * Writes output files with provided data.
- * @param objFileName The object file name.
- * @param extFileName The extern file name.
- * @param entFileName The entry file name.
- * @param codeImage Array of machine words for code.
- * @param dataImage Array of machine words for data.
- * @param codeImage64 Array of base64-encoded code.
- * @param dataImage64 Array of base64-encoded data.
- * @param codeImageBinary Array of binary representation for code.
- * @param dataImageBinary Array of binary representation for data.
+ * Completes the words that refer to labels and formats the contents of the output files in memory, without any file I/O.
+ * @param image The code and data images.
  * @param labelTable The table of labels.
  * @param IC The instruction counter.
  * @param DC The data counter.
+ * @param outputs Output for the contents of the files - free them with freeOutputs, also on failure.
+ * @return TRUE if the contents were formatted, FALSE if labels are missing or memory ran out.
+ */
+boolean formatOutputs(machine_image *image, label_table *labelTable, int IC, int DC, output_files *outputs);
+
+/**
+ * Frees the contents of the output files.
+ * @param outputs The contents of the files.
+ */
+void freeOutputs(output_files *outputs);
+
+/**
+ * Writes output files with provided data. The writes of all the files are submitted at once.
+ * @param io The I/O queue.
+ * @param fileName The intermediate (.am) file name the output names are derived from.
+ * @param image The code and data images.
+ * @param labelTable The table of labels.
+ * @param IC The instruction counter.
+ * @param DC The data counter.
+ * @param binaryObject TRUE to also write the object in the binary .obx format.
+ * @param outputs The buffers to format the files in - kept by the caller, so the next module reuses their memory.
+ *                Free them with freeOutputs once no more modules are written.
+ * @return TRUE if the files were written, FALSE otherwise.
+ */
+boolean writeFiles(io_queue * io, const char * fileName, machine_image *image, label_table labelTable, int IC, int DC, boolean binaryObject, output_files *outputs);
+
+/**
+ * Removes the output files of a module that did not assemble, so the files of an earlier run are not taken for up to date.
+ * @param fileName The intermediate (.am) file name the output names are derived from.
+ */
+void removeOutputFiles(const char * fileName);
+
+/**
+ * Replaces a file with the given contents, through a temporary file and a rename. A file that already holds them is left untouched.
+ * @param io The I/O queue.
+ * @param fileName The name of the file.
+ * @param bytes The contents.
+ * @param length The length of the contents.
+ * @return TRUE if the file was written, FALSE otherwise.
+ */
+boolean writeOutputFile(io_queue * io, const char * fileName, const char * bytes, size_t length);
+
+/**
+ * Formats a word the ways the traces show it - its base64 digits, as in the object file, and its bits.
+ * @param word The word.
+ * @param base64Word Output for the ISA_BASE64_DIGITS digits and a null-terminator.
+ * @param binary Output for the ISA_WORD_BITS digits and a null-terminator.
  */
-void writeFiles(const char * fileName, machine_word codeImage[], machine_word dataImage[], char codeImage64[], char dataImage64[], unsigned short codeImageBinary[], unsigned short dataImageBinary[], label_table labelTable, int IC, int DC);
+void formatWord(word_t word, char * base64Word, char * binary);
 
 #endif /*WRITEFILES_H*/